@@ -0,0 +1,154 @@
+// Compares array kernels of protocol_serializer against per-element loop (one read_ghost/write_ghost
+// per element, which is how read_array/write_array used to work) for every element width.
+// Scalar unpack kernel is measured separately to show gain of runtime-dispatched vector kernel.
+// Byte-aligned arrays of exactly sizeof(T) bytes per element are measured separately against plain memcpy.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <ez_protocol_serializer.h>
+
+using ez::protocol_serializer;
+
+namespace {
+
+const unsigned int aligned_samples_count = 1 << 16;
+
+const unsigned int samples_count = 4096;
+const unsigned int iterations = 200;
+
+template<class Function>
+double measure_ns_per_element(Function function)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        function();
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations / samples_count;
+}
+
+template<class Function>
+double measure_gb_per_second(const size_t bytes_count, Function function)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        function();
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return double(bytes_count) * iterations / std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+template<class T>
+bool benchmark_aligned_array(const char* type_name, const bool is_little_endian, std::mt19937_64& random)
+{
+    const unsigned int bit_count = sizeof(T) * 8;
+    protocol_serializer ps({{"head", 8}, {"samples", bit_count * aligned_samples_count}}, is_little_endian);
+    const protocol_serializer::field_handle handle = ps.get_field_handle("samples");
+    const unsigned int first_bit = ps.get_field_metadata(handle).first_bit_ind;
+    for (unsigned int i = 0; i < ps.get_internal_buffer_length(); ++i)
+        ps.get_working_buffer()[i] = static_cast<unsigned char>(random());
+
+    std::vector<T> expected(aligned_samples_count);
+    std::vector<T> samples(aligned_samples_count);
+    const size_t bytes_count = sizeof(T) * aligned_samples_count;
+    const double loop_read = measure_gb_per_second(bytes_count, [&]() {
+        for (unsigned int i = 0; i < aligned_samples_count; ++i)
+            expected[i] = ps.read_ghost<T>(first_bit + i * bit_count, bit_count);
+    });
+    const double array_read = measure_gb_per_second(bytes_count, [&]() {
+        ps.read_array(handle, samples, aligned_samples_count);
+    });
+    const double plain_copy = measure_gb_per_second(bytes_count, [&]() {
+        memcpy(samples.data(), ps.get_working_buffer() + 1, bytes_count);
+    });
+    ps.read_array(handle, samples, aligned_samples_count);
+    bool match = memcmp(samples.data(), expected.data(), bytes_count) == 0;
+
+    protocol_serializer reference(ps);
+    const double loop_write = measure_gb_per_second(bytes_count, [&]() {
+        for (unsigned int i = 0; i < aligned_samples_count; ++i)
+            reference.write_ghost(first_bit + i * bit_count, bit_count, expected[i]);
+    });
+    const double array_write = measure_gb_per_second(bytes_count, [&]() {
+        ps.write_array(handle, expected, aligned_samples_count);
+    });
+    match = match && memcmp(ps.get_working_buffer(), reference.get_working_buffer(), ps.get_internal_buffer_length()) == 0;
+
+    printf("%10s %9s %13.2f %14.2f %13.2f %14.2f %15.2f\n", is_little_endian ? "little" : "big", type_name,
+           loop_read, array_read, loop_write, array_write, plain_copy);
+    return match;
+}
+
+}
+
+int main()
+{
+    std::mt19937_64 random(42);
+    bool all_match = true;
+
+    printf("byte_order bit_count loop_read_ns scalar_read_ns read_array_ns read_speedup loop_write_ns write_array_ns write_speedup\n");
+    for (int is_little_endian = 0; is_little_endian <= 1; ++is_little_endian) {
+        for (unsigned int bit_count = 1; bit_count <= 64; ++bit_count) {
+            if (is_little_endian && bit_count > 8 && bit_count % 8)
+                continue;
+
+            protocol_serializer ps({{"head", 3}, {"samples", bit_count * samples_count}}, is_little_endian != 0);
+            const protocol_serializer::field_handle handle = ps.get_field_handle("samples");
+            const unsigned int first_bit = ps.get_field_metadata(handle).first_bit_ind;
+            for (unsigned int i = 0; i < ps.get_internal_buffer_length(); ++i)
+                ps.get_working_buffer()[i] = static_cast<unsigned char>(random());
+
+            std::vector<int64_t> expected(samples_count);
+            std::vector<int64_t> samples(samples_count);
+            std::vector<uint64_t> unpacked(samples_count);
+            const unsigned int bytes_count = bit_count / 8 + ((bit_count % 8) ? 1 : 0);
+            const unsigned int reversed_bytes_count = is_little_endian && bytes_count > 1 ? bytes_count : 0;
+            const bool sign_extend = bit_count < 64;
+
+            const double loop_read = measure_ns_per_element([&]() {
+                for (unsigned int i = 0; i < samples_count; ++i)
+                    expected[i] = ps.read_ghost<int64_t>(first_bit + i * bit_count, bit_count);
+            });
+            const double scalar_read = measure_ns_per_element([&]() {
+                ez::detail::unpack_uniform_scalar(ps.get_working_buffer(), first_bit, bit_count, samples_count,
+                                                  reversed_bytes_count, sign_extend, unpacked.data());
+            });
+            const double array_read = measure_ns_per_element([&]() {
+                ps.read_array(handle, samples, samples_count);
+            });
+            for (unsigned int i = 0; i < samples_count; ++i)
+                if (samples[i] != expected[i] || static_cast<int64_t>(unpacked[i]) != expected[i])
+                    all_match = false;
+
+            protocol_serializer reference(ps);
+            const double loop_write = measure_ns_per_element([&]() {
+                for (unsigned int i = 0; i < samples_count; ++i)
+                    reference.write_ghost(first_bit + i * bit_count, bit_count, expected[i] + 1);
+            });
+            const double array_write = measure_ns_per_element([&]() {
+                for (int64_t& sample : samples)
+                    ++sample;
+                ps.write_array(handle, samples, samples_count);
+                for (int64_t& sample : samples)
+                    --sample;
+            });
+            if (memcmp(ps.get_working_buffer(), reference.get_working_buffer(), ps.get_internal_buffer_length()) != 0)
+                all_match = false;
+
+            printf("%10s %9u %12.3f %14.3f %13.3f %12.2f %13.3f %14.3f %13.2f\n", is_little_endian ? "little" : "big", bit_count,
+                   loop_read, scalar_read, array_read, loop_read / array_read, loop_write, array_write, loop_write / array_write);
+        }
+    }
+
+    printf("\nbyte_order      type loop_read_gbs array_read_gbs loop_write_gbs array_write_gbs memcpy_gbs\n");
+    for (int is_little_endian = 0; is_little_endian <= 1; ++is_little_endian) {
+        all_match = benchmark_aligned_array<int16_t>("int16", is_little_endian != 0, random) && all_match;
+        all_match = benchmark_aligned_array<int32_t>("int32", is_little_endian != 0, random) && all_match;
+        all_match = benchmark_aligned_array<int64_t>("int64", is_little_endian != 0, random) && all_match;
+        all_match = benchmark_aligned_array<float>("float", is_little_endian != 0, random) && all_match;
+    }
+
+    if (!all_match)
+        printf("MISMATCH between array kernels and per-element loop\n");
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,1046 @@
+// Regression benchmarks of protocol_serializer hot paths. Every case reports time per operation,
+// processed bytes per second and heap allocations per operation. Results may be written as JSON
+// and compared with compare_benchmarks.py.
+//
+// Usage: EzProtocolSerializerBenchmarkSuite [--json <file>] [--filter <substring>] [--min-time <seconds>]
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ez_protocol_serializer.h>
+#include <ez_record_framer.h>
+#include <ez_capture_reader.h>
+#include <ez_parallel_decoder.h>
+#include <ez_record_filter.h>
+#include <ez_projection.h>
+#include <ez_record_plan.h>
+#include <ez_struct_binding.h>
+#include <ez_schema_loader.h>
+
+using ez::protocol_serializer;
+
+// Every heap allocation of the process is counted
+namespace {
+std::atomic<uint64_t> allocations_count(0);
+}
+
+void* operator new(size_t size)
+{
+    allocations_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+// Deallocation is kept out of line: once free() is inlined into a delete expression,
+// GCC pairs it with the builtin operator new and reports a mismatch (-Wmismatched-new-delete)
+#if defined(_MSC_VER)
+#define BENCHMARK_NOINLINE __declspec(noinline)
+#else
+#define BENCHMARK_NOINLINE __attribute__((noinline))
+#endif
+
+BENCHMARK_NOINLINE void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* ptr) noexcept
+{
+    free(ptr);
+}
+
+BENCHMARK_NOINLINE void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+BENCHMARK_NOINLINE void operator delete[](void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+namespace {
+
+// Accumulates time and allocations of timed parts of a benchmark, so setup of every operation may be excluded
+class stopwatch
+{
+public:
+    void start()
+    {
+        m_start_allocations = allocations_count.load(std::memory_order_relaxed);
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    void stop()
+    {
+        m_elapsed_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - m_start).count();
+        m_allocations += allocations_count.load(std::memory_order_relaxed) - m_start_allocations;
+    }
+
+    double   elapsed_ns() const { return m_elapsed_ns; }
+    uint64_t allocations() const { return m_allocations; }
+
+private:
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_start_allocations = 0;
+    double   m_elapsed_ns = 0;
+    uint64_t m_allocations = 0;
+};
+
+struct benchmark_result
+{
+    std::string name;
+    uint64_t    iterations;
+    double      ns_per_op;
+    double      bytes_per_second;
+    double      allocations_per_op;
+};
+
+struct options
+{
+    std::string json_path;
+    std::string filter;
+    double      min_time_ns = 2e8;
+};
+
+// Keeps value alive so that computations producing it are not optimized away
+volatile uint64_t sink = 0;
+
+template<class T>
+void keep(const T& value)
+{
+    uint64_t bits = 0;
+    memcpy(&bits, &value, sizeof(T) < sizeof(bits) ? sizeof(T) : sizeof(bits));
+    sink = sink + bits;
+}
+
+class suite
+{
+public:
+    explicit suite(const options& opts) : m_options(opts) {}
+
+    // function(iterations, stopwatch) runs iterations operations and times them with stopwatch.
+    // Number of iterations grows until single run takes at least min_time
+    template<class Function>
+    void run(const std::string& name, const size_t bytes_per_op, Function function)
+    {
+        if (!m_options.filter.empty() && name.find(m_options.filter) == std::string::npos)
+            return;
+
+        uint64_t iterations = 1;
+        while (true) {
+            stopwatch watch;
+            function(iterations, watch);
+            const double elapsed_ns = watch.elapsed_ns();
+            if (elapsed_ns >= m_options.min_time_ns || iterations >= (uint64_t(1) << 40)) {
+                benchmark_result result;
+                result.name = name;
+                result.iterations = iterations;
+                result.ns_per_op = elapsed_ns / iterations;
+                result.bytes_per_second = elapsed_ns > 0 ? bytes_per_op * iterations * 1e9 / elapsed_ns : 0;
+                result.allocations_per_op = double(watch.allocations()) / iterations;
+                printf("%-48s %12llu %14.2f %16.0f %12.2f\n", name.c_str(), static_cast<unsigned long long>(result.iterations),
+                       result.ns_per_op, result.bytes_per_second, result.allocations_per_op);
+                fflush(stdout);
+                m_results.push_back(result);
+                return;
+            }
+
+            // Aim a bit above min_time, but never grow more than 100 times at once
+            const double growth = elapsed_ns > 0 ? 1.4 * m_options.min_time_ns / elapsed_ns : 100;
+            iterations = static_cast<uint64_t>(iterations * (growth > 100 ? 100 : growth < 2 ? 2 : growth));
+        }
+    }
+
+    bool write_json() const
+    {
+        if (m_options.json_path.empty())
+            return true;
+
+        FILE* file = fopen(m_options.json_path.c_str(), "w");
+        if (file == nullptr) {
+            fprintf(stderr, "Can not open %s\n", m_options.json_path.c_str());
+            return false;
+        }
+
+        fprintf(file, "{\n  \"context\": {\n    \"compiler\": \"%s\",\n    \"pointer_bits\": %u\n  },\n  \"benchmarks\": [\n",
+                compiler_name(), static_cast<unsigned int>(sizeof(void*) * 8));
+        for (size_t i = 0; i < m_results.size(); ++i) {
+            const benchmark_result& r = m_results[i];
+            fprintf(file, "    {\"name\": \"%s\", \"iterations\": %llu, \"ns_per_op\": %.4f, \"bytes_per_second\": %.1f, \"allocations_per_op\": %.4f}%s\n",
+                    r.name.c_str(), static_cast<unsigned long long>(r.iterations), r.ns_per_op, r.bytes_per_second, r.allocations_per_op,
+                    i + 1 == m_results.size() ? "" : ",");
+        }
+        fprintf(file, "  ]\n}\n");
+        fclose(file);
+        return true;
+    }
+
+private:
+    static const char* compiler_name()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc";
+#else
+        return "unknown";
+#endif
+    }
+
+    options m_options;
+    std::vector<benchmark_result> m_results;
+};
+
+std::vector<protocol_serializer::field_init> make_fields(const size_t fields_count)
+{
+    std::vector<protocol_serializer::field_init> fields;
+    fields.reserve(fields_count);
+    for (size_t i = 0; i < fields_count; ++i)
+        fields.push_back({"field_" + std::to_string(i), static_cast<unsigned int>(1 + i % 32)});
+    return fields;
+}
+
+void fill_buffer(protocol_serializer& ps)
+{
+    uint32_t seed = 12345;
+    for (unsigned int i = 0; i < ps.get_internal_buffer_length(); ++i) {
+        seed = seed * 1103515245u + 12345u;
+        ps.get_working_buffer()[i] = static_cast<unsigned char>(seed >> 16);
+    }
+}
+
+void benchmark_values(suite& s)
+{
+    const unsigned int bit_counts[] = {1, 7, 8, 12, 16, 31, 32, 33, 48, 64};
+    const unsigned int left_spacings[] = {0, 3};
+    for (const unsigned int left_spacing : left_spacings) {
+        for (const unsigned int bit_count : bit_counts) {
+            std::vector<protocol_serializer::field_init> fields;
+            if (left_spacing)
+                fields.push_back({"offset", left_spacing});
+            fields.push_back({"value", bit_count});
+            protocol_serializer ps(fields, false);
+            fill_buffer(ps);
+            const protocol_serializer::field_handle handle = ps.get_field_handle("value");
+            const size_t bytes = (bit_count + 7) / 8;
+            const std::string suffix = "/bits:" + std::to_string(bit_count) + "/offset:" + std::to_string(left_spacing);
+
+            s.run("read_by_name" + suffix, bytes, [&](const uint64_t iterations, stopwatch& watch) {
+                watch.start();
+                for (uint64_t i = 0; i < iterations; ++i)
+                    keep(ps.read<int64_t>("value"));
+                watch.stop();
+            });
+            s.run("read_by_handle" + suffix, bytes, [&](const uint64_t iterations, stopwatch& watch) {
+                watch.start();
+                for (uint64_t i = 0; i < iterations; ++i)
+                    keep(ps.read<int64_t>(handle));
+                watch.stop();
+            });
+            s.run("write_by_handle" + suffix, bytes, [&](const uint64_t iterations, stopwatch& watch) {
+                watch.start();
+                for (uint64_t i = 0; i < iterations; ++i)
+                    ps.write(handle, static_cast<int64_t>(i));
+                watch.stop();
+            });
+        }
+    }
+}
+
+void benchmark_arrays(suite& s)
+{
+    const unsigned int elements_count = 4096;
+    const unsigned int bit_counts[] = {8, 12, 16, 32};
+    const unsigned int left_spacings[] = {0, 3};
+    for (const unsigned int left_spacing : left_spacings) {
+        for (const unsigned int bit_count : bit_counts) {
+            std::vector<protocol_serializer::field_init> fields;
+            if (left_spacing)
+                fields.push_back({"offset", left_spacing});
+            fields.push_back({"array", bit_count * elements_count});
+            protocol_serializer ps(fields, false);
+            fill_buffer(ps);
+            const protocol_serializer::field_handle handle = ps.get_field_handle("array");
+            const size_t bytes = bit_count * elements_count / 8;
+            const std::string suffix = "/bits:" + std::to_string(bit_count) + "/offset:" + std::to_string(left_spacing);
+
+            // Element type matches element length, so that byte-aligned arrays may take the fastest path
+            std::vector<int32_t> wide(elements_count);
+            std::vector<int16_t> narrow(elements_count);
+            std::vector<int8_t> bytes_array(elements_count);
+            s.run("read_array" + suffix, bytes, [&](const uint64_t iterations, stopwatch& watch) {
+                watch.start();
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    if (bit_count == 8)
+                        ps.read_array(handle, bytes_array, elements_count);
+                    else if (bit_count <= 16)
+                        ps.read_array(handle, narrow, elements_count);
+                    else
+                        ps.read_array(handle, wide, elements_count);
+                }
+                watch.stop();
+                keep(wide[0] + narrow[0] + bytes_array[0]);
+            });
+            s.run("write_array" + suffix, bytes, [&](const uint64_t iterations, stopwatch& watch) {
+                watch.start();
+                for (uint64_t i = 0; i < iterations; ++i) {
+                    if (bit_count == 8)
+                        ps.write_array(handle, bytes_array, elements_count);
+                    else if (bit_count <= 16)
+                        ps.write_array(handle, narrow, elements_count);
+                    else
+                        ps.write_array(handle, wide, elements_count);
+                }
+                watch.stop();
+            });
+        }
+    }
+}
+
+// Decoding a batch of packets through one serializer pointed at every packet in turn and through a view per packet
+void benchmark_messages(suite& s)
+{
+    const unsigned int packets_count = 1024;
+    protocol_serializer ps({{"id", 20}, {"value", 36}, {"flags", 8}}, false, protocol_serializer::buffer_source::external);
+    const unsigned int packet_length = ps.get_internal_buffer_length();
+    std::vector<unsigned char> packets(packets_count * packet_length);
+    for (unsigned int i = 0; i < packets.size(); ++i)
+        packets[i] = static_cast<unsigned char>(i * 131);
+    const protocol_serializer::layout_ptr_t layout = ps.get_layout();
+    const protocol_serializer::field_handle id = ps.get_field_handle("id");
+    const protocol_serializer::field_handle value = ps.get_field_handle("value");
+    const protocol_serializer::field_handle flags = ps.get_field_handle("flags");
+
+    s.run("decode_packets/external_buffer", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                ps.set_external_buffer(packets.data() + p * packet_length);
+                sum += ps.read<uint32_t>(id) + ps.read<uint64_t>(value) + ps.read<uint8_t>(flags);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+    s.run("decode_packets/view", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                const ez::const_message_view view(*layout, packets.data() + p * packet_length, packet_length);
+                sum += view.read<uint32_t>(id) + view.read<uint64_t>(value) + view.read<uint8_t>(flags);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+}
+
+// Stream of back-to-back records arriving in chunks: record_framer against copying bytes into a staging record
+void benchmark_framer(suite& s)
+{
+    const size_t stream_length = 1 << 20;
+    protocol_serializer ps({{"sync", 16}, {"id", 32}, {"value", 35}}, false, protocol_serializer::buffer_source::external);
+    const size_t record_length = ps.get_internal_buffer_length();
+    std::vector<unsigned char> stream(stream_length);
+    for (size_t i = 0; i < stream.size(); ++i)
+        stream[i] = static_cast<unsigned char>(i * 131);
+    const protocol_serializer::field_handle id = ps.get_field_handle("id");
+
+    const size_t chunk_lengths[] = {1, 16, 256, 4096, 65536, 1 << 20};
+    for (const size_t chunk_length : chunk_lengths) {
+        const std::string suffix = "/chunk:" + std::to_string(chunk_length);
+        s.run("frame_records/framer" + suffix, stream_length, [&](const uint64_t iterations, stopwatch& watch) {
+            ez::record_framer framer(ps);
+            uint64_t sum = 0;
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i)
+                for (size_t position = 0; position < stream_length; position += chunk_length)
+                    framer.push(stream.data() + position, std::min(chunk_length, stream_length - position), [&sum, &id](const ez::const_message_view& view) {
+                        sum += view.read<uint32_t>(id);
+                    });
+            watch.stop();
+            keep(sum);
+        });
+        s.run("frame_records/staging" + suffix, stream_length, [&](const uint64_t iterations, stopwatch& watch) {
+            std::vector<unsigned char> staging(record_length);
+            size_t staged = 0;
+            ps.set_external_buffer(staging.data(), staging.size());
+            uint64_t sum = 0;
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                for (size_t position = 0; position < stream_length; position += chunk_length) {
+                    const unsigned char* chunk = stream.data() + position;
+                    const size_t length = std::min(chunk_length, stream_length - position);
+                    for (size_t done = 0; done < length;) {
+                        const size_t copied = std::min(record_length - staged, length - done);
+                        memcpy(staging.data() + staged, chunk + done, copied);
+                        staged += copied;
+                        done += copied;
+                        if (staged == record_length) {
+                            sum += ps.read<uint32_t>(id);
+                            staged = 0;
+                        }
+                    }
+                }
+            }
+            watch.stop();
+            keep(sum);
+        });
+    }
+}
+
+// Replaying a capture file: fread() into a buffer and pointing serializer at every record against mapped records
+void benchmark_capture(suite& s)
+{
+    const size_t records_count = 1 << 20;
+    protocol_serializer ps({{"id", 32}, {"value", 64}, {"flags", 16}}, false, protocol_serializer::buffer_source::external);
+    const size_t record_length = ps.get_internal_buffer_length();
+    const char* path = "ez_benchmark_capture.bin";
+    {
+        std::vector<unsigned char> records(records_count * record_length);
+        for (size_t i = 0; i < records.size(); ++i)
+            records[i] = static_cast<unsigned char>(i * 131);
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr)
+            return;
+        fwrite(records.data(), 1, records.size(), file);
+        fclose(file);
+    }
+    const protocol_serializer::field_handle id = ps.get_field_handle("id");
+
+    s.run("capture_replay/fread", records_count * record_length, [&](const uint64_t iterations, stopwatch& watch) {
+        std::vector<unsigned char> buffer(record_length * 4096);
+        uint64_t sum = 0;
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            FILE* file = fopen(path, "rb");
+            size_t read_length = 0;
+            while ((read_length = fread(buffer.data(), 1, buffer.size(), file)) != 0) {
+                for (size_t position = 0; position + record_length <= read_length; position += record_length) {
+                    ps.set_external_buffer(buffer.data() + position, record_length);
+                    sum += ps.read<uint32_t>(id);
+                }
+            }
+            fclose(file);
+        }
+        watch.stop();
+        keep(sum);
+    });
+    s.run("capture_replay/mapped", records_count * record_length, [&](const uint64_t iterations, stopwatch& watch) {
+        uint64_t sum = 0;
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            ez::capture_reader reader(ps);
+            reader.open(path);
+            for (const ez::const_message_view record : reader)
+                sum += record.read<uint32_t>(id);
+        }
+        watch.stop();
+        keep(sum);
+    });
+    remove(path);
+}
+
+// Scaling of decoding three columns of a large batch of records from 1 to hardware_concurrency() threads
+void benchmark_parallel_decode(suite& s)
+{
+    const size_t records_count = 1 << 21;
+    const size_t record_stride = 16;
+    protocol_serializer ps({{"id", 24}, {"value", 37}, {"flag", 1}, {"ratio", 32, protocol_serializer::visualization_type::floating_point}});
+    std::vector<unsigned char> records(records_count * record_stride);
+    for (size_t i = 0; i < records.size(); ++i)
+        records[i] = static_cast<unsigned char>(i * 131);
+    std::vector<uint32_t> ids(records_count);
+    std::vector<uint64_t> values(records_count);
+    std::vector<float> ratios(records_count);
+
+    std::vector<unsigned int> threads_counts;
+    const unsigned int max_threads_count = std::max(std::thread::hardware_concurrency(), 1u);
+    for (unsigned int threads_count = 1; threads_count < max_threads_count; threads_count *= 2)
+        threads_counts.push_back(threads_count);
+    threads_counts.push_back(max_threads_count);
+
+    for (const unsigned int threads_count : threads_counts) {
+        s.run("parallel_decode/threads:" + std::to_string(threads_count), records.size(), [&](const uint64_t iterations, stopwatch& watch) {
+            ez::parallel_decoder decoder(ps, threads_count);
+            decoder.add_column("id", ids.data());
+            decoder.add_column("value", values.data());
+            decoder.add_column("ratio", ratios.data());
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i)
+                decoder.decode(records.data(), record_stride, records_count);
+            watch.stop();
+            keep(ids[records_count - 1] + values[records_count / 2]);
+        });
+    }
+}
+
+void benchmark_filter(suite& s)
+{
+    // Replay-like selectivity: about 1% of records match
+    const size_t records_count = 1 << 20;
+    const size_t record_stride = 16;
+    protocol_serializer ps({{"msg_type", 5}, {"status", 11}, {"id", 24}, {"value", 37}, {"ratio", 32, protocol_serializer::visualization_type::floating_point}});
+    std::vector<unsigned char> records(records_count * record_stride);
+    for (size_t i = 0; i < records.size(); ++i)
+        records[i] = static_cast<unsigned char>(i * 131 + i / 7);
+    std::vector<uint64_t> selection;
+    selection.reserve(records_count);
+
+    // Baseline reads every field of every record and filters decoded values
+    s.run("filter/read_all", records.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            selection.clear();
+            for (size_t r = 0; r < records_count; ++r) {
+                const ez::message_view record = ps.make_view(records.data() + r * record_stride, record_stride);
+                const uint8_t msg_type = record.read<uint8_t>("msg_type");
+                const uint16_t status = record.read<uint16_t>("status");
+                keep(record.read<uint32_t>("id") + record.read<uint64_t>("value") + record.read<float>("ratio"));
+                if (msg_type == 7 && (status & 0x4) && (status & 0x300) == 0x300)
+                    selection.push_back(r);
+            }
+        }
+        watch.stop();
+        keep(selection.size());
+    });
+
+    s.run("filter/select", records.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        using ez::record_predicate;
+        ez::record_filter filter(ps);
+        filter.set_predicate(record_predicate::equal("msg_type", 7) && record_predicate::any_bits("status", 0x4) && record_predicate::all_bits("status", 0x300));
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            selection.clear();
+            filter.select(records.data(), record_stride, records_count, selection);
+        }
+        watch.stop();
+        keep(selection.size());
+    });
+}
+
+// Five neighbouring fields of a 200-field record: one read per field against a projection
+void benchmark_projection(suite& s)
+{
+    const unsigned int packets_count = 1024;
+    protocol_serializer ps(make_fields(200), false, protocol_serializer::buffer_source::external);
+    const unsigned int packet_length = ps.get_internal_buffer_length();
+    std::vector<unsigned char> packets(packets_count * packet_length);
+    for (unsigned int i = 0; i < packets.size(); ++i)
+        packets[i] = static_cast<unsigned char>(i * 131);
+    const protocol_serializer::layout_ptr_t layout = ps.get_layout();
+    const std::array<std::string, 5> names = {"field_100", "field_101", "field_102", "field_103", "field_104"};
+    std::array<protocol_serializer::field_handle, 5> handles;
+    for (size_t i = 0; i < names.size(); ++i)
+        handles[i] = ps.get_field_handle(names[i]);
+
+    s.run("projection/read_names", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                const ez::const_message_view view(*layout, packets.data() + p * packet_length, packet_length);
+                sum += view.read<uint8_t>(names[0]) + view.read<uint8_t>(names[1]) + view.read<uint8_t>(names[2]) +
+                       view.read<uint8_t>(names[3]) + view.read<uint16_t>(names[4]);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+    s.run("projection/read_handles", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                const ez::const_message_view view(*layout, packets.data() + p * packet_length, packet_length);
+                sum += view.read<uint8_t>(handles[0]) + view.read<uint8_t>(handles[1]) + view.read<uint8_t>(handles[2]) +
+                       view.read<uint8_t>(handles[3]) + view.read<uint16_t>(handles[4]);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+    s.run("projection/decode", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        ez::projection<uint8_t, uint8_t, uint8_t, uint8_t, uint16_t> projection(ps);
+        projection.set_fields(names);
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                std::tuple<uint8_t, uint8_t, uint8_t, uint8_t, uint16_t> values;
+                projection.decode(packets.data() + p * packet_length, packet_length, values);
+                sum += std::get<0>(values) + std::get<1>(values) + std::get<2>(values) + std::get<3>(values) + std::get<4>(values);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+}
+
+// Whole record field by field (by handles) against record_plan
+void benchmark_record_plan(suite& s)
+{
+    std::vector<protocol_serializer::field_init> aligned_fields;
+    const unsigned int aligned_widths[] = {8, 16, 32, 8, 8, 16, 64, 24};
+    for (size_t i = 0; i < 32; ++i)
+        aligned_fields.push_back({"field_" + std::to_string(i), aligned_widths[i % 8]});
+    const std::pair<const char*, std::vector<protocol_serializer::field_init>> protocols[] = {{"aligned", aligned_fields}, {"packed", make_fields(200)}};
+
+    for (const auto& protocol : protocols) {
+        protocol_serializer ps(protocol.second, false, protocol_serializer::buffer_source::external);
+        const unsigned int record_length = ps.get_internal_buffer_length();
+        std::vector<unsigned char> record(record_length);
+        for (unsigned int i = 0; i < record_length; ++i)
+            record[i] = static_cast<unsigned char>(i * 131);
+        ps.set_external_buffer(record.data());
+        std::vector<protocol_serializer::field_handle> handles;
+        for (const protocol_serializer::field_init& init : protocol.second)
+            handles.push_back(ps.get_field_handle(init.name));
+        std::vector<uint64_t> values(handles.size());
+        const ez::record_plan plan(ps);
+        const std::string suffix = std::string("/") + protocol.first;
+
+        s.run("record_decode/fields" + suffix, record_length, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                for (size_t f = 0; f < handles.size(); ++f)
+                    values[f] = ps.read<uint64_t>(handles[f]);
+            }
+            watch.stop();
+            keep(values[handles.size() / 2]);
+        });
+        s.run("record_decode/plan" + suffix, record_length, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i)
+                plan.decode(record.data(), record_length, values.data());
+            watch.stop();
+            keep(values[handles.size() / 2]);
+        });
+        s.run("record_encode/fields" + suffix, record_length, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                for (size_t f = 0; f < handles.size(); ++f)
+                    ps.write(handles[f], values[f]);
+            }
+            watch.stop();
+            keep(record[record_length / 2]);
+        });
+        s.run("record_encode/plan" + suffix, record_length, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i)
+                plan.encode(values.data(), record.data(), record_length);
+            watch.stop();
+            keep(record[record_length / 2]);
+        });
+    }
+}
+
+// Wide field at an odd offset: previously it had to be described and read as 64-bit pieces
+void benchmark_wide_fields(suite& s)
+{
+    protocol_serializer ps({{"head", 3}, {"wide", 256}, {"tail", 5}}, false, protocol_serializer::buffer_source::external);
+    protocol_serializer pieces({{"head", 3}, {"w0", 64}, {"w1", 64}, {"w2", 64}, {"w3", 64}, {"tail", 5}}, false, protocol_serializer::buffer_source::external);
+    std::vector<unsigned char> record(ps.get_internal_buffer_length());
+    for (size_t i = 0; i < record.size(); ++i)
+        record[i] = static_cast<unsigned char>(i * 131);
+    ps.set_external_buffer(record.data());
+    pieces.set_external_buffer(record.data());
+    const protocol_serializer::field_handle wide = ps.get_field_handle("wide");
+    std::vector<protocol_serializer::field_handle> handles;
+    for (const char* name : {"w0", "w1", "w2", "w3"})
+        handles.push_back(pieces.get_field_handle(name));
+    unsigned char bytes[32];
+
+    s.run("wide_read/pieces", sizeof(bytes), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            for (size_t p = 0; p < handles.size(); ++p)
+                ez::detail::store_be(bytes + p * 8, 8, pieces.read<uint64_t>(handles[p]));
+        }
+        watch.stop();
+        keep(bytes[17]);
+    });
+    s.run("wide_read/bytes", sizeof(bytes), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i)
+            ps.read_bytes(wide, bytes, sizeof(bytes));
+        watch.stop();
+        keep(bytes[17]);
+    });
+    s.run("wide_write/pieces", sizeof(bytes), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            for (size_t p = 0; p < handles.size(); ++p)
+                pieces.write(handles[p], ez::detail::load_be(bytes + p * 8, 8));
+        }
+        watch.stop();
+        keep(record[17]);
+    });
+    s.run("wide_write/bytes", sizeof(bytes), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i)
+            ps.write_bytes(wide, bytes, sizeof(bytes));
+        watch.stop();
+        keep(record[17]);
+    });
+}
+
+// Length-prefixed packets: trailer after the payload by hand-computed offsets vs by offsets resolved once per packet
+void benchmark_variable_length(suite& s)
+{
+    using vt = protocol_serializer::visualization_type;
+    const unsigned int packets_count = 1024;
+    protocol_serializer ps({{"type", 4}, {"length", 12}, {"payload", 8, vt::unsigned_integer, "length"}, {"sequence", 32}, {"flags", 5}, {"checksum", 16}},
+                           false, protocol_serializer::buffer_source::external);
+    std::vector<unsigned char> packets;
+    std::vector<size_t> offsets;
+    for (unsigned int p = 0; p < packets_count; ++p) {
+        const unsigned int payload_length = (p * 37) % 64;
+        offsets.push_back(packets.size());
+        packets.push_back(0x10 | static_cast<unsigned char>(payload_length >> 8));
+        packets.push_back(static_cast<unsigned char>(payload_length));
+        for (unsigned int i = 0; i < payload_length + 7; ++i)
+            packets.push_back(static_cast<unsigned char>(i * 131));
+    }
+    offsets.push_back(packets.size());
+    const protocol_serializer::field_handle sequence = ps.get_field_handle("sequence");
+    const protocol_serializer::field_handle flags = ps.get_field_handle("flags");
+    const protocol_serializer::field_handle checksum = ps.get_field_handle("checksum");
+
+    s.run("variable_length/hand_parsed", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                ps.set_external_buffer(packets.data() + offsets[p], offsets[p + 1] - offsets[p]);
+                const unsigned int trailer_bit = 16 + ps.read<uint16_t>("length") * 8;
+                sum += ps.read_ghost<uint32_t>(trailer_bit, 32) + ps.read_ghost<uint8_t>(trailer_bit + 32, 5) + ps.read_ghost<uint16_t>(trailer_bit + 37, 16);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+    s.run("variable_length/resolved", packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int p = 0; p < packets_count; ++p) {
+                ps.set_external_buffer(packets.data() + offsets[p], offsets[p + 1] - offsets[p]);
+                sum += ps.read<uint32_t>(sequence) + ps.read<uint8_t>(flags) + ps.read<uint16_t>(checksum);
+            }
+            keep(sum);
+        }
+        watch.stop();
+    });
+}
+
+// Fields of repeated sub-records through a group against the same fields flattened into uniquely named ones
+void benchmark_groups(suite& s)
+{
+    const unsigned int samples_count = 64;
+    const protocol_serializer sample({{"id", 4}, {"temp", 12}, {"flags", 3}});
+    protocol_serializer grouped({{"count", 8}});
+    grouped.append_group("samples", sample, samples_count);
+    protocol_serializer flat({{"count", 8}});
+    std::vector<protocol_serializer::field_handle> flat_temps;
+    for (unsigned int i = 0; i < samples_count; ++i) {
+        const std::string suffix = std::to_string(i);
+        flat.append_fields({{"id" + suffix, 4}, {"temp" + suffix, 12}, {"flags" + suffix, 3}});
+        flat_temps.push_back(flat.get_field_handle("temp" + suffix));
+    }
+    const protocol_serializer::field_handle samples = grouped.get_field_handle("samples");
+    const protocol_serializer::field_handle temp = grouped.get_group_field_handle("samples", "temp");
+
+    s.run("groups/flattened", samples_count, [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int e = 0; e < samples_count; ++e)
+                sum += flat.read<uint16_t>(flat_temps[e]);
+            keep(sum);
+        }
+        watch.stop();
+    });
+    s.run("groups/strided", samples_count, [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            uint64_t sum = 0;
+            for (unsigned int e = 0; e < samples_count; ++e)
+                sum += grouped.read<uint16_t>(samples, e, temp);
+            keep(sum);
+        }
+        watch.stop();
+    });
+}
+
+// Startup: layout of 256 fields from generated field_init code, from text schema and from binary snapshot of it
+void benchmark_schema_loader(suite& s)
+{
+    const unsigned int fields_count = 256;
+    std::vector<protocol_serializer::field_init> fields;
+    std::string schema = "byte_order big\n";
+    for (unsigned int i = 0; i < fields_count; ++i) {
+        const std::string name = "field_" + std::to_string(i);
+        const unsigned int bit_count = 1 + (i * 7) % 32;
+        fields.push_back({name, bit_count});
+        schema += name + " " + std::to_string(bit_count) + " unsigned\n";
+    }
+    const char* path = "ez_benchmark_schema.bin";
+    ez::schema_loader loader;
+    protocol_serializer ps;
+    if (loader.parse(schema, ps) != protocol_serializer::result_code::ok || ez::schema_loader::save_snapshot(ps, path) != protocol_serializer::result_code::ok)
+        return;
+
+    s.run("schema/field_inits", fields_count, [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            protocol_serializer loaded(fields);
+            keep(loaded.get_internal_buffer_length());
+        }
+        watch.stop();
+    });
+    s.run("schema/text", fields_count, [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            protocol_serializer loaded;
+            loader.parse(schema, loaded);
+            keep(loaded.get_internal_buffer_length());
+        }
+        watch.stop();
+    });
+    s.run("schema/snapshot", fields_count, [&](const uint64_t iterations, stopwatch& watch) {
+        watch.start();
+        for (uint64_t i = 0; i < iterations; ++i) {
+            protocol_serializer loaded;
+            loader.load_snapshot(path, loaded);
+            keep(loaded.get_internal_buffer_length());
+        }
+        watch.stop();
+    });
+    remove(path);
+}
+
+struct bench_quote
+{
+    uint32_t id;
+    uint16_t type;
+    int16_t  size;
+    float    price;
+    uint32_t flags;
+};
+
+// Struct member by member (by handles) against struct_binding, once with packed fields and once with struct-like layout
+void benchmark_struct_binding(suite& s)
+{
+    using vt = protocol_serializer::visualization_type;
+    const std::pair<const char*, std::vector<protocol_serializer::field_init>> protocols[] = {
+        {"packed", {{"id", 24}, {"type", 5}, {"size", 13, vt::signed_integer}, {"price", 32, vt::floating_point}, {"flags", 7}}},
+        {"memcpy", {{"id", 32}, {"type", 16}, {"size", 16, vt::signed_integer}, {"price", 32, vt::floating_point}, {"flags", 32}}}};
+
+    for (const auto& protocol : protocols) {
+        const unsigned int packets_count = 1024;
+        protocol_serializer ps(protocol.second, protocol_serializer::get_is_host_little_endian(), protocol_serializer::buffer_source::external);
+        const unsigned int packet_length = ps.get_internal_buffer_length();
+        std::vector<unsigned char> packets(packets_count * packet_length);
+        for (unsigned int i = 0; i < packets.size(); ++i)
+            packets[i] = static_cast<unsigned char>(i * 131);
+        const protocol_serializer::field_handle id = ps.get_field_handle("id");
+        const protocol_serializer::field_handle type = ps.get_field_handle("type");
+        const protocol_serializer::field_handle size = ps.get_field_handle("size");
+        const protocol_serializer::field_handle price = ps.get_field_handle("price");
+        const protocol_serializer::field_handle flags = ps.get_field_handle("flags");
+        ez::struct_binding<bench_quote> binding(ps);
+        binding.bind(EZ_BIND(bench_quote, id)).bind(EZ_BIND(bench_quote, type)).bind(EZ_BIND(bench_quote, size))
+               .bind(EZ_BIND(bench_quote, price)).bind(EZ_BIND(bench_quote, flags));
+        const std::string suffix = std::string("/") + protocol.first;
+
+        s.run("struct_decode/members" + suffix, packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                uint64_t sum = 0;
+                for (unsigned int p = 0; p < packets_count; ++p) {
+                    ps.set_external_buffer(packets.data() + p * packet_length);
+                    bench_quote q;
+                    q.id = ps.read<uint32_t>(id);
+                    q.type = ps.read<uint16_t>(type);
+                    q.size = ps.read<int16_t>(size);
+                    q.price = ps.read<float>(price);
+                    q.flags = ps.read<uint32_t>(flags);
+                    sum += q.id + q.type + q.size + q.flags + static_cast<uint64_t>(q.price);
+                }
+                keep(sum);
+            }
+            watch.stop();
+        });
+        s.run("struct_decode/binding" + suffix, packets.size(), [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                uint64_t sum = 0;
+                for (unsigned int p = 0; p < packets_count; ++p) {
+                    bench_quote q;
+                    binding.decode(packets.data() + p * packet_length, packet_length, q);
+                    sum += q.id + q.type + q.size + q.flags + static_cast<uint64_t>(q.price);
+                }
+                keep(sum);
+            }
+            watch.stop();
+        });
+    }
+}
+
+void benchmark_layout(suite& s)
+{
+    const size_t fields_counts[] = {10, 100, 1000, 10000, 100000};
+    for (const size_t fields_count : fields_counts) {
+        const std::vector<protocol_serializer::field_init> fields = make_fields(fields_count);
+        const std::string suffix = "/fields:" + std::to_string(fields_count);
+        const protocol_serializer prototype(fields, false);
+        const size_t buffer_bytes = prototype.get_internal_buffer_length();
+
+        // One operation is building the whole protocol field by field
+        s.run("append_field" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer ps(false);
+                watch.start();
+                for (const protocol_serializer::field_init& init : fields)
+                    ps.append_field(init);
+                watch.stop();
+            }
+        });
+        s.run("append_fields" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer ps(false);
+                watch.start();
+                ps.append_fields(fields);
+                watch.stop();
+            }
+        });
+        s.run("remove_field_first" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer ps(prototype);
+                ps.reserve(fields_count + 1); // Layout must not be shared, otherwise editing it copies it first
+                watch.start();
+                ps.remove_field("field_0");
+                watch.stop();
+            }
+        });
+        s.run("remove_field_middle" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            const std::string name = "field_" + std::to_string(fields_count / 2);
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer ps(prototype);
+                ps.reserve(fields_count + 1); // Layout must not be shared, otherwise editing it copies it first
+                watch.start();
+                ps.remove_field(name);
+                watch.stop();
+            }
+        });
+        s.run("insert_field_middle" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer ps(prototype);
+                ps.reserve(fields_count + 1); // Layout must not be shared, otherwise editing it copies it first
+                watch.start();
+                ps.insert_field(fields_count / 2, {"inserted", 13});
+                watch.stop();
+            }
+        });
+        s.run("copy" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer copy(prototype);
+                keep(copy.get_internal_buffer_length());
+            }
+            watch.stop();
+        });
+        s.run("move" + suffix, 0, [&](const uint64_t iterations, stopwatch& watch) {
+            protocol_serializer first(prototype);
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i) {
+                protocol_serializer second(std::move(first));
+                first = std::move(second);
+            }
+            watch.stop();
+        });
+    }
+}
+
+void benchmark_visualization(suite& s)
+{
+    const size_t fields_counts[] = {10, 100, 1000};
+    for (const size_t fields_count : fields_counts) {
+        protocol_serializer ps(make_fields(fields_count), false);
+        fill_buffer(ps);
+        const std::string suffix = "/fields:" + std::to_string(fields_count);
+        const size_t buffer_bytes = ps.get_internal_buffer_length();
+
+        s.run("get_visualization" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i)
+                keep(ps.get_visualization(protocol_serializer::visualization_params()).size());
+            watch.stop();
+        });
+        s.run("get_data_visualization" + suffix, buffer_bytes, [&](const uint64_t iterations, stopwatch& watch) {
+            watch.start();
+            for (uint64_t i = 0; i < iterations; ++i)
+                keep(ps.get_data_visualization(protocol_serializer::data_visualization_params()).size());
+            watch.stop();
+        });
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options opts;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc)
+            opts.json_path = argv[++i];
+        else if (arg == "--filter" && i + 1 < argc)
+            opts.filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc)
+            opts.min_time_ns = atof(argv[++i]) * 1e9;
+        else {
+            fprintf(stderr, "Usage: %s [--json <file>] [--filter <substring>] [--min-time <seconds>]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("%-48s %12s %14s %16s %12s\n", "name", "iterations", "ns_per_op", "bytes_per_second", "allocs_per_op");
+    suite s(opts);
+    benchmark_values(s);
+    benchmark_arrays(s);
+    benchmark_messages(s);
+    benchmark_framer(s);
+    benchmark_capture(s);
+    benchmark_parallel_decode(s);
+    benchmark_filter(s);
+    benchmark_projection(s);
+    benchmark_record_plan(s);
+    benchmark_struct_binding(s);
+    benchmark_wide_fields(s);
+    benchmark_variable_length(s);
+    benchmark_groups(s);
+    benchmark_schema_loader(s);
+    benchmark_layout(s);
+    benchmark_visualization(s);
+    return s.write_json() ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#!/usr/bin/env python3
+"""Compares two JSON runs of EzProtocolSerializerBenchmarkSuite and flags regressions.
+
+Usage: compare_benchmarks.py <baseline.json> <contender.json> [--threshold 0.10]
+
+Benchmark regresses when its time per operation grows by more than threshold
+or when it starts allocating more per operation. Exit code is 1 if anything regressed.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as file:
+        return {entry["name"]: entry for entry in json.load(file)["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("contender")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative growth of ns_per_op which is reported as regression (default: 0.10)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    contender = load(args.contender)
+
+    regressions = 0
+    print("%-48s %14s %14s %9s %11s %11s  %s" % ("name", "base_ns", "new_ns", "ratio", "base_alloc", "new_alloc", "status"))
+    for name, new in contender.items():
+        old = baseline.get(name)
+        if old is None:
+            print("%-48s %14s %14.2f %9s %11s %11.2f  new" % (name, "-", new["ns_per_op"], "-", "-", new["allocations_per_op"]))
+            continue
+
+        ratio = new["ns_per_op"] / old["ns_per_op"] if old["ns_per_op"] > 0 else 1.0
+        status = "ok"
+        if ratio > 1.0 + args.threshold:
+            status = "REGRESSION (time)"
+        elif new["allocations_per_op"] > old["allocations_per_op"] + 1e-9:
+            status = "REGRESSION (allocations)"
+        elif ratio < 1.0 - args.threshold:
+            status = "improved"
+        if status.startswith("REGRESSION"):
+            regressions += 1
+
+        print("%-48s %14.2f %14.2f %9.3f %11.2f %11.2f  %s" % (name, old["ns_per_op"], new["ns_per_op"], ratio,
+                                                               old["allocations_per_op"], new["allocations_per_op"], status))
+
+    for name in baseline:
+        if name not in contender:
+            print("%-48s missing in contender" % name)
+
+    print("\n%d regression(s)" % regressions)
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,237 @@
+// Compares register-resident read/write kernel of protocol_serializer against
+// the previous byte-buffer implementation for every (left_spacing, bit_count) combination.
+// Results of both implementations are cross-checked before timing.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <ez_protocol_serializer.h>
+
+using ez::protocol_serializer;
+using field_metadata = ez::protocol_serializer::field_metadata;
+
+namespace legacy {
+
+// Previous implementation of protocol_serializer::_read/_write, kept here as a reference
+const unsigned char right_masks[8] = {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F};
+
+void shift_right(unsigned char* buf, int len, unsigned char shift)
+{
+    if (len <= 0)
+        return;
+
+    unsigned char tmp = 0x00, tmp2 = 0x00;
+    for (int k = 0; k <= len; ++k) {
+        if (k == 0) {
+            tmp = buf[k];
+            buf[k] >>= shift;
+        } else {
+            tmp2 = buf[k];
+            buf[k] >>= shift;
+            buf[k] |= ((tmp & right_masks[shift]) << (8 - shift));
+            if (k != len)
+                tmp = tmp2;
+        }
+    }
+}
+
+template<class T>
+void write(unsigned char* buffer, const field_metadata& metadata, const bool is_little_endian, const T& value)
+{
+    unsigned char raw_bytes[65];
+    memset(raw_bytes, 0, 65);
+    if (std::is_integral<T>::value) {
+        uint64_t val = value;
+        unsigned char* ptr_to_first_copyable_msb = (unsigned char*)&val;
+        if (!protocol_serializer::get_is_host_little_endian())
+            ptr_to_first_copyable_msb += sizeof(uint64_t) - metadata.bytes_count;
+        memcpy(raw_bytes, ptr_to_first_copyable_msb, metadata.bytes_count);
+        if (protocol_serializer::get_is_host_little_endian() != is_little_endian)
+            for (uint32_t i = 0; i < metadata.bytes_count / 2; ++i)
+                std::swap(raw_bytes[i], raw_bytes[metadata.bytes_count - 1 - i]);
+    }
+
+    if (metadata.left_spacing == 0 && metadata.right_spacing == 0) {
+        memcpy(buffer + metadata.first_byte_ind, raw_bytes, metadata.bytes_count);
+        return;
+    }
+
+    unsigned char* final_bytes = raw_bytes;
+    if (metadata.right_spacing) {
+        shift_right(raw_bytes, metadata.bytes_count + 1, 8 - metadata.right_spacing);
+        if (unsigned char transferable_bits_count = metadata.bit_count % 8)
+            if (8 - metadata.right_spacing >= transferable_bits_count)
+                final_bytes = raw_bytes + 1;
+    }
+
+    unsigned char mask = 0;
+    for (uint32_t i = 0; i < metadata.touched_bytes_count; ++i) {
+        mask = i == 0 ? metadata.first_mask : i != metadata.touched_bytes_count - 1 ? 0xFF : metadata.last_mask;
+        buffer[metadata.first_byte_ind + i] &= ~mask;
+        buffer[metadata.first_byte_ind + i] |= final_bytes[i] & mask;
+    }
+}
+
+template<class T>
+T read(const unsigned char* buffer, const field_metadata& metadata, const bool is_little_endian)
+{
+    unsigned char raw_bytes[65];
+    memset(raw_bytes, 0, 65);
+    unsigned char* final_bytes = protocol_serializer::get_is_host_little_endian() ? raw_bytes : raw_bytes + 64 - metadata.touched_bytes_count;
+    memcpy(final_bytes, buffer + metadata.first_byte_ind, metadata.touched_bytes_count);
+
+    if (metadata.right_spacing || metadata.left_spacing) {
+        final_bytes[0] &= metadata.first_mask;
+        if (metadata.touched_bytes_count > 1)
+            final_bytes[metadata.touched_bytes_count - 1] &= metadata.last_mask;
+
+        if (metadata.right_spacing) {
+            shift_right(final_bytes, metadata.touched_bytes_count, metadata.right_spacing);
+            final_bytes += metadata.touched_bytes_count - metadata.bytes_count;
+        }
+    }
+
+    if (protocol_serializer::get_is_host_little_endian() != is_little_endian)
+        for (uint32_t i = 0; i < metadata.bytes_count / 2; ++i)
+            std::swap(final_bytes[i], final_bytes[metadata.bytes_count - i - 1]);
+
+    if (!protocol_serializer::get_is_host_little_endian())
+        final_bytes = raw_bytes + 64 - sizeof(T);
+
+    if (std::is_signed<T>::value) {
+        const unsigned char shift_to_reach_most_significant_bit = 7 - (metadata.left_spacing + metadata.right_spacing) % 8;
+        const bool regular_cast_is_enough = metadata.bytes_count == sizeof(T) && shift_to_reach_most_significant_bit == 7;
+        if (!regular_cast_is_enough) {
+            unsigned char msb = 0;
+            if (!protocol_serializer::get_is_host_little_endian())
+                msb = raw_bytes[64 - std::min(metadata.bytes_count, static_cast<unsigned int>(sizeof(T)))];
+            else
+                msb = final_bytes[std::min(metadata.bytes_count, static_cast<unsigned int>(sizeof(T))) - 1];
+
+            if (msb & (1 << shift_to_reach_most_significant_bit)) {
+                T value;
+                memcpy(&value, final_bytes, sizeof(T));
+                return static_cast<T>(value - ((uint64_t)1 << (std::min(metadata.bit_count, static_cast<unsigned int>(sizeof(T)) * 8))));
+            }
+        }
+    }
+
+    T value;
+    memcpy(&value, final_bytes, sizeof(T));
+    return value;
+}
+
+}
+
+namespace {
+
+const unsigned int records_count = 64;
+const unsigned int iterations = 200000;
+
+template<class Function>
+double measure_ns_per_op(Function function)
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int i = 0; i < iterations; ++i)
+        function(i);
+    const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+template<class T>
+bool reads_match(protocol_serializer& ps, const protocol_serializer::field_handle& handle, const field_metadata& metadata, const bool is_little_endian)
+{
+    return ps.read<T>(handle) == legacy::read<T>(ps.get_working_buffer(), metadata, is_little_endian);
+}
+
+template<class T>
+bool writes_match(protocol_serializer& ps, const protocol_serializer::field_handle& handle, const field_metadata& metadata, const bool is_little_endian, const T value)
+{
+    const unsigned int length = ps.get_internal_buffer_length();
+    std::vector<unsigned char> expected(ps.get_working_buffer(), ps.get_working_buffer() + length);
+    legacy::write(expected.data(), metadata, is_little_endian, value);
+    ps.write(handle, value);
+    return memcmp(expected.data(), ps.get_working_buffer(), length) == 0;
+}
+
+// Cross-checks both implementations on random buffers and values
+bool verify(const unsigned int left_spacing, const unsigned int bit_count, std::mt19937_64& random)
+{
+    for (int is_little_endian = 0; is_little_endian <= 1; ++is_little_endian) {
+        if (is_little_endian && bit_count > 8 && bit_count % 8)
+            continue;
+
+        protocol_serializer ps({{"offset", left_spacing ? left_spacing : 8}, {"value", bit_count}, {"tail", 8}}, is_little_endian != 0);
+        const protocol_serializer::field_handle handle = ps.get_field_handle("value");
+        const field_metadata metadata = ps.get_field_metadata(handle);
+        for (int attempt = 0; attempt < 64; ++attempt) {
+            for (unsigned int i = 0; i < ps.get_internal_buffer_length(); ++i)
+                ps.get_working_buffer()[i] = static_cast<unsigned char>(random());
+
+            bool ok = reads_match<int8_t>(ps, handle, metadata, is_little_endian) && reads_match<uint8_t>(ps, handle, metadata, is_little_endian)
+                   && reads_match<int16_t>(ps, handle, metadata, is_little_endian) && reads_match<uint16_t>(ps, handle, metadata, is_little_endian)
+                   && reads_match<int32_t>(ps, handle, metadata, is_little_endian) && reads_match<uint32_t>(ps, handle, metadata, is_little_endian)
+                   && reads_match<int64_t>(ps, handle, metadata, is_little_endian) && reads_match<uint64_t>(ps, handle, metadata, is_little_endian);
+            ok = ok && writes_match<uint64_t>(ps, handle, metadata, is_little_endian, random())
+                    && writes_match<int64_t>(ps, handle, metadata, is_little_endian, static_cast<int64_t>(random()))
+                    && writes_match<int16_t>(ps, handle, metadata, is_little_endian, static_cast<int16_t>(random()));
+            if (!ok)
+                return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main()
+{
+    std::mt19937_64 random(42);
+    bool all_match = true;
+    // Values read by timed loops are printed at the end, so that the loops can not be optimized away
+    uint64_t read_checksum = 0;
+
+    printf("left_spacing bit_count legacy_read_ns fast_read_ns read_speedup legacy_write_ns fast_write_ns write_speedup\n");
+    for (unsigned int left_spacing = 0; left_spacing < 8; ++left_spacing) {
+        for (unsigned int bit_count = 1; bit_count <= 64; ++bit_count) {
+            if (!verify(left_spacing, bit_count, random)) {
+                printf("MISMATCH left_spacing=%u bit_count=%u\n", left_spacing, bit_count);
+                all_match = false;
+                continue;
+            }
+
+            // Rotate through a few records so that reads can not be hoisted out of the loop
+            protocol_serializer ps({{"offset", left_spacing ? left_spacing : 8}, {"value", bit_count}}, false, protocol_serializer::buffer_source::external);
+            const protocol_serializer::field_handle handle = ps.get_field_handle("value");
+            const field_metadata metadata = ps.get_field_metadata(handle);
+            const unsigned int record_length = ps.get_internal_buffer_length();
+            std::vector<unsigned char> records(record_length * records_count);
+            for (unsigned char& byte : records)
+                byte = static_cast<unsigned char>(random());
+
+            int64_t sum = 0;
+            const double legacy_read = measure_ns_per_op([&](unsigned int i) {
+                sum += legacy::read<int64_t>(&records[(i % records_count) * record_length], metadata, false);
+            });
+            const double fast_read = measure_ns_per_op([&](unsigned int i) {
+                ps.set_external_buffer(&records[(i % records_count) * record_length]);
+                sum += ps.read<int64_t>(handle);
+            });
+            const double legacy_write = measure_ns_per_op([&](unsigned int i) {
+                legacy::write<int64_t>(&records[(i % records_count) * record_length], metadata, false, i);
+            });
+            const double fast_write = measure_ns_per_op([&](unsigned int i) {
+                ps.set_external_buffer(&records[(i % records_count) * record_length]);
+                ps.write<int64_t>(handle, i);
+            });
+            read_checksum += static_cast<uint64_t>(sum);
+
+            printf("%12u %9u %14.2f %12.2f %12.2f %15.2f %13.2f %13.2f\n", left_spacing, bit_count,
+                   legacy_read, fast_read, legacy_read / fast_read, legacy_write, fast_write, legacy_write / fast_write);
+        }
+    }
+
+    printf("read checksum %016llx\n", static_cast<unsigned long long>(read_checksum));
+    return all_match ? 0 : 1;
+}
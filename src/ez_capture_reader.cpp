@@ -0,0 +1,119 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ez_capture_reader.h>
+#include <algorithm>
+
+using ez::capture_reader;
+
+capture_reader::capture_reader(const protocol_serializer& ps)
+    : capture_reader(ps.get_layout(), ps.get_is_little_endian())
+{
+}
+
+capture_reader::capture_reader(const layout_ptr_t& layout, const bool is_little_endian)
+    : m_layout(layout)
+    , m_is_little_endian(is_little_endian)
+{
+    if (!m_layout->fields_metadata.empty()) {
+        const protocol_serializer::field_metadata& last_field = m_layout->fields_metadata.back();
+        const uint64_t bit_count = last_field.first_bit_ind + uint64_t(last_field.bit_count);
+        m_record_length = bit_count / 8 + ((bit_count % 8) ? 1 : 0);
+    }
+}
+
+void capture_reader::move_from(capture_reader&& other)
+{
+    m_layout = other.m_layout;
+    m_is_little_endian = other.m_is_little_endian;
+    m_file = std::move(other.m_file);
+    m_header_length = other.m_header_length;
+    m_record_length = other.m_record_length;
+    m_record_stride = other.m_record_stride;
+    m_records_count = other.m_records_count;
+
+    // Moved-from reader keeps its layout, but is closed
+    other.m_records_count = 0;
+}
+
+capture_reader::capture_reader(capture_reader&& other) noexcept
+    : m_layout(other.m_layout)
+    , m_is_little_endian(other.m_is_little_endian)
+{
+    move_from(std::move(other));
+}
+
+capture_reader& capture_reader::operator=(capture_reader&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        move_from(std::move(other));
+    }
+    return *this;
+}
+
+capture_reader::~capture_reader()
+{
+    close();
+}
+
+ez::protocol_serializer::result_code capture_reader::open(const std::string& path)
+{
+    return open(path, capture_params());
+}
+
+ez::protocol_serializer::result_code capture_reader::open(const std::string& path, const capture_params& params)
+{
+    close();
+
+    const uint64_t record_stride = params.record_stride == 0 ? m_record_length : params.record_stride;
+    if (m_record_length == 0 || record_stride < m_record_length)
+        return result_code::bad_input;
+
+    // Empty files are valid captures without records
+    const result_code open_result = m_file.open(path, params.access);
+    if (open_result != result_code::ok)
+        return open_result;
+
+    const uint64_t file_length = m_file.get_length();
+    m_header_length = params.header_length;
+    m_record_stride = record_stride;
+    m_records_count = 0;
+    if (file_length >= m_header_length + m_record_length)
+        m_records_count = (file_length - m_header_length - m_record_length) / m_record_stride + 1;
+
+    return result_code::ok;
+}
+
+void capture_reader::close()
+{
+    m_file.close();
+    m_records_count = 0;
+}
+
+void capture_reader::prefetch(const uint64_t first_record, const uint64_t records_count) const
+{
+    if (first_record >= m_records_count || records_count == 0)
+        return;
+
+    const uint64_t last_record = std::min(first_record + records_count, m_records_count) - 1;
+    const uint64_t first_byte = m_header_length + first_record * m_record_stride;
+    const uint64_t end_byte = m_header_length + last_record * m_record_stride + m_record_length;
+    m_file.prefetch(first_byte, end_byte);
+}
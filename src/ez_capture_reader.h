@@ -0,0 +1,131 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_CAPTURE_READER
+#define EZ_CAPTURE_READER
+
+#include <ez_protocol_serializer.h>
+#include <ez_mapped_file.h>
+#include <iterator>
+
+namespace ez {
+
+// Read-only memory mapping of a capture file of fixed-layout records. Records are accessed as views
+// of the mapping, so nothing is copied and pages are loaded by the OS only once they are touched.
+// Offsets are 64-bit, so files larger than 4 GiB are supported on 64-bit platforms.
+class capture_reader
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+    using access_pattern = detail::mapped_file::access_pattern;
+
+    struct capture_params
+    {
+        capture_params& set_header_length(const uint64_t length) { this->header_length = length; return *this; }
+        capture_params& set_record_stride(const uint64_t stride) { this->record_stride = stride; return *this; }
+        capture_params& set_access_pattern(const access_pattern pattern) { this->access = pattern; return *this; }
+        uint64_t header_length = 0;               // Bytes before the first record
+        uint64_t record_stride = 0;               // Distance between beginnings of records, 0 means records are back-to-back
+        access_pattern access = access_pattern::sequential;
+    };
+
+    // Random access iterator over views of records
+    class iterator
+    {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = const_message_view;
+        using difference_type = int64_t;
+        using pointer = void;
+        using reference = const_message_view;
+
+        iterator() = default;
+        iterator(const capture_reader* reader, const uint64_t index) : m_reader(reader), m_index(index) {}
+
+        const_message_view operator*() const { return (*m_reader)[m_index]; }
+        const_message_view operator[](const difference_type offset) const { return (*m_reader)[m_index + offset]; }
+        iterator& operator++() { ++m_index; return *this; }
+        iterator& operator--() { --m_index; return *this; }
+        iterator  operator++(int) { iterator previous = *this; ++m_index; return previous; }
+        iterator  operator--(int) { iterator previous = *this; --m_index; return previous; }
+        iterator& operator+=(const difference_type offset) { m_index += offset; return *this; }
+        iterator& operator-=(const difference_type offset) { m_index -= offset; return *this; }
+        iterator  operator+(const difference_type offset) const { return iterator(m_reader, m_index + offset); }
+        iterator  operator-(const difference_type offset) const { return iterator(m_reader, m_index - offset); }
+        difference_type operator-(const iterator& other) const { return static_cast<difference_type>(m_index - other.m_index); }
+        bool operator==(const iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const iterator& other) const { return m_index != other.m_index; }
+        bool operator<(const iterator& other) const { return m_index < other.m_index; }
+        bool operator>(const iterator& other) const { return m_index > other.m_index; }
+        bool operator<=(const iterator& other) const { return m_index <= other.m_index; }
+        bool operator>=(const iterator& other) const { return m_index >= other.m_index; }
+
+    private:
+        const capture_reader* m_reader = nullptr;
+        uint64_t              m_index = 0;
+    };
+
+    explicit capture_reader(const protocol_serializer& ps);
+    capture_reader(const layout_ptr_t& layout, const bool is_little_endian = false);
+    capture_reader(const capture_reader& other) = delete;
+    capture_reader& operator=(const capture_reader& other) = delete;
+    capture_reader(capture_reader&& other) noexcept;
+    capture_reader& operator=(capture_reader&& other) noexcept;
+    ~capture_reader();
+
+    // Maps whole file. Trailing bytes which do not form a complete record are ignored
+    result_code open(const std::string& path);
+    result_code open(const std::string& path, const capture_params& params);
+    void        close();
+    bool        is_open() const { return m_file.is_open(); }
+
+    // Hints OS to read records [first_record, first_record + records_count) ahead of access
+    void prefetch(const uint64_t first_record, const uint64_t records_count) const;
+
+    uint64_t             get_records_count() const { return m_records_count; }
+    uint64_t             get_record_length() const { return m_record_length; }
+    uint64_t             get_record_stride() const { return m_record_stride; }
+    uint64_t             get_file_length() const { return m_file.get_length(); }
+    const unsigned char* get_data() const { return m_file.get_data(); }
+
+    // Records are not checked against records count, just like elements of std::vector
+    const_message_view operator[](const uint64_t index) const
+    {
+        return const_message_view(*m_layout, m_file.get_data() + m_header_length + index * m_record_stride, static_cast<size_t>(m_record_length), m_is_little_endian);
+    }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, m_records_count); }
+
+private:
+    void move_from(capture_reader&& other);
+
+    layout_ptr_t        m_layout;
+    bool                m_is_little_endian;
+    detail::mapped_file m_file;
+    uint64_t            m_header_length = 0;
+    uint64_t            m_record_length = 0;
+    uint64_t            m_record_stride = 0;
+    uint64_t            m_records_count = 0;
+};
+
+}
+
+#endif // EZ_CAPTURE_READER
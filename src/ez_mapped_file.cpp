@@ -0,0 +1,171 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <ez_mapped_file.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using ez::detail::mapped_file;
+
+mapped_file::mapped_file(mapped_file&& other) noexcept
+{
+    move_from(std::move(other));
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        move_from(std::move(other));
+    }
+    return *this;
+}
+
+mapped_file::~mapped_file()
+{
+    close();
+}
+
+void mapped_file::move_from(mapped_file&& other)
+{
+    m_is_open = other.m_is_open;
+    m_data = other.m_data;
+    m_length = other.m_length;
+#ifdef _WIN32
+    m_mapping_handle = other.m_mapping_handle;
+    other.m_mapping_handle = nullptr;
+#endif
+
+    other.m_is_open = false;
+    other.m_data = nullptr;
+    other.m_length = 0;
+}
+
+ez::protocol_serializer::result_code mapped_file::open(const std::string& path, const access_pattern access)
+{
+    close();
+
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    if (access == access_pattern::sequential)
+        flags |= FILE_FLAG_SEQUENTIAL_SCAN;
+    else if (access == access_pattern::random)
+        flags |= FILE_FLAG_RANDOM_ACCESS;
+    const HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return result_code::io_error;
+
+    LARGE_INTEGER file_length;
+    if (!GetFileSizeEx(file, &file_length) || uint64_t(file_length.QuadPart) > SIZE_MAX) {
+        CloseHandle(file);
+        return result_code::io_error;
+    }
+
+    if (file_length.QuadPart != 0) {
+        const HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        if (data == nullptr) {
+            if (mapping != nullptr)
+                CloseHandle(mapping);
+            CloseHandle(file);
+            return result_code::io_error;
+        }
+        m_mapping_handle = mapping;
+        m_data = static_cast<const unsigned char*>(data);
+    }
+    CloseHandle(file);
+    m_length = file_length.QuadPart;
+#else
+    const int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return result_code::io_error;
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) != 0 || uint64_t(file_stat.st_size) > SIZE_MAX) {
+        ::close(file);
+        return result_code::io_error;
+    }
+
+    if (file_stat.st_size != 0) {
+        void* data = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (data == MAP_FAILED) {
+            ::close(file);
+            return result_code::io_error;
+        }
+
+        // Kernel reads ahead much more aggressively for sequential mappings
+        if (access == access_pattern::sequential)
+            madvise(data, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+        else if (access == access_pattern::random)
+            madvise(data, static_cast<size_t>(file_stat.st_size), MADV_RANDOM);
+        m_data = static_cast<const unsigned char*>(data);
+    }
+    ::close(file);
+    m_length = file_stat.st_size;
+#endif
+
+    m_is_open = true;
+    return result_code::ok;
+}
+
+void mapped_file::close()
+{
+    if (!m_is_open)
+        return;
+
+#ifdef _WIN32
+    if (m_data != nullptr)
+        UnmapViewOfFile(m_data);
+    if (m_mapping_handle != nullptr)
+        CloseHandle(m_mapping_handle);
+    m_mapping_handle = nullptr;
+#else
+    if (m_data != nullptr)
+        munmap(const_cast<unsigned char*>(m_data), static_cast<size_t>(m_length));
+#endif
+
+    m_is_open = false;
+    m_data = nullptr;
+    m_length = 0;
+}
+
+void mapped_file::prefetch(const uint64_t first_byte, const uint64_t end_byte) const
+{
+    if (m_data == nullptr || first_byte >= end_byte || end_byte > m_length)
+        return;
+
+    // On Windows read ahead is only controlled by access pattern given to open()
+#ifndef _WIN32
+    // madvise() requires page-aligned address
+    const uint64_t page_length = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t aligned_first_byte = first_byte / page_length * page_length;
+    madvise(const_cast<unsigned char*>(m_data) + aligned_first_byte, static_cast<size_t>(end_byte - aligned_first_byte), MADV_WILLNEED);
+#endif
+}
@@ -0,0 +1,74 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#ifndef EZ_MAPPED_FILE
+#define EZ_MAPPED_FILE
+
+#include <ez_protocol_serializer.h>
+
+namespace ez {
+namespace detail {
+
+// Read-only mapping of a whole file, platform calls of capture_reader and schema_loader are kept here.
+// Empty files can not be mapped, they are opened without data
+class mapped_file
+{
+public:
+    using result_code = protocol_serializer::result_code;
+
+    enum class access_pattern
+    {
+        normal,
+        sequential,
+        random
+    };
+
+    mapped_file() = default;
+    mapped_file(const mapped_file& other) = delete;
+    mapped_file& operator=(const mapped_file& other) = delete;
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+    ~mapped_file();
+
+    result_code open(const std::string& path, const access_pattern access = access_pattern::normal);
+    void        close();
+    bool        is_open() const { return m_is_open; }
+
+    // Hints OS to read bytes [first_byte, end_byte) ahead of access
+    void prefetch(const uint64_t first_byte, const uint64_t end_byte) const;
+
+    const unsigned char* get_data() const { return m_data; }
+    uint64_t             get_length() const { return m_length; }
+
+private:
+    void move_from(mapped_file&& other);
+
+    bool                 m_is_open = false;
+    const unsigned char* m_data = nullptr;
+    uint64_t             m_length = 0;
+#ifdef _WIN32
+    void*                m_mapping_handle = nullptr;
+#endif
+};
+
+}
+}
+
+#endif // EZ_MAPPED_FILE
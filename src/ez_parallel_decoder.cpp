@@ -0,0 +1,149 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ez_parallel_decoder.h>
+#include <algorithm>
+
+using ez::parallel_decoder;
+
+parallel_decoder::parallel_decoder(const protocol_serializer& ps, const unsigned int threads_count)
+    : parallel_decoder(ps.get_layout(), ps.get_is_little_endian(), threads_count)
+{
+}
+
+parallel_decoder::parallel_decoder(const layout_ptr_t& layout, const bool is_little_endian, const unsigned int threads_count)
+    : m_layout(layout)
+    , m_is_little_endian(is_little_endian)
+    , m_next_chunk(0)
+{
+    unsigned int total_threads_count = threads_count ? threads_count : std::thread::hardware_concurrency();
+    total_threads_count = std::max(total_threads_count, 1u);
+
+    // Calling thread decodes too, so one thread less is started
+    m_workers.reserve(total_threads_count - 1);
+    for (unsigned int i = 1; i < total_threads_count; ++i)
+        m_workers.emplace_back(&parallel_decoder::work, this);
+}
+
+parallel_decoder::~parallel_decoder()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_is_stopping = true;
+    }
+    m_job_started.notify_all();
+    for (std::thread& worker : m_workers)
+        worker.join();
+}
+
+void parallel_decoder::clear_columns()
+{
+    m_columns.clear();
+}
+
+ez::protocol_serializer::result_code parallel_decoder::decode(const unsigned char* records, const size_t record_stride, const uint64_t records_count)
+{
+    if (records_count == 0 || m_columns.empty())
+        return result_code::ok;
+
+    if (records == nullptr)
+        return result_code::bad_input;
+
+    const uint64_t chunk_records_count = std::max<uint64_t>(m_chunk_length / std::max<size_t>(record_stride, 1), 1);
+    const uint64_t chunks_count = (records_count + chunk_records_count - 1) / chunk_records_count;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_records = records;
+        m_record_stride = record_stride;
+        m_records_count = records_count;
+        m_chunk_records_count = chunk_records_count;
+        m_chunks_count = chunks_count;
+        m_next_chunk = 0;
+    }
+
+    // Single chunk is not worth waking workers up
+    if (chunks_count == 1 || m_workers.empty()) {
+        decode_chunks();
+        return result_code::ok;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_busy_workers_count = static_cast<unsigned int>(m_workers.size());
+        ++m_job_generation;
+    }
+    m_job_started.notify_all();
+    decode_chunks();
+
+    // Columns written by workers are visible once they report under the mutex
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_job_finished.wait(lock, [this]() { return m_busy_workers_count == 0; });
+    return result_code::ok;
+}
+
+void parallel_decoder::set_chunk_length(const size_t length)
+{
+    m_chunk_length = length;
+}
+
+size_t parallel_decoder::get_chunk_length() const
+{
+    return m_chunk_length;
+}
+
+unsigned int parallel_decoder::get_threads_count() const
+{
+    return static_cast<unsigned int>(m_workers.size()) + 1;
+}
+
+void parallel_decoder::work()
+{
+    uint64_t finished_generation = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_job_started.wait(lock, [this, finished_generation]() { return m_is_stopping || m_job_generation != finished_generation; });
+            if (m_is_stopping)
+                return;
+            finished_generation = m_job_generation;
+        }
+
+        decode_chunks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy_workers_count == 0)
+            m_job_finished.notify_one();
+    }
+}
+
+void parallel_decoder::decode_chunks()
+{
+    // All columns of a chunk are decoded while its records are still in cache
+    while (true) {
+        const uint64_t chunk = m_next_chunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= m_chunks_count)
+            return;
+
+        const uint64_t first_record = chunk * m_chunk_records_count;
+        const size_t records_count = static_cast<size_t>(std::min(m_chunk_records_count, m_records_count - first_record));
+        for (const column& c : m_columns)
+            c.decode(c, m_records, m_record_stride, first_record, records_count, m_is_little_endian);
+    }
+}
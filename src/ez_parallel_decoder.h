@@ -0,0 +1,132 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_PARALLEL_DECODER
+#define EZ_PARALLEL_DECODER
+
+#include <ez_protocol_serializer.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace ez {
+
+// Decodes chosen fields of a large batch of records (see protocol_serializer::read_column()) on several threads.
+// Records are split into chunks of about chunk_length bytes, so that a chunk stays in cache while all of its columns are decoded.
+// Every chunk is written into its own part of the columns, so the output does not depend on the number of threads.
+// Workers only read shared layout and records, serializer is never copied.
+class parallel_decoder
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using field_handle = protocol_serializer::field_handle;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+
+    // threads_count includes calling thread, 0 means std::thread::hardware_concurrency()
+    explicit parallel_decoder(const protocol_serializer& ps, const unsigned int threads_count = 0);
+    parallel_decoder(const layout_ptr_t& layout, const bool is_little_endian, const unsigned int threads_count = 0);
+    parallel_decoder(const parallel_decoder& other) = delete;
+    parallel_decoder& operator=(const parallel_decoder& other) = delete;
+    ~parallel_decoder();
+
+    // Column has to have room for records_count values of every following decode()
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code add_column(const std::string& name, T* column)
+    {
+        return _add_column(m_layout->find_metadata(name), column);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code add_column(const field_handle& handle, T* column)
+    {
+        return _add_column(m_layout->find_metadata(handle), column);
+    }
+
+    void clear_columns();
+
+    // Records are record_stride bytes apart starting at records
+    result_code decode(const unsigned char* records, const size_t record_stride, const uint64_t records_count);
+
+    void         set_chunk_length(const size_t length);
+    size_t       get_chunk_length() const;
+    unsigned int get_threads_count() const;
+
+private:
+    struct column
+    {
+        protocol_serializer::field_metadata metadata;
+        void* output;
+        void (*decode)(const column& c, const unsigned char* records, size_t record_stride, uint64_t first_record, size_t records_count, bool is_little_endian);
+    };
+
+    template<class T>
+    result_code _add_column(const protocol_serializer::field_metadata* metadata, T* output)
+    {
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        const result_code validation_result = protocol_serializer::validate_access<T>(m_is_little_endian, metadata->bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
+
+        if (output == nullptr)
+            return result_code::bad_input;
+
+        m_columns.push_back(column{*metadata, output, decode_column<T>});
+        return result_code::ok;
+    }
+
+    template<class T>
+    static void decode_column(const column& c, const unsigned char* records, const size_t record_stride, const uint64_t first_record,
+                              const size_t records_count, const bool is_little_endian)
+    {
+        const protocol_serializer::field_metadata& metadata = c.metadata;
+        detail::read_column(records + first_record * record_stride + metadata.first_byte_ind, record_stride, records_count, metadata.touched_bytes_count,
+                            metadata.right_spacing, metadata.bit_count, metadata.bytes_count, is_little_endian, static_cast<T*>(c.output) + first_record);
+    }
+
+    void work();
+    void decode_chunks();
+
+    layout_ptr_t             m_layout;
+    bool                     m_is_little_endian;
+    std::vector<column>      m_columns;
+    size_t                   m_chunk_length = 256 * 1024;
+    std::vector<std::thread> m_workers;
+
+    // Current job, workers and calling thread take chunks one by one
+    const unsigned char*     m_records = nullptr;
+    size_t                   m_record_stride = 0;
+    uint64_t                 m_records_count = 0;
+    uint64_t                 m_chunk_records_count = 0;
+    uint64_t                 m_chunks_count = 0;
+    std::atomic<uint64_t>    m_next_chunk;
+
+    std::mutex               m_mutex;
+    std::condition_variable  m_job_started;
+    std::condition_variable  m_job_finished;
+    uint64_t                 m_job_generation = 0;
+    unsigned int             m_busy_workers_count = 0;
+    bool                     m_is_stopping = false;
+};
+
+}
+
+#endif // EZ_PARALLEL_DECODER
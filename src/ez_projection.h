@@ -0,0 +1,191 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_PROJECTION
+#define EZ_PROJECTION
+
+#include <ez_protocol_serializer.h>
+#include <algorithm>
+#include <array>
+#include <tuple>
+#include <utility>
+
+namespace ez {
+
+// Decodes chosen fields of a record into values of types Ts... at once. Fields are resolved once by set_fields().
+// Fields which fit into the same 8 bytes share a window: window is loaded once and all of its fields are cut out of it,
+// so touched bytes are read once however many fields lie in them.
+template<class... Ts>
+class projection
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+    using names_t = std::array<std::string, sizeof...(Ts)>;
+
+    explicit projection(const protocol_serializer& ps) :
+        projection(ps.get_layout(), ps.get_is_little_endian())
+    {
+    }
+
+    projection(const layout_ptr_t& layout, const bool is_little_endian = false) :
+        m_layout(layout), m_is_little_endian(is_little_endian)
+    {
+    }
+
+    // names[i] is decoded into i-th of Ts. Fails with field_not_found/not_applicable (see read()), previous fields are kept then
+    result_code set_fields(const names_t& names)
+    {
+        metadata_t metadata;
+        const result_code resolve_result = resolve(names, metadata, std::index_sequence_for<Ts...>());
+        if (resolve_result != result_code::ok)
+            return resolve_result;
+
+        // Fields are grouped in order of their position
+        std::array<unsigned int, sizeof...(Ts)> order;
+        for (unsigned int i = 0; i < order.size(); ++i)
+            order[i] = i;
+        std::sort(order.begin(), order.end(), [&metadata](const unsigned int a, const unsigned int b) { return metadata[a]->first_bit_ind < metadata[b]->first_bit_ind; });
+
+        metadata_t sorted;
+        std::array<unsigned int, sizeof...(Ts)> shifts;
+        for (unsigned int i = 0; i < order.size(); ++i)
+            sorted[i] = metadata[order[i]];
+        m_windows_count = static_cast<unsigned int>(detail::group_into_windows(sorted.data(), sorted.size(), m_windows.data(), shifts.data()));
+
+        m_required_length = 0;
+        for (unsigned int i = 0; i < order.size(); ++i) {
+            const protocol_serializer::field_metadata& field = *sorted[i];
+            m_fields[i] = plan_field{order[i], shifts[i], field.bit_count};
+            m_slots[order[i]] = slot{field.bit_count, field.bytes_count};
+            m_required_length = std::max<size_t>(m_required_length, field.first_byte_ind + field.touched_bytes_count);
+        }
+
+        m_is_set = true;
+        return result_code::ok;
+    }
+
+    // Buffer has to hold at least get_required_length() bytes
+    result_code decode(const unsigned char* buffer, const size_t length, Ts&... values) const
+    {
+        if (!m_is_set)
+            return result_code::not_applicable;
+
+        if (buffer == nullptr)
+            return result_code::bad_input;
+
+        if (length < m_required_length)
+            return result_code::buffer_too_short;
+
+        uint64_t raw[sizeof...(Ts) + 1];
+        for (unsigned int w = 0; w < m_windows_count; ++w) {
+            const window& current = m_windows[w];
+            const unsigned char* ptr = buffer + current.first_byte_ind;
+            if (current.bytes_count > 8) {
+                // Unaligned 64-bit field is the only field of its window
+                const plan_field& field = m_fields[current.first_field];
+                raw[field.slot_index] = detail::extract_bits(ptr, current.bytes_count, field.shift, field.bit_count);
+                continue;
+            }
+
+            const uint64_t word = detail::load_be(ptr, current.bytes_count);
+            for (unsigned int i = current.first_field; i < current.first_field + current.fields_count; ++i)
+                raw[m_fields[i].slot_index] = (word >> m_fields[i].shift) & detail::low_bits_mask(m_fields[i].bit_count);
+        }
+
+        assign(raw, std::index_sequence_for<Ts...>(), values...);
+        return result_code::ok;
+    }
+
+    result_code decode(const unsigned char* buffer, const size_t length, std::tuple<Ts...>& values) const
+    {
+        return decode_tuple(buffer, length, values, std::index_sequence_for<Ts...>());
+    }
+
+    size_t       get_required_length() const { return m_required_length; }
+    unsigned int get_windows_count() const { return m_windows_count; }
+
+private:
+    // Fields of a window are a range of m_fields
+    using window = detail::field_window;
+
+    struct plan_field
+    {
+        unsigned int slot_index;
+        unsigned int shift;
+        unsigned int bit_count;
+    };
+
+    struct slot
+    {
+        unsigned int bit_count;
+        unsigned int bytes_count;
+    };
+
+    using metadata_t = std::array<const protocol_serializer::field_metadata*, sizeof...(Ts)>;
+
+    template<size_t... Indices>
+    result_code resolve(const names_t& names, metadata_t& metadata, std::index_sequence<Indices...>) const
+    {
+        const result_code results[] = {result_code::ok, resolve<Ts>(names[Indices], metadata[Indices])...};
+        for (const result_code result : results) {
+            if (result != result_code::ok)
+                return result;
+        }
+        return result_code::ok;
+    }
+
+    template<class T>
+    result_code resolve(const std::string& name, const protocol_serializer::field_metadata*& metadata) const
+    {
+        metadata = m_layout->find_metadata(name);
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        return protocol_serializer::validate_access<T>(m_is_little_endian, metadata->bit_count);
+    }
+
+    template<size_t... Indices>
+    void assign(const uint64_t* raw, std::index_sequence<Indices...>, Ts&... values) const
+    {
+        const int expand[] = {0, (values = detail::decode_value<Ts>(raw[Indices], m_slots[Indices].bit_count, m_slots[Indices].bytes_count, m_is_little_endian), 0)...};
+        (void)expand;
+        (void)raw;
+    }
+
+    template<size_t... Indices>
+    result_code decode_tuple(const unsigned char* buffer, const size_t length, std::tuple<Ts...>& values, std::index_sequence<Indices...>) const
+    {
+        (void)values;
+        return decode(buffer, length, std::get<Indices>(values)...);
+    }
+
+    layout_ptr_t                              m_layout;
+    bool                                      m_is_little_endian;
+    bool                                      m_is_set = false;
+    std::array<window, sizeof...(Ts)>         m_windows;
+    unsigned int                              m_windows_count = 0;
+    std::array<plan_field, sizeof...(Ts)>     m_fields;
+    std::array<slot, sizeof...(Ts)>           m_slots;
+    size_t                                    m_required_length = 0;
+};
+
+}
+
+#endif // EZ_PROJECTION
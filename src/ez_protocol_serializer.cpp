@@ -18,8 +18,22 @@
 // SOFTWARE.
 
 #include <ez_protocol_serializer.h>
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 
+// AVX2 array kernel is compiled for x86-64 regardless of compiler flags and is only called when CPU supports it
+#if !defined(EZ_PROTOCOL_SERIALIZER_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define EZ_PROTOCOL_SERIALIZER_AVX2
+#define EZ_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif !defined(EZ_PROTOCOL_SERIALIZER_NO_SIMD) && defined(_MSC_VER) && defined(_M_X64)
+#define EZ_PROTOCOL_SERIALIZER_AVX2
+#define EZ_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
 using ez::protocol_serializer;
 
 protocol_serializer::protocol_serializer(const bool is_little_endian, const protocol_serializer::buffer_source source, byte_ptr_t const external_buffer)
@@ -37,12 +51,8 @@ protocol_serializer::protocol_serializer(const bool is_little_endian, const prot
 protocol_serializer::protocol_serializer(const std::vector<field_init>& fields, const bool is_little_endian, const buffer_source source, byte_ptr_t const external_buffer)
     : protocol_serializer(is_little_endian, source, external_buffer)
 {
-    for (const field_init& init : fields) {
-        if (append_field(init) != result_code::ok) {
-            clear_protocol();
-            return;
-        }
-    }
+    if (append_fields(fields) != result_code::ok)
+        clear_protocol();
 }
 
 void ez::protocol_serializer::copy_from(const protocol_serializer& other)
@@ -50,22 +60,27 @@ void ez::protocol_serializer::copy_from(const protocol_serializer& other)
     // Drop internal buffer
     m_internal_buffer.reset(nullptr);
     m_internal_buffer_length = 0;
+    m_internal_buffer_capacity = 0;
 
-    // Copy internal buffer
+    // Copy internal buffer (spare capacity of other is not copied)
     if (other.m_internal_buffer_length && other.m_internal_buffer != nullptr) {
         m_internal_buffer_length = other.m_internal_buffer_length;
+        m_internal_buffer_capacity = m_internal_buffer_length;
         m_internal_buffer.reset(new unsigned char[m_internal_buffer_length]);
         memcpy(m_internal_buffer.get(), other.m_internal_buffer.get(), m_internal_buffer_length);
     }
 
     // Copy other things
     m_external_buffer = other.m_external_buffer;
+    m_external_buffer_length = other.m_external_buffer_length;
     m_buffer_source = other.m_buffer_source;
     m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
 
-    m_fields = other.m_fields;
-    m_fields_metadata = other.m_fields_metadata;
+    // Layout is shared until one of serializers changes it
+    m_layout = other.m_layout;
+    m_available_fields_count = other.m_available_fields_count;
     m_is_little_endian = other.m_is_little_endian;
+    invalidate_offsets();
 }
 
 protocol_serializer::protocol_serializer(const protocol_serializer& other)
@@ -83,17 +98,31 @@ void ez::protocol_serializer::move_from(protocol_serializer&& other)
 {
     // Move internal buffer
     m_internal_buffer_length = other.m_internal_buffer_length;
+    m_internal_buffer_capacity = other.m_internal_buffer_capacity;
     m_internal_buffer = std::move(other.m_internal_buffer);
     other.m_internal_buffer_length = 0;
+    other.m_internal_buffer_capacity = 0;
 
     // Move other things
     m_external_buffer = other.m_external_buffer;
+    m_external_buffer_length = other.m_external_buffer_length;
     m_buffer_source = other.m_buffer_source;
     m_working_buffer = other.m_working_buffer;
 
-    m_fields = std::move(other.m_fields);
-    m_fields_metadata = std::move(other.m_fields_metadata);
+    m_layout = std::move(other.m_layout);
+    m_available_fields_count = other.m_available_fields_count;
     m_is_little_endian = other.m_is_little_endian;
+
+    // Moved-from object is left without fields
+    other.m_layout = get_empty_layout();
+    other.m_available_fields_count = 0;
+    m_resolved_metadata = std::move(other.m_resolved_metadata);
+    m_required_bit_count = other.m_required_bit_count;
+    other.invalidate_offsets();
+
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    m_stats.swap(other.m_stats);
+#endif
 }
 
 protocol_serializer::protocol_serializer(protocol_serializer&& other) noexcept
@@ -110,6 +139,7 @@ protocol_serializer& protocol_serializer::operator=(protocol_serializer&& other)
 void protocol_serializer::set_is_little_endian(const bool is_little_endian)
 {
     m_is_little_endian = is_little_endian;
+    invalidate_offsets();
 }
 
 bool protocol_serializer::get_is_little_endian() const
@@ -121,6 +151,8 @@ void protocol_serializer::set_buffer_source(const protocol_serializer::buffer_so
 {
     m_buffer_source = source;
     m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
+    update_available_fields();
+    invalidate_offsets();
 }
 
 protocol_serializer::buffer_source protocol_serializer::get_buffer_source() const
@@ -146,7 +178,35 @@ ez::protocol_serializer::byte_ptr_t protocol_serializer::get_external_buffer() c
 void protocol_serializer::set_external_buffer(byte_ptr_t const external_buffer)
 {
     m_external_buffer = external_buffer;
+    m_external_buffer_length = SIZE_MAX;
+    m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
+    update_available_fields();
+    invalidate_offsets();
+}
+
+ez::protocol_serializer::result_code protocol_serializer::set_external_buffer(byte_ptr_t const external_buffer, const size_t length, const bool allow_partial)
+{
+    // Length is checked once here, so that reading/writing needs no bounds checks
+    const bool is_too_short = length < get_required_buffer_length();
+    if (is_too_short && !allow_partial)
+        return result_code::buffer_too_short;
+
+    m_external_buffer = external_buffer;
+    m_external_buffer_length = length;
     m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
+    update_available_fields();
+    invalidate_offsets();
+    return is_too_short ? result_code::buffer_too_short : result_code::ok;
+}
+
+size_t protocol_serializer::get_external_buffer_length() const
+{
+    return m_external_buffer_length;
+}
+
+size_t protocol_serializer::get_available_fields_count() const
+{
+    return m_available_fields_count + m_resolved_metadata.size();
 }
 
 ez::protocol_serializer::byte_ptr_t protocol_serializer::get_working_buffer() const
@@ -156,35 +216,337 @@ ez::protocol_serializer::byte_ptr_t protocol_serializer::get_working_buffer() co
 
 protocol_serializer::fields_list_t protocol_serializer::get_fields_list() const
 {
-    return m_fields;
+    return fields_list_t(m_layout->fields.cbegin(), m_layout->fields.cend());
+}
+
+ez::protocol_serializer::layout_ptr_t protocol_serializer::get_layout() const
+{
+    return m_layout;
+}
+
+ez::protocol_serializer::protocol_layout& protocol_serializer::edit_layout()
+{
+    // Detached copy diverges from layouts which still share the original, so their handles must not be valid for it
+    if (m_layout.use_count() > 1) {
+        m_layout = std::make_shared<protocol_layout>(*m_layout);
+        m_layout->id = generate_layout_id();
+    }
+    return *m_layout;
+}
+
+const std::shared_ptr<ez::protocol_serializer::protocol_layout>& protocol_serializer::get_empty_layout()
+{
+    // Single empty layout is shared by every serializer without fields, so constructing one allocates nothing
+    static const std::shared_ptr<protocol_layout> empty_layout = std::make_shared<protocol_layout>();
+    return empty_layout;
 }
 
 ez::protocol_serializer::field_metadata ez::protocol_serializer::get_field_metadata(const std::string& name) const
 {
-    const fields_metadata_t::const_iterator itt = m_fields_metadata.find(name);
-    if (itt == m_fields_metadata.cend())
+    // Metadata of fields after variable-length ones is only known for current buffer
+    const field_metadata* metadata = m_layout->find_metadata(name);
+    if (metadata == nullptr)
+        metadata = find_metadata(name);
+    if (metadata == nullptr)
+        return field_metadata(0, 0);
+
+    return *metadata;
+}
+
+ez::protocol_serializer::field_metadata ez::protocol_serializer::get_field_metadata(const field_handle& handle) const
+{
+    const field_metadata* metadata = m_layout->find_metadata(handle);
+    if (metadata == nullptr)
+        metadata = find_metadata(handle);
+    if (metadata == nullptr)
+        return field_metadata(0, 0);
+
+    return *metadata;
+}
+
+ez::protocol_serializer::field_handle protocol_serializer::get_field_handle(const std::string& name, result_code* result) const
+{
+    return m_layout->get_field_handle(name, result);
+}
+
+ez::protocol_serializer::field_handle protocol_serializer::get_group_field_handle(const std::string& group, const std::string& field, result_code* result) const
+{
+    const fields_indices_t::const_iterator itt = m_layout->fields_indices.find(group);
+    const protocol_layout::group* found_group = itt != m_layout->fields_indices.cend() ? m_layout->find_group(itt->second) : nullptr;
+    if (found_group == nullptr) {
+        set_result(result, itt != m_layout->fields_indices.cend() ? result_code::not_applicable : result_code::field_not_found);
+        return field_handle();
+    }
+
+    return found_group->layout->get_field_handle(field, result);
+}
+
+bool protocol_serializer::is_valid_handle(const field_handle& handle) const
+{
+    return handle.layout_id == m_layout->id && handle.index < m_layout->fields.size();
+}
+
+const ez::protocol_serializer::field_metadata* protocol_serializer::find_metadata(const std::string& name) const
+{
+    const protocol_layout& layout = *m_layout;
+    const fields_indices_t::const_iterator itt = layout.fields_indices.find(name);
+    if (itt == layout.fields_indices.cend())
+        return nullptr;
+
+    if (itt->second >= m_available_fields_count)
+        return find_resolved_metadata(itt->second);
+
+    return &layout.fields_metadata[itt->second];
+}
+
+const ez::protocol_serializer::field_metadata* protocol_serializer::find_metadata(const field_handle& handle) const
+{
+    // Available fields count never exceeds fields count, so the same comparison rejects both
+    // handles past the last field and fields past the end of partial external buffer
+    const protocol_layout& layout = *m_layout;
+    if (handle.layout_id != layout.id)
+        return nullptr;
+
+    if (handle.index >= m_available_fields_count)
+        return find_resolved_metadata(handle.index);
+
+    return &layout.fields_metadata[handle.index];
+}
+
+const ez::protocol_serializer::field_metadata* protocol_serializer::find_resolved_metadata(const size_t index) const
+{
+    // Fixed fields past available ones are not in the buffer, neither are fields after them
+    const size_t fixed_fields_count = m_layout->get_fixed_fields_count();
+    if (index < fixed_fields_count || m_available_fields_count < fixed_fields_count)
+        return nullptr;
+
+    const size_t resolved_index = index - fixed_fields_count;
+    return resolved_index < m_resolved_metadata.size() ? &m_resolved_metadata[resolved_index] : nullptr;
+}
+
+// Fields are walked once from the first variable-length field: each of them moves fields after it by its length,
+// which is read from its length field. Walk stops at the first field which does not fit into working buffer
+void protocol_serializer::resolve_offsets()
+{
+    const protocol_layout& layout = *m_layout;
+    const size_t fixed_fields_count = layout.get_fixed_fields_count();
+    m_resolved_metadata.clear();
+    m_required_bit_count = get_protocol_bit_count();
+    if (layout.variable_fields.empty() || m_available_fields_count < fixed_fields_count || m_working_buffer == nullptr)
+        return;
+
+    uint64_t available_bit_count = UINT64_MAX;
+    if (m_buffer_source == buffer_source::internal)
+        available_bit_count = uint64_t(m_internal_buffer_length) * 8;
+    else if (m_external_buffer_length != SIZE_MAX)
+        available_bit_count = uint64_t(m_external_buffer_length) * 8;
+
+    std::vector<protocol_layout::variable_field>::const_iterator variable_itt = layout.variable_fields.cbegin();
+    uint64_t shift = 0;
+    for (size_t i = fixed_fields_count; i < layout.fields.size(); ++i) {
+        const field_metadata& nominal = layout.fields_metadata[i];
+        uint64_t bit_count = nominal.bit_count;
+        if (variable_itt != layout.variable_fields.cend() && variable_itt->field_ind == i) {
+            const unsigned int length_ind = variable_itt->length_field_ind;
+            const field_metadata& length_field = length_ind < fixed_fields_count ? layout.fields_metadata[length_ind]
+                                                                                 : m_resolved_metadata[length_ind - fixed_fields_count];
+            result_code read_result;
+            const uint64_t length = _read<uint64_t>(m_working_buffer, m_is_little_endian, length_field, &read_result);
+            // Product of two 32-bit numbers does not overflow, fields which end past 32-bit offsets are rejected below
+            if (read_result != result_code::ok || length > UINT32_MAX)
+                break;
+
+            bit_count = length * variable_itt->unit_bit_count;
+            ++variable_itt;
+        }
+
+        const uint64_t end_bit = nominal.first_bit_ind + shift + bit_count;
+        if (end_bit > available_bit_count || end_bit > UINT32_MAX) {
+            if (end_bit <= UINT32_MAX)
+                m_required_bit_count = end_bit;
+            return;
+        }
+
+        if (bit_count == nominal.bit_count)
+            m_resolved_metadata.push_back(shifted_metadata(nominal, shift));
+        else
+            m_resolved_metadata.push_back(field_metadata(static_cast<unsigned int>(end_bit - bit_count), static_cast<unsigned int>(bit_count), nominal.vis_type));
+        m_required_bit_count = end_bit;
+        shift += bit_count - nominal.bit_count;
+    }
+}
+
+ez::protocol_serializer::field_metadata protocol_serializer::find_group_metadata(const std::string& group, const size_t element, const std::string& field,
+                                                                                const field_metadata*& group_metadata, result_code* result) const
+{
+    const field_metadata* found_metadata = find_metadata(group);
+    if (found_metadata == nullptr) {
+        group_metadata = nullptr;
+        set_result(result, lookup_failure(group));
+        return field_metadata(0, 0);
+    }
+
+    const protocol_layout::group* found_group = m_layout->find_group(field_index(found_metadata));
+    const field_metadata* field_metadata_ptr = found_group != nullptr ? found_group->layout->find_metadata(field) : nullptr;
+    return group_element_metadata(*found_metadata, found_group, element, field_metadata_ptr, group_metadata, result);
+}
+
+ez::protocol_serializer::field_metadata protocol_serializer::find_group_metadata(const field_handle& group, const size_t element, const field_handle& field,
+                                                                                const field_metadata*& group_metadata, result_code* result) const
+{
+    const field_metadata* found_metadata = find_metadata(group);
+    if (found_metadata == nullptr) {
+        group_metadata = nullptr;
+        set_result(result, lookup_failure(group));
         return field_metadata(0, 0);
+    }
 
-    return itt->second;
+    const protocol_layout::group* found_group = m_layout->find_group(group.index);
+    const field_metadata* field_metadata_ptr = found_group != nullptr ? found_group->layout->find_metadata(field) : nullptr;
+    return group_element_metadata(*found_metadata, found_group, element, field_metadata_ptr, group_metadata, result);
 }
 
-std::string protocol_serializer::get_visualization(const visualization_params& vp) const
+// Element fields are fields of group protocol shifted by offset of the element, so no per-element metadata is kept
+ez::protocol_serializer::field_metadata protocol_serializer::group_element_metadata(const field_metadata& found_metadata, const protocol_layout::group* group,
+                                                                                   const size_t element, const field_metadata* field,
+                                                                                   const field_metadata*& group_metadata, result_code* result) const
 {
-    if (m_fields.empty())
+    group_metadata = nullptr;
+    if (group == nullptr) {
+        set_result(result, result_code::not_applicable);
+        return field_metadata(0, 0);
+    }
+
+    if (field == nullptr) {
+        set_result(result, result_code::field_not_found);
+        return field_metadata(0, 0);
+    }
+
+    if (element >= group->repeat_count) {
+        set_result(result, result_code::bad_input);
+        return field_metadata(0, 0);
+    }
+
+    group_metadata = &found_metadata;
+    return shifted_metadata(*field, found_metadata.first_bit_ind + uint64_t(element) * group->stride);
+}
+
+// Byte-aligned shift keeps masks, so only offsets move
+ez::protocol_serializer::field_metadata protocol_serializer::shifted_metadata(const field_metadata& metadata, const uint64_t shift)
+{
+    if (shift % 8 != 0)
+        return field_metadata(static_cast<unsigned int>(metadata.first_bit_ind + shift), metadata.bit_count, metadata.vis_type);
+
+    field_metadata shifted = metadata;
+    shifted.first_bit_ind += static_cast<unsigned int>(shift);
+    shifted.first_byte_ind += static_cast<unsigned int>(shift / 8);
+    return shifted;
+}
+
+// Offsets are resolved eagerly by every non-const change of buffer or layout, so const methods only read them.
+// Internal buffer grows once lengths written into it make fields after variable-length ones stick out.
+// Grown bytes are zero, so every pass makes at least one more field fit
+void protocol_serializer::invalidate_offsets()
+{
+    resolve_offsets();
+    if (m_buffer_source != buffer_source::internal || m_layout->variable_fields.empty())
+        return;
+
+    for (;;) {
+        const uint64_t required_length = (m_required_bit_count + 7) / 8;
+        if (required_length <= m_internal_buffer_length)
+            return;
+
+        set_internal_buffer_length(static_cast<unsigned int>(required_length));
+        resolve_offsets();
+    }
+}
+
+ez::protocol_serializer::result_code protocol_serializer::lookup_failure(const std::string& name) const
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    detail::bump(m_stats->local().lookup_misses, 1);
+#endif
+    return m_layout->fields_indices.count(name) ? result_code::buffer_too_short : result_code::field_not_found;
+}
+
+ez::protocol_serializer::result_code protocol_serializer::lookup_failure(const field_handle& handle) const
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    detail::bump(m_stats->local().lookup_misses, 1);
+#endif
+    return is_valid_handle(handle) ? result_code::buffer_too_short : result_code::field_not_found;
+}
+
+const ez::protocol_serializer::field_metadata* protocol_serializer::protocol_layout::find_metadata(const std::string& name) const
+{
+    const fields_indices_t::const_iterator itt = fields_indices.find(name);
+    if (itt == fields_indices.cend() || itt->second >= get_fixed_fields_count())
+        return nullptr;
+
+    return &fields_metadata[itt->second];
+}
+
+const ez::protocol_serializer::field_metadata* protocol_serializer::protocol_layout::find_metadata(const field_handle& handle) const
+{
+    // Layout keeps its id only while fields are appended to it in place, so a valid handle never points past our last field.
+    // Index is still checked, handles are plain values and may be made up
+    if (handle.layout_id != id || handle.index >= get_fixed_fields_count())
+        return nullptr;
+
+    return &fields_metadata[handle.index];
+}
+
+const ez::protocol_serializer::protocol_layout::group* protocol_serializer::protocol_layout::find_group(const size_t field_ind) const
+{
+    const std::vector<group>::const_iterator itt = std::lower_bound(groups.cbegin(), groups.cend(), field_ind,
+                                                                    [](const group& g, const size_t i) { return g.field_ind < i; });
+    return itt != groups.cend() && itt->field_ind == field_ind ? &*itt : nullptr;
+}
+
+ez::protocol_serializer::field_handle protocol_serializer::protocol_layout::get_field_handle(const std::string& name, result_code* result) const
+{
+    field_handle handle;
+    const fields_indices_t::const_iterator itt = fields_indices.find(name);
+    if (itt == fields_indices.cend()) {
+        set_result(result, result_code::field_not_found);
+        return handle;
+    }
+
+    handle.index = itt->second;
+    handle.layout_id = id;
+    set_result(result, result_code::ok);
+    return handle;
+}
+
+uint64_t protocol_serializer::generate_layout_id()
+{
+    // Zero is reserved for default-constructed (invalid) handles
+    static std::atomic<uint64_t> last_layout_id(0);
+    return ++last_layout_id;
+}
+
+std::string protocol_serializer::get_visualization(const visualization_params& params) const
+{
+    if (m_layout->fields.empty())
         return "";
 
-    const_cast<visualization_params&>(vp).horizontal_bit_margin = vp.horizontal_bit_margin == 0 ? 1 : vp.horizontal_bit_margin;
-    const_cast<visualization_params&>(vp).name_lines_count = vp.name_lines_count == 0 ? 1 : vp.name_lines_count;
+    // Work on a copy, so that params shared between threads are never modified
+    visualization_params vp = params;
+    vp.horizontal_bit_margin = vp.horizontal_bit_margin == 0 ? 1 : vp.horizontal_bit_margin;
+    vp.name_lines_count = vp.name_lines_count == 0 ? 1 : vp.name_lines_count;
 
-    // Identify length of line numbers
+    // Identify length of line numbers (external message with variable-length fields may be longer than internal buffer)
+    const unsigned int working_buffer_length = get_working_buffer_length();
+    const unsigned int visualized_length = std::max(m_internal_buffer_length, working_buffer_length);
     const std::string first_line_num_str = std::to_string(vp.first_line_num);
-    const size_t last_line_num = vp.first_line_num + (m_internal_buffer_length / 2) + (m_internal_buffer_length % 2) - 1;
+    const size_t last_line_num = vp.first_line_num + (visualized_length / 2) + (visualized_length % 2) - 1;
     const std::string last_line_numStr = std::to_string(last_line_num);
     const size_t line_num_str_length = std::max(first_line_num_str.length(), last_line_numStr.length());
 
-    // Fill bits array
-    std::vector<bool> bits(m_internal_buffer_length * 8LL, 0);
-    for (uint32_t i = 0; i < m_internal_buffer_length; ++i) {
+    // Fill bits array (bytes missing in partial external buffer are shown as zeros)
+    std::vector<bool> bits(visualized_length * 8LL, 0);
+    for (uint32_t i = 0; i < working_buffer_length; ++i) {
         char c = m_working_buffer[i];
         for (int j = 7; j >= 0 && c; --j) {
             if (c & 0x1)
@@ -223,8 +585,18 @@ std::string protocol_serializer::get_visualization(const visualization_params& v
     std::string values_line;
     std::string bits_line;
     int curr_bit_ind_inside_buffer = 0;
-    for (const std::string& field_name : m_fields) {
-        const field_metadata& metadata = m_fields_metadata.find(field_name)->second;
+    const protocol_layout& layout = *m_layout;
+    const size_t fixed_fields_count = layout.get_fixed_fields_count();
+    for (size_t field_ind = 0; field_ind < layout.fields.size(); ++field_ind) {
+        // Fields after variable-length ones are drawn only as far as they are resolved, empty ones are not drawn
+        const field_metadata* resolved = field_ind < fixed_fields_count ? &layout.fields_metadata[field_ind] : find_resolved_metadata(field_ind);
+        if (resolved == nullptr)
+            break;
+        if (resolved->bit_count == 0)
+            continue;
+
+        const std::string& field_name = layout.fields[field_ind];
+        const field_metadata& metadata = *resolved;
         const size_t available_field_length = metadata.bit_count * bit_text_len - 1;
         std::string name = field_name;
         std::vector<std::string> name_linesForField(vp.name_lines_count);
@@ -241,16 +613,19 @@ std::string protocol_serializer::get_visualization(const visualization_params& v
         }
 
         if (vp.print_values) {
+            // Fields missing in partial external buffer have no value
             std::string value_line;
-            if (metadata.vis_type == visualization_type::floating_point) {
+            if (field_ind >= m_available_fields_count && field_ind < fixed_fields_count) {
+                value_line = "";
+            } else if (metadata.vis_type == visualization_type::floating_point) {
                 if (metadata.bit_count == 32)
-                    value_line = "=" + std::to_string(read<float>(field_name));
+                    value_line = "=" + std::to_string(_read<float>(m_working_buffer, m_is_little_endian, metadata));
                 else if (metadata.bit_count == 64)
-                    value_line = "=" + std::to_string(read<double>(field_name));
+                    value_line = "=" + std::to_string(_read<double>(m_working_buffer, m_is_little_endian, metadata));
             } else if (metadata.vis_type == visualization_type::signed_integer) {
-                value_line = "=" + std::to_string(read<int64_t>(field_name));
+                value_line = "=" + std::to_string(_read<int64_t>(m_working_buffer, m_is_little_endian, metadata));
             } else {
-                value_line = "=" + std::to_string(read<uint64_t>(field_name));
+                value_line = "=" + std::to_string(_read<uint64_t>(m_working_buffer, m_is_little_endian, metadata));
             }
 
             value_line = value_line.substr(0, available_field_length);
@@ -315,14 +690,16 @@ std::string protocol_serializer::get_visualization(const visualization_params& v
     return result;
 }
 
-std::string protocol_serializer::get_data_visualization(const data_visualization_params& dvp) const
+std::string protocol_serializer::get_data_visualization(const data_visualization_params& params) const
 {
-    if (m_fields.empty())
+    if (m_layout->fields.empty())
         return "";
 
-    const_cast<data_visualization_params&>(dvp).bytes_per_line = dvp.bytes_per_line == 0 ? 1 : dvp.bytes_per_line;
+    data_visualization_params dvp = params;
+    const unsigned int buffer_length = get_working_buffer_length();
+    dvp.bytes_per_line = dvp.bytes_per_line == 0 ? 1 : dvp.bytes_per_line;
     const std::string first_line_num_str = std::to_string(dvp.first_line_num);
-    const size_t last_line_num = dvp.first_line_num + m_internal_buffer_length / dvp.bytes_per_line + ((m_internal_buffer_length % dvp.bytes_per_line) ? 1 : 0) - 1;
+    const size_t last_line_num = dvp.first_line_num + buffer_length / dvp.bytes_per_line + ((buffer_length % dvp.bytes_per_line) ? 1 : 0) - 1;
     const std::string last_line_numStr = std::to_string(last_line_num);
     const size_t line_num_str_length = std::max(first_line_num_str.length(), last_line_numStr.length());
     unsigned int current_bytes_on_line = 0;
@@ -330,14 +707,14 @@ std::string protocol_serializer::get_data_visualization(const data_visualization
     std::string current_line_text;
     std::string result;
     unsigned int current_line_number = 0;
-    for (unsigned int i = 0; i < m_internal_buffer_length + 1; ++i) {
+    for (unsigned int i = 0; i < buffer_length + 1; ++i) {
         bool it_is_first_byte_in_line = false;
-        if (current_bytes_on_line == dvp.bytes_per_line || i == 0 || i == m_internal_buffer_length) {
+        if (current_bytes_on_line == dvp.bytes_per_line || i == 0 || i == buffer_length) {
             it_is_first_byte_in_line = true;
             if (current_line_text.length())
                 result += (result.empty() ? "" : "\n") + current_line_text;
 
-            if (i == m_internal_buffer_length)
+            if (i == buffer_length)
                 break;
 
             current_bytes_on_line = 0;
@@ -372,109 +749,445 @@ std::string protocol_serializer::get_data_visualization(const data_visualization
 
 ez::protocol_serializer::byte_ptr_t protocol_serializer::get_field_pointer(const std::string& name) const
 {
-    m_prealloc_metadata_itt = m_fields_metadata.find(name);
+    const field_metadata* metadata = find_metadata(name);
 
-    if (m_prealloc_metadata_itt == m_fields_metadata.cend()) {
+    if (metadata == nullptr) {
         printf("Protocol::get_field_first_byte_pointer. There is no field '%s'!\n", name.c_str());
         return nullptr;
     }
 
-    const field_metadata& metadata = m_prealloc_metadata_itt->second;
-    return m_working_buffer + metadata.first_byte_ind;
+    return m_working_buffer + metadata->first_byte_ind;
 }
 
-ez::protocol_serializer::result_code protocol_serializer::append_field(const field_init& init, bool preserve_internal_buffer_values)
+ez::protocol_serializer::byte_ptr_t protocol_serializer::get_field_pointer(const field_handle& handle) const
+{
+    const field_metadata* metadata = find_metadata(handle);
+    if (metadata == nullptr)
+        return nullptr;
+
+    return m_working_buffer + metadata->first_byte_ind;
+}
+
+ez::message_view protocol_serializer::make_view(byte_ptr_t const buffer, const size_t length) const
+{
+    return message_view(*m_layout, buffer, length, m_is_little_endian);
+}
+
+ez::const_message_view protocol_serializer::make_view(const unsigned char* buffer, const size_t length) const
+{
+    return const_message_view(*m_layout, buffer, length, m_is_little_endian);
+}
+
+ez::protocol_serializer::result_code protocol_serializer::_read_bytes(const unsigned char* buffer, const bool is_little_endian, const field_metadata& metadata,
+                                                                    unsigned char* bytes, const size_t length)
 {
-    if (m_fields_metadata.find(init.name) != m_fields_metadata.cend())
+    if (is_little_endian && metadata.bit_count > 8 && metadata.bit_count % 8)
+        return result_code::not_applicable;
+
+    // Empty variable-length field
+    if (metadata.bit_count == 0)
+        return length == 0 ? result_code::ok : result_code::bad_input;
+
+    if (buffer == nullptr || bytes == nullptr || length != metadata.bytes_count)
         return result_code::bad_input;
 
-    if (init.bit_count == 0 || init.name.empty())
+    detail::extract_span(buffer, metadata.first_bit_ind, metadata.bit_count, bytes);
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code protocol_serializer::_write_bytes(byte_ptr_t const buffer, const bool is_little_endian, const field_metadata& metadata,
+                                                                     const unsigned char* bytes, const size_t length)
+{
+    if (is_little_endian && metadata.bit_count > 8 && metadata.bit_count % 8)
+        return result_code::not_applicable;
+
+    if (metadata.bit_count == 0)
+        return length == 0 ? result_code::ok : result_code::bad_input;
+
+    if (buffer == nullptr || bytes == nullptr || length != metadata.bytes_count)
         return result_code::bad_input;
 
-    if (init.vis_type == visualization_type::floating_point && init.bit_count != 32 && init.bit_count != 64)
+    detail::insert_span(buffer, metadata.first_bit_ind, metadata.bit_count, bytes);
+    return result_code::ok;
+}
+
+#ifdef EZ_PROTOCOL_SERIALIZER_INT128
+ez::uint128_t protocol_serializer::_read_uint128(const unsigned char* buffer, const bool is_little_endian, const field_metadata& metadata, result_code* result)
+{
+    if (metadata.bit_count > 128) {
+        set_result(result, result_code::not_applicable);
+        return 0;
+    }
+
+    unsigned char bytes[16];
+    const result_code read_result = _read_bytes(buffer, is_little_endian, metadata, bytes, metadata.bytes_count);
+    set_result(result, read_result);
+    if (read_result != result_code::ok)
+        return 0;
+
+    uint128_t value = 0;
+    for (unsigned int i = 0; i < metadata.bytes_count; ++i)
+        value = (value << 8) | bytes[is_little_endian ? metadata.bytes_count - 1 - i : i];
+    return value;
+}
+
+ez::protocol_serializer::result_code protocol_serializer::_write_uint128(byte_ptr_t const buffer, const bool is_little_endian, const field_metadata& metadata, const uint128_t value)
+{
+    if (metadata.bit_count > 128)
         return result_code::not_applicable;
 
+    unsigned char bytes[16];
+    for (unsigned int i = 0; i < metadata.bytes_count; ++i)
+        bytes[is_little_endian ? i : metadata.bytes_count - 1 - i] = static_cast<unsigned char>(value >> (i * 8));
+    return _write_bytes(buffer, is_little_endian, metadata, bytes, metadata.bytes_count);
+}
+#endif
+
+ez::serializer_stats protocol_serializer::get_stats() const
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    return m_stats->snapshot(m_layout->fields);
+#else
+    return serializer_stats();
+#endif
+}
+
+void protocol_serializer::reset_stats()
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    m_stats->reset();
+#endif
+}
+
+namespace {
+
+using protocol_layout = ez::protocol_serializer::protocol_layout;
+using field_init = ez::protocol_serializer::field_init;
+
+// Variable-length fields take no bits in layout metadata
+unsigned int get_nominal_bit_count(const field_init& init)
+{
+    return init.length_field.empty() ? init.bit_count : 0;
+}
+
+void update_length_fields_end(protocol_layout& layout)
+{
+    layout.length_fields_end = 0;
+    for (const protocol_layout::variable_field& field : layout.variable_fields)
+        layout.length_fields_end = std::max(layout.length_fields_end, field.length_field_ind + 1);
+}
+
+// Indices of fields starting at index are moved by delta, variable-length field init (if any) is added at index
+void shift_indexed_fields(protocol_layout& layout, const unsigned int index, const int delta, const field_init* init = nullptr)
+{
+    for (protocol_layout::variable_field& field : layout.variable_fields) {
+        if (field.field_ind >= index)
+            field.field_ind += delta;
+        if (field.length_field_ind >= index)
+            field.length_field_ind += delta;
+    }
+    for (protocol_layout::group& group : layout.groups)
+        if (group.field_ind >= index)
+            group.field_ind += delta;
+
+    if (init != nullptr && !init->length_field.empty()) {
+        const protocol_layout::variable_field added = {index, layout.fields_indices.find(init->length_field)->second, init->bit_count};
+        const auto position = std::lower_bound(layout.variable_fields.begin(), layout.variable_fields.end(), index,
+                                               [](const protocol_layout::variable_field& field, const unsigned int i) { return field.field_ind < i; });
+        layout.variable_fields.insert(position, added);
+    }
+    update_length_fields_end(layout);
+}
+
+}
+
+ez::protocol_serializer::result_code protocol_serializer::append_field(const field_init& init, bool preserve_internal_buffer_values)
+{
+    const result_code check_result = check_field_init(init, m_layout->fields.size());
+    if (check_result != result_code::ok)
+        return check_result;
+
+    protocol_layout& layout = edit_layout();
     unsigned int first_bit_index = 0;
-    if (!m_fields.empty()) {
-        const field_metadata last_field_metadata = m_fields_metadata.at(m_fields.back());
+    if (!layout.fields_metadata.empty()) {
+        const field_metadata& last_field_metadata = layout.fields_metadata.back();
         first_bit_index = last_field_metadata.first_bit_ind + last_field_metadata.bit_count;
     }
 
-    m_fields.push_back(init.name);
-    m_fields_metadata.insert(fields_metadata_t::value_type(init.name, field_metadata(first_bit_index, init.bit_count, init.vis_type)));
+    const unsigned int index = static_cast<unsigned int>(layout.fields.size());
+    layout.fields_indices.insert(fields_indices_t::value_type(init.name, index));
+    layout.fields.push_back(init.name);
+    layout.fields_metadata.push_back(field_metadata(first_bit_index, get_nominal_bit_count(init), init.vis_type));
+    shift_indexed_fields(layout, index, 0, &init);
 
     if (preserve_internal_buffer_values)
-        update_internal_buffer();
+        update_appended_internal_buffer(first_bit_index);
     else
         reallocate_internal_buffer();
 
     return result_code::ok;
 }
 
-ez::protocol_serializer::result_code protocol_serializer::append_protocol(const protocol_serializer& other, bool preserve_internal_buffer_values)
+ez::protocol_serializer::result_code protocol_serializer::append_fields(const std::vector<field_init>& fields, bool preserve_internal_buffer_values)
 {
-    for (fields_metadata_t::const_iterator itt = other.m_fields_metadata.cbegin(); itt != other.m_fields_metadata.cend(); ++itt)
-        if (m_fields_metadata.find(itt->first) != m_fields_metadata.cend())
-            return result_code::bad_input;
+    if (fields.empty())
+        return result_code::ok;
+
+    // Whole batch is checked before layout is touched: either all fields are appended or none of them,
+    // and a rejected batch must not detach a shared layout (which would invalidate our handles)
+    const size_t initial_fields_count = m_layout->fields.size();
+    fields_indices_t pending_indices;
+    pending_indices.reserve(fields.size());
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const result_code check_result = check_field_init(fields[i], initial_fields_count + i, &fields, &pending_indices);
+        if (check_result != result_code::ok)
+            return check_result;
+        pending_indices.insert(fields_indices_t::value_type(fields[i].name, static_cast<unsigned int>(i)));
+    }
+
+    // Metadata of all fields is computed first, so internal buffer is resized only once
+    reserve(initial_fields_count + fields.size());
+    protocol_layout& layout = edit_layout();
+    unsigned int first_bit_index = 0;
+    if (!layout.fields_metadata.empty())
+        first_bit_index = layout.fields_metadata.back().first_bit_ind + layout.fields_metadata.back().bit_count;
+    const unsigned int appended_first_bit = first_bit_index;
 
-    for (const std::string& field_name : other.m_fields) {
-        const field_metadata& metadata = other.m_fields_metadata.find(field_name)->second;
-        append_field(protocol_serializer::field_init{field_name, metadata.bit_count}, preserve_internal_buffer_values);
+    for (const field_init& init : fields) {
+        const unsigned int index = static_cast<unsigned int>(layout.fields.size());
+        layout.fields_indices.insert(fields_indices_t::value_type(init.name, index));
+        layout.fields.push_back(init.name);
+        layout.fields_metadata.push_back(field_metadata(first_bit_index, get_nominal_bit_count(init), init.vis_type));
+        first_bit_index += get_nominal_bit_count(init);
+        if (!init.length_field.empty())
+            shift_indexed_fields(layout, index, 0, &init);
     }
 
+    if (preserve_internal_buffer_values)
+        update_appended_internal_buffer(appended_first_bit);
+    else
+        reallocate_internal_buffer();
+
     return result_code::ok;
 }
 
-ez::protocol_serializer::result_code ez::protocol_serializer::remove_field(const std::string& name, bool preserve_internal_buffer_values)
+void protocol_serializer::reserve(const size_t fields_count, const unsigned int internal_buffer_length)
 {
-    m_prealloc_metadata_itt = m_fields_metadata.find(name);
-    if (m_prealloc_metadata_itt == m_fields_metadata.end())
-        return result_code::field_not_found;
+    if (fields_count > m_layout->fields.capacity()) {
+        protocol_layout& layout = edit_layout();
+        layout.fields.reserve(fields_count);
+        layout.fields_metadata.reserve(fields_count);
+        layout.fields_indices.reserve(fields_count);
+    }
 
-    bool removed = false;
-    unsigned int first_bit_index = 0;
-    for (auto name_itt = m_fields.begin(); name_itt != m_fields.end();) {
-        // Iterate until we find field to remove
-        if (!removed) {
-            if (*name_itt == name) {
-                name_itt = m_fields.erase(name_itt);
-                first_bit_index = m_fields_metadata.find(name)->second.first_bit_ind;
-                m_fields_metadata.erase(name);
-                removed = true;
-            } else {
-                ++name_itt;
-            }
-            continue;
+    if (internal_buffer_length > m_internal_buffer_capacity)
+        reserve_internal_buffer(internal_buffer_length, true);
+}
+
+// Pending fields are the ones of a batch being appended which are not in layout yet, they precede checked field
+ez::protocol_serializer::result_code protocol_serializer::check_field_init(const field_init& init, const size_t index, const std::vector<field_init>* pending_fields,
+                                                                          const fields_indices_t* pending_indices) const
+{
+    if (m_layout->fields_indices.find(init.name) != m_layout->fields_indices.cend())
+        return result_code::bad_input;
+
+    if (pending_indices && pending_indices->find(init.name) != pending_indices->cend())
+        return result_code::bad_input;
+
+    if (init.bit_count == 0 || init.name.empty())
+        return result_code::bad_input;
+
+    if (init.vis_type == visualization_type::floating_point && init.bit_count != 32 && init.bit_count != 64)
+        return result_code::not_applicable;
+
+    // Length field has to precede its variable-length field and hold an unsigned integer
+    if (!init.length_field.empty() && pending_indices) {
+        const fields_indices_t::const_iterator pending_itt = pending_indices->find(init.length_field);
+        if (pending_itt != pending_indices->cend()) {
+            const field_init& length_init = (*pending_fields)[pending_itt->second];
+            if (!length_init.length_field.empty() || length_init.bit_count > 64)
+                return result_code::not_applicable;
+            return result_code::ok;
         }
+    }
+
+    if (!init.length_field.empty()) {
+        const fields_indices_t::const_iterator length_itt = m_layout->fields_indices.find(init.length_field);
+        if (length_itt == m_layout->fields_indices.cend() || length_itt->second >= index)
+            return result_code::field_not_found;
+
+        for (const protocol_layout::variable_field& field : m_layout->variable_fields)
+            if (field.field_ind == length_itt->second)
+                return result_code::not_applicable;
 
-        // Field was removed. Recalculate metadata of all subsequent fields
-        //(operator[] will not work here since field_metadata has no default constructor)
-        fields_metadata_t::iterator metadata_itt = m_fields_metadata.find(*name_itt);
-        // Should never happen
-        if (metadata_itt == m_fields_metadata.end())
+        if (m_layout->fields_metadata[length_itt->second].bit_count > 64)
+            return result_code::not_applicable;
+    }
+
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code protocol_serializer::append_protocol(const protocol_serializer& other, bool preserve_internal_buffer_values)
+{
+    // Other may be this very serializer, so its layout is kept alive while ours changes
+    const layout_ptr_t other_layout = other.m_layout;
+    for (const std::string& field_name : other_layout->fields)
+        if (m_layout->fields_indices.find(field_name) != m_layout->fields_indices.cend())
             return result_code::bad_input;
 
-        field_metadata& metadata_ref = metadata_itt->second;
-        metadata_ref = field_metadata(first_bit_index, metadata_ref.bit_count, metadata_ref.vis_type);
-        first_bit_index += metadata_ref.bit_count;
-        ++name_itt;
+    std::vector<field_init> fields;
+    fields.reserve(other_layout->fields.size());
+    for (size_t i = 0; i < other_layout->fields.size(); ++i)
+        fields.push_back(protocol_serializer::field_init{other_layout->fields[i], other_layout->fields_metadata[i].bit_count, other_layout->fields_metadata[i].vis_type});
+    for (const protocol_layout::variable_field& field : other_layout->variable_fields) {
+        fields[field.field_ind].bit_count = field.unit_bit_count;
+        fields[field.field_ind].length_field = other_layout->fields[field.length_field_ind];
     }
 
-    if (preserve_internal_buffer_values)
-        update_internal_buffer();
-    else
+    const unsigned int first_field_ind = static_cast<unsigned int>(m_layout->fields.size());
+    const result_code append_result = append_fields(fields, preserve_internal_buffer_values);
+    if (append_result != result_code::ok || other_layout->groups.empty())
+        return append_result;
+
+    // Groups stay groups, their layouts are shared
+    protocol_layout& layout = edit_layout();
+    for (protocol_layout::group group : other_layout->groups) {
+        group.field_ind += first_field_ind;
+        layout.groups.push_back(group);
+    }
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code protocol_serializer::append_group(const std::string& name, const protocol_serializer& group,
+                                                                       const unsigned int repeat_count, bool preserve_internal_buffer_values)
+{
+    // Group may be this very serializer, so its layout is kept alive while ours changes
+    const layout_ptr_t group_layout = group.m_layout;
+    if (!group_layout->variable_fields.empty())
+        return result_code::not_applicable;
+
+    const uint64_t stride = group.get_protocol_bit_count();
+    if (stride == 0 || repeat_count == 0 || stride * repeat_count > UINT32_MAX)
+        return result_code::bad_input;
+
+    const field_init init = {name, static_cast<unsigned int>(stride * repeat_count), visualization_type::unsigned_integer};
+    const result_code append_result = append_field(init, preserve_internal_buffer_values);
+    if (append_result != result_code::ok)
+        return append_result;
+
+    const protocol_layout::group added = {static_cast<unsigned int>(m_layout->fields.size() - 1), repeat_count, static_cast<unsigned int>(stride), group_layout};
+    edit_layout().groups.push_back(added);
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code protocol_serializer::insert_field(const size_t index, const field_init& init, bool preserve_internal_buffer_values)
+{
+    if (index > m_layout->fields.size())
+        return result_code::bad_input;
+
+    if (index == m_layout->fields.size())
+        return append_field(init, preserve_internal_buffer_values);
+
+    const result_code check_result = check_field_init(init, index);
+    if (check_result != result_code::ok)
+        return check_result;
+
+    const uint64_t old_bit_count = get_preserved_bit_count();
+    const unsigned int inserted_bit_count = get_nominal_bit_count(init);
+    protocol_layout& layout = edit_layout();
+    const unsigned int first_bit_index = layout.fields_metadata[index].first_bit_ind;
+    layout.fields.insert(layout.fields.begin() + index, init.name);
+    layout.fields_metadata.insert(layout.fields_metadata.begin() + index, field_metadata(first_bit_index, inserted_bit_count, init.vis_type));
+    layout.fields_indices.insert(fields_indices_t::value_type(init.name, static_cast<unsigned int>(index)));
+
+    // Only fields after insertion point are affected
+    for (size_t i = index + 1; i < layout.fields_metadata.size(); ++i) {
+        field_metadata& metadata_ref = layout.fields_metadata[i];
+        metadata_ref = field_metadata(metadata_ref.first_bit_ind + inserted_bit_count, metadata_ref.bit_count, metadata_ref.vis_type);
+        layout.fields_indices.find(layout.fields[i])->second = static_cast<unsigned int>(i);
+    }
+    shift_indexed_fields(layout, static_cast<unsigned int>(index), 1, &init);
+    layout.id = generate_layout_id();
+
+    if (!preserve_internal_buffer_values) {
+        reallocate_internal_buffer();
+        return result_code::ok;
+    }
+
+    // Values of subsequent fields follow their fields, inserted field is zeroed. Values are moved before offsets
+    // are resolved against the new layout, so that lengths are read where the new layout expects them
+    const uint64_t moved_length = (old_bit_count + inserted_bit_count + 7) / 8;
+    set_internal_buffer_length(static_cast<unsigned int>(std::max<uint64_t>(moved_length, m_internal_buffer_length)));
+    detail::move_bits(m_internal_buffer.get(), first_bit_index + inserted_bit_count, first_bit_index, old_bit_count - first_bit_index);
+    detail::clear_bits(m_internal_buffer.get(), first_bit_index, inserted_bit_count);
+    update_internal_buffer();
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code ez::protocol_serializer::remove_field(const std::string& name, bool preserve_internal_buffer_values)
+{
+    const fields_indices_t::const_iterator found_itt = m_layout->fields_indices.find(name);
+    if (found_itt == m_layout->fields_indices.cend())
+        return result_code::field_not_found;
+
+    // Variable-length field can not lose its length field
+    const unsigned int removed_ind = found_itt->second;
+    for (const protocol_layout::variable_field& field : m_layout->variable_fields)
+        if (field.length_field_ind == removed_ind)
+            return result_code::not_applicable;
+
+    const uint64_t old_bit_count = get_preserved_bit_count();
+    protocol_layout& layout = edit_layout();
+    const unsigned int first_bit_index = layout.fields_metadata[removed_ind].first_bit_ind;
+    const unsigned int removed_bit_count = layout.fields_metadata[removed_ind].bit_count;
+    layout.fields_indices.erase(name);
+    layout.fields.erase(layout.fields.begin() + removed_ind);
+    layout.fields_metadata.erase(layout.fields_metadata.begin() + removed_ind);
+
+    // Only fields after removed one are affected
+    for (size_t i = removed_ind; i < layout.fields_metadata.size(); ++i) {
+        field_metadata& metadata_ref = layout.fields_metadata[i];
+        metadata_ref = field_metadata(metadata_ref.first_bit_ind - removed_bit_count, metadata_ref.bit_count, metadata_ref.vis_type);
+        layout.fields_indices.find(layout.fields[i])->second = static_cast<unsigned int>(i);
+    }
+    layout.variable_fields.erase(std::remove_if(layout.variable_fields.begin(), layout.variable_fields.end(),
+                                                [removed_ind](const protocol_layout::variable_field& field) { return field.field_ind == removed_ind; }),
+                                 layout.variable_fields.end());
+    layout.groups.erase(std::remove_if(layout.groups.begin(), layout.groups.end(),
+                                       [removed_ind](const protocol_layout::group& group) { return group.field_ind == removed_ind; }),
+                        layout.groups.end());
+    shift_indexed_fields(layout, removed_ind, -1);
+    layout.id = generate_layout_id();
+
+    if (!preserve_internal_buffer_values) {
         reallocate_internal_buffer();
+        return result_code::ok;
+    }
 
+    // Values of subsequent fields follow their fields
+    const uint64_t moved_first_bit = first_bit_index + removed_bit_count;
+    detail::move_bits(m_internal_buffer.get(), first_bit_index, moved_first_bit, old_bit_count - moved_first_bit);
+    detail::clear_bits(m_internal_buffer.get(), old_bit_count - removed_bit_count, removed_bit_count);
+    update_internal_buffer();
     return result_code::ok;
 }
 
 ez::protocol_serializer::result_code protocol_serializer::remove_last_field(bool preserve_internal_buffer_values)
 {
-    if (m_fields.empty())
+    if (m_layout->fields.empty())
         return result_code::not_applicable;
 
-    m_fields_metadata.erase(m_fields_metadata.find(m_fields.back()));
-    m_fields.pop_back();
+    protocol_layout& layout = edit_layout();
+    layout.fields_indices.erase(layout.fields.back());
+    layout.fields.pop_back();
+    layout.fields_metadata.pop_back();
+    if (!layout.variable_fields.empty() && layout.variable_fields.back().field_ind == layout.fields.size()) {
+        layout.variable_fields.pop_back();
+        update_length_fields_end(layout);
+    }
+    if (!layout.groups.empty() && layout.groups.back().field_ind == layout.fields.size())
+        layout.groups.pop_back();
+    layout.id = generate_layout_id();
 
     if (preserve_internal_buffer_values)
         update_internal_buffer();
@@ -486,11 +1199,10 @@ ez::protocol_serializer::result_code protocol_serializer::remove_last_field(bool
 
 ez::protocol_serializer::result_code protocol_serializer::clear_protocol()
 {
-    if (m_fields.empty())
+    if (m_layout->fields.empty())
         return result_code::not_applicable;
 
-    m_fields.clear();
-    m_fields_metadata.clear();
+    m_layout = get_empty_layout();
 
     reallocate_internal_buffer();
 
@@ -499,78 +1211,23 @@ ez::protocol_serializer::result_code protocol_serializer::clear_protocol()
 
 void protocol_serializer::clear_working_buffer()
 {
-    if (m_fields.empty())
+    if (m_layout->fields.empty())
         return;
 
-    memset(m_working_buffer, 0, m_internal_buffer_length);
+    if (m_working_buffer != nullptr)
+        memset(m_working_buffer, 0, get_working_buffer_length());
+    invalidate_offsets();
 }
 
-void protocol_serializer::shift_right(byte_ptr_t buf, int len, unsigned char shift)
+const unsigned char* protocol_serializer::get_right_masks()
 {
-    if (len <= 0)
-        return;
-
-    unsigned char tmp = 0x00, tmp2 = 0x00;
-    for (int k = 0; k <= len; ++k) {
-        if (k == 0) {
-            tmp = buf[k];
-            buf[k] >>= shift;
-        } else {
-            tmp2 = buf[k];
-            buf[k] >>= shift;
-            buf[k] |= ((tmp & get_right_masks().at(shift)) << (8 - shift));
-            if (k != len)
-                tmp = tmp2;
-        }
-    }
-}
-
-void protocol_serializer::shift_left(byte_ptr_t buf, int len, unsigned char shift)
-{
-    if (len <= 0)
-        return;
-
-    unsigned char tmp = 0x00, tmp2 = 0x00;
-    for (int k = len; k >= 0; k--) {
-        if (k == len) {
-            tmp = buf[k];
-            buf[k] <<= shift;
-        } else {
-            tmp2 = buf[k];
-            buf[k] <<= shift;
-            buf[k] |= ((tmp & get_left_masks().at(shift)) >> (8 - shift));
-            tmp = tmp2;
-        }
-    }
-}
-
-const std::unordered_map<unsigned char, unsigned char>& protocol_serializer::get_right_masks()
-{
-    static const std::unordered_map<unsigned char, unsigned char> right_masks{
-        {0,0x00},
-        {1,0x01},
-        {2,0x03},
-        {3,0x07},
-        {4,0x0F},
-        {5,0x1F},
-        {6,0x3F},
-        {7,0x7F}
-    };
+    static const unsigned char right_masks[8] = {0x00, 0x01, 0x03, 0x07, 0x0F, 0x1F, 0x3F, 0x7F};
     return right_masks;
 }
 
-const std::unordered_map<unsigned char, unsigned char>& protocol_serializer::get_left_masks()
+const unsigned char* protocol_serializer::get_left_masks()
 {
-    static const std::unordered_map<unsigned char, unsigned char> left_masks{
-        {0,0x00},
-        {1,0x80},
-        {2,0xC0},
-        {3,0xE0},
-        {4,0xF0},
-        {5,0xF8},
-        {6,0xFC},
-        {7,0xFE}
-    };
+    static const unsigned char left_masks[8] = {0x00, 0x80, 0xC0, 0xE0, 0xF0, 0xF8, 0xFC, 0xFE};
     return left_masks;
 }
 
@@ -597,43 +1254,126 @@ std::string ez::protocol_serializer::int_to_str_leading_zeros(int value, size_t
     return int_string;
 }
 
+// Values of fields after variable-length ones end where their lengths make them end, so the whole internal buffer is kept
+uint64_t protocol_serializer::get_preserved_bit_count() const
+{
+    return m_layout->variable_fields.empty() ? get_protocol_bit_count() : uint64_t(m_internal_buffer_length) * 8;
+}
+
+unsigned int protocol_serializer::get_protocol_bit_count() const
+{
+    if (m_layout->fields.empty())
+        return 0;
+
+    const field_metadata& last_field_metadata = m_layout->fields_metadata.back();
+    return last_field_metadata.first_bit_ind + last_field_metadata.bit_count;
+}
+
+unsigned int protocol_serializer::get_required_buffer_length() const
+{
+    const unsigned int bits = get_protocol_bit_count();
+    return bits / 8 + ((bits % 8) ? 1 : 0);
+}
+
+void protocol_serializer::reserve_internal_buffer(const unsigned int capacity, const bool preserve_values)
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    detail::bump(m_stats->local().reallocations, 1);
+#endif
+    internal_buffer_ptr_t new_buffer(new unsigned char[capacity]);
+    if (preserve_values && m_internal_buffer_length)
+        memcpy(new_buffer.get(), m_internal_buffer.get(), m_internal_buffer_length);
+    m_internal_buffer = std::move(new_buffer);
+    m_internal_buffer_capacity = capacity;
+    m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
+}
+
 void protocol_serializer::reallocate_internal_buffer()
 {
-    // Drop internal buffer
-    m_internal_buffer.reset(nullptr);
-    m_internal_buffer_length = 0;
-    if (m_fields.empty())
+    update_available_fields();
+    m_internal_buffer_length = get_required_buffer_length();
+    if (m_internal_buffer_length == 0) {
+        // Drop internal buffer
+        m_internal_buffer.reset(nullptr);
+        m_internal_buffer_capacity = 0;
+        m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
+        invalidate_offsets();
         return;
+    }
 
-    // Reallocate internal buffer
-    const field_metadata& last_field_metadata = m_fields_metadata.find(m_fields.back())->second;
-    const unsigned int bits = last_field_metadata.first_bit_ind + last_field_metadata.bit_count;
-    m_internal_buffer_length = bits / 8 + ((bits % 8) ? 1 : 0);
-    m_internal_buffer.reset(new unsigned char[m_internal_buffer_length]);
+    if (m_internal_buffer_length > m_internal_buffer_capacity)
+        reserve_internal_buffer(std::max(m_internal_buffer_length, m_internal_buffer_capacity * 2), false);
     memset(m_internal_buffer.get(), 0, m_internal_buffer_length);
-
-    m_working_buffer = m_buffer_source == buffer_source::internal ? m_internal_buffer.get() : m_external_buffer;
+    invalidate_offsets();
 }
 
 void protocol_serializer::update_internal_buffer()
 {
-    // Create a copy of current internal buffer
+    update_available_fields();
     const unsigned int old_buffer_length = m_internal_buffer_length;
-    internal_buffer_ptr_t old_buffer_copy;
-    if (m_internal_buffer != nullptr) {
-        old_buffer_copy.reset(new unsigned char[old_buffer_length]);
-        memcpy(old_buffer_copy.get(), m_internal_buffer.get(), old_buffer_length);
+    const unsigned int new_buffer_length = get_required_buffer_length();
+    if (new_buffer_length == 0) {
+        reallocate_internal_buffer();
+        return;
     }
 
-    // Reallocate internal buffer
-    reallocate_internal_buffer();
+    // Variable-length fields stay in the buffer even though protocol without them is shorter
+    set_internal_buffer_length(m_layout->variable_fields.empty() ? new_buffer_length : std::max(new_buffer_length, old_buffer_length));
+    invalidate_offsets();
+}
+
+void protocol_serializer::update_appended_internal_buffer(const unsigned int first_appended_bit)
+{
+    update_internal_buffer();
 
-    // Fill with old values
-    if (m_internal_buffer_length > 0 && old_buffer_length > 0)
-        memcpy(m_internal_buffer.get(), old_buffer_copy.get(), std::min(m_internal_buffer_length, old_buffer_length));
+    // Last byte of the old protocol may still hold bits of removed fields. Bytes past nominal end of a protocol
+    // with variable-length fields belong to their values, so these are left as they are
+    if (m_layout->variable_fields.empty() && m_internal_buffer_length != 0)
+        detail::clear_bits(m_internal_buffer.get(), first_appended_bit, get_protocol_bit_count() - first_appended_bit);
 }
 
-void ez::protocol_serializer::set_result(result_code* result_ptr, const result_code code) const
+void protocol_serializer::set_internal_buffer_length(const unsigned int length)
+{
+    // Capacity grows geometrically, so a sequence of appends copies every byte O(1) times
+    if (length > m_internal_buffer_capacity)
+        reserve_internal_buffer(std::max(length, m_internal_buffer_capacity * 2), true);
+
+    // Bytes beyond old length may keep values of removed fields
+    if (length > m_internal_buffer_length)
+        memset(m_internal_buffer.get() + m_internal_buffer_length, 0, length - m_internal_buffer_length);
+    m_internal_buffer_length = length;
+}
+
+// Only fields at fixed offsets are counted here, fields after variable-length ones are resolved by invalidate_offsets()
+void protocol_serializer::update_available_fields()
+{
+    const fields_metadata_t& metadata = m_layout->fields_metadata;
+    const size_t fixed_fields_count = m_layout->get_fixed_fields_count();
+    if (m_buffer_source == buffer_source::internal || m_external_buffer_length == SIZE_MAX) {
+        m_available_fields_count = fixed_fields_count;
+        return;
+    }
+
+    // Fields follow each other, so available fields are a prefix of the protocol
+    const uint64_t available_bit_count = uint64_t(m_external_buffer_length) * 8;
+    m_available_fields_count = std::partition_point(metadata.cbegin(), metadata.cbegin() + fixed_fields_count, [available_bit_count](const field_metadata& field) {
+        return field.first_bit_ind + uint64_t(field.bit_count) <= available_bit_count;
+    }) - metadata.cbegin();
+}
+
+unsigned int protocol_serializer::get_working_buffer_length() const
+{
+    if (m_buffer_source == buffer_source::internal)
+        return m_internal_buffer_length;
+
+    // External message with variable-length fields is as long as they make it
+    uint64_t length = m_internal_buffer_length;
+    if (!m_layout->variable_fields.empty())
+        length = (m_required_bit_count + 7) / 8;
+    return static_cast<unsigned int>(std::min<uint64_t>(length, m_external_buffer_length));
+}
+
+void ez::protocol_serializer::set_result(result_code* result_ptr, const result_code code)
 {
     if (result_ptr == nullptr)
         return;
@@ -656,13 +1396,571 @@ protocol_serializer::field_metadata::field_metadata(const unsigned int first_bit
     last_mask = 0xFF;
 
     if (touched_bytes_count == 1) {
-        first_mask = ~(get_left_masks().at(left_spacing) | get_right_masks().at(right_spacing));
+        first_mask = ~(get_left_masks()[left_spacing] | get_right_masks()[right_spacing]);
         return;
     }
 
     if (left_spacing)
-        first_mask = get_right_masks().at(8 - left_spacing);
+        first_mask = get_right_masks()[8 - left_spacing];
 
     if (right_spacing)
-        last_mask = get_left_masks().at(8 - right_spacing);
+        last_mask = get_left_masks()[8 - right_spacing];
+}
+
+namespace {
+
+void append_counters(std::string& text, const ez::serializer_stats::counters& c, const bool is_json)
+{
+    const char* format = is_json ? "\"reads\": %llu, \"writes\": %llu, \"batch_calls\": %llu, \"shifted_accesses\": %llu, "
+                                   "\"byte_swaps\": %llu, \"sign_extensions\": %llu, \"bytes_touched\": %llu"
+                                 : "reads %llu, writes %llu, batch calls %llu, shifted %llu, byte swaps %llu, sign extensions %llu, bytes touched %llu";
+    char buffer[384];
+    snprintf(buffer, sizeof(buffer), format, (unsigned long long)c.reads, (unsigned long long)c.writes, (unsigned long long)c.batch_calls,
+             (unsigned long long)c.shifted_accesses, (unsigned long long)c.byte_swaps, (unsigned long long)c.sign_extensions,
+             (unsigned long long)c.bytes_touched);
+    text += buffer;
+}
+
+void append_json_string(std::string& text, const std::string& value)
+{
+    text += '"';
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            text += '\\';
+            text += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+            text += escaped;
+        }
+        else {
+            text += c;
+        }
+    }
+    text += '"';
+}
+
+bool is_accessed(const ez::serializer_stats::counters& c)
+{
+    return c.reads || c.writes || c.batch_calls;
+}
+
+}
+
+std::string ez::serializer_stats::to_text() const
+{
+    if (!is_enabled)
+        return "stats are disabled (define EZ_PROTOCOL_SERIALIZER_STATS)\n";
+
+    std::string text = "total: ";
+    append_counters(text, total, false);
+    text += "\nlookup misses " + std::to_string(lookup_misses) + ", reallocations " + std::to_string(reallocations) + "\n";
+    for (const field_stats& field : fields) {
+        if (!is_accessed(field.values))
+            continue;
+        text += field.name + ": ";
+        append_counters(text, field.values, false);
+        text += "\n";
+    }
+    return text;
+}
+
+std::string ez::serializer_stats::to_json() const
+{
+    std::string text = std::string("{\"enabled\": ") + (is_enabled ? "true" : "false");
+    text += ", \"lookup_misses\": " + std::to_string(lookup_misses) + ", \"reallocations\": " + std::to_string(reallocations) + ", \"total\": {";
+    append_counters(text, total, true);
+    text += "}, \"fields\": [";
+    for (size_t i = 0; i < fields.size(); ++i) {
+        text += i ? ", {\"name\": " : "{\"name\": ";
+        append_json_string(text, fields[i].name);
+        text += ", ";
+        append_counters(text, fields[i].values, true);
+        text += "}";
+    }
+    text += "]}";
+    return text;
+}
+
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+namespace {
+
+uint64_t generate_sink_id()
+{
+    // Zero never matches a sink, so it marks empty thread cache
+    static std::atomic<uint64_t> last_sink_id(0);
+    return ++last_sink_id;
+}
+
+void add_counters(ez::serializer_stats::counters& sum, const ez::detail::stats_counters& c)
+{
+    sum.reads += c.reads.load(std::memory_order_relaxed);
+    sum.writes += c.writes.load(std::memory_order_relaxed);
+    sum.batch_calls += c.batch_calls.load(std::memory_order_relaxed);
+    sum.shifted_accesses += c.shifted_accesses.load(std::memory_order_relaxed);
+    sum.byte_swaps += c.byte_swaps.load(std::memory_order_relaxed);
+    sum.sign_extensions += c.sign_extensions.load(std::memory_order_relaxed);
+    sum.bytes_touched += c.bytes_touched.load(std::memory_order_relaxed);
+}
+
+void add_counters(ez::serializer_stats::counters& sum, const ez::serializer_stats::counters& c)
+{
+    sum.reads += c.reads;
+    sum.writes += c.writes;
+    sum.batch_calls += c.batch_calls;
+    sum.shifted_accesses += c.shifted_accesses;
+    sum.byte_swaps += c.byte_swaps;
+    sum.sign_extensions += c.sign_extensions;
+    sum.bytes_touched += c.bytes_touched;
+}
+
+void subtract_counters(ez::serializer_stats::counters& c, const ez::serializer_stats::counters& baseline)
+{
+    c.reads -= baseline.reads;
+    c.writes -= baseline.writes;
+    c.batch_calls -= baseline.batch_calls;
+    c.shifted_accesses -= baseline.shifted_accesses;
+    c.byte_swaps -= baseline.byte_swaps;
+    c.sign_extensions -= baseline.sign_extensions;
+    c.bytes_touched -= baseline.bytes_touched;
+}
+
+}
+
+ez::detail::stats_sink::stats_sink()
+    : m_id(generate_sink_id())
+{
+}
+
+// Only misses of thread cache get here
+ez::detail::stats_shard& ez::detail::stats_sink::find_shard(stats_shard_cache& cache)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::thread::id owner = std::this_thread::get_id();
+    for (const std::shared_ptr<stats_shard>& shard : m_shards) {
+        if (shard->owner == owner && !shard->is_retired.load(std::memory_order_relaxed))
+            return *shard;
+    }
+
+    // Counters of exited thread keep their values, so its shard goes on counting for this one
+    std::shared_ptr<stats_shard> found;
+    for (const std::shared_ptr<stats_shard>& shard : m_shards) {
+        if (shard->is_retired.load(std::memory_order_acquire)) {
+            found = shard;
+            found->is_retired.store(false, std::memory_order_relaxed);
+            break;
+        }
+    }
+    if (found == nullptr) {
+        found = std::make_shared<stats_shard>();
+        m_shards.push_back(found);
+    }
+    found->owner = owner;
+
+    // Shards of destroyed sinks are only held by their threads
+    cache.owned.erase(std::remove_if(cache.owned.begin(), cache.owned.end(),
+                                     [](const std::shared_ptr<stats_shard>& shard) { return shard.use_count() == 1; }),
+                      cache.owned.end());
+    cache.owned.push_back(found);
+    return *found;
+}
+
+ez::serializer_stats ez::detail::stats_sink::merge() const
+{
+    serializer_stats stats;
+    stats.is_enabled = true;
+    for (const std::shared_ptr<stats_shard>& shard : m_shards) {
+        add_counters(stats.total, shard->ghosts);
+        stats.lookup_misses += shard->lookup_misses.load(std::memory_order_relaxed);
+        stats.reallocations += shard->reallocations.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(shard->pages_mutex);
+        const size_t fields_count = shard->pages.size() * stats_page_length;
+        if (stats.fields.size() < fields_count)
+            stats.fields.resize(fields_count);
+        for (size_t i = 0; i < fields_count; ++i)
+            add_counters(stats.fields[i].values, shard->pages[i / stats_page_length][i % stats_page_length]);
+    }
+
+    // Total includes fields which were removed since
+    for (const serializer_stats::field_stats& field : stats.fields)
+        add_counters(stats.total, field.values);
+    return stats;
+}
+
+ez::serializer_stats ez::detail::stats_sink::snapshot(const std::vector<std::string>& names) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    serializer_stats stats = merge();
+    subtract_counters(stats.total, m_baseline.total);
+    stats.lookup_misses -= m_baseline.lookup_misses;
+    stats.reallocations -= m_baseline.reallocations;
+    for (size_t i = 0; i < m_baseline.fields.size(); ++i)
+        subtract_counters(stats.fields[i].values, m_baseline.fields[i].values);
+
+    // Counters of fields which were removed since are dropped
+    stats.fields.resize(names.size());
+    for (size_t i = 0; i < names.size(); ++i)
+        stats.fields[i].name = names[i];
+    return stats;
+}
+
+void ez::detail::stats_sink::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_baseline = merge();
+}
+#endif
+
+namespace {
+
+using unpack_kernel_t = void(*)(const unsigned char*, uint64_t, unsigned int, size_t, unsigned int, bool, uint64_t*);
+using copy_kernel_t = void(*)(unsigned char*, const unsigned char*, size_t, unsigned int);
+
+template<class Word>
+void copy_swapped_words(unsigned char* destination, const unsigned char* source, const size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        Word word;
+        memcpy(&word, source + i * sizeof(Word), sizeof(Word));
+        word = ez::detail::byte_swap(word);
+        memcpy(destination + i * sizeof(Word), &word, sizeof(Word));
+    }
+}
+
+void copy_swapped_scalar(unsigned char* destination, const unsigned char* source, const size_t count, const unsigned int element_size)
+{
+    if (element_size == 2)
+        copy_swapped_words<uint16_t>(destination, source, count);
+    else if (element_size == 4)
+        copy_swapped_words<uint32_t>(destination, source, count);
+    else
+        copy_swapped_words<uint64_t>(destination, source, count);
+}
+
+inline uint64_t finish_unpacked(uint64_t raw, const unsigned int reversed_bytes_count, const uint64_t sign_bit)
+{
+    if (reversed_bytes_count)
+        raw = ez::detail::reverse_bytes(raw, reversed_bytes_count);
+    return (raw ^ sign_bit) - sign_bit;
+}
+
+#ifdef EZ_PROTOCOL_SERIALIZER_AVX2
+// Four elements are processed at once: every lane gathers 8 bytes starting at the first byte of its element,
+// converts them into big-endian word and shifts the element out with per-lane variable shift.
+// Elements have to fit into these 8 bytes, so only elements of up to 57 bits are vectorized.
+EZ_TARGET_AVX2
+void unpack_uniform_avx2(const unsigned char* buffer, const uint64_t first_bit, const unsigned int bit_count, const size_t count,
+                         const unsigned int reversed_bytes_count, const bool sign_extend, uint64_t* values)
+{
+    size_t i = 0;
+    if (bit_count <= 57) {
+        const uint64_t end_byte = (first_bit + count * bit_count + 7) / 8;
+        const uint64_t sign_bit = sign_extend ? uint64_t(1) << (bit_count - 1) : 0;
+        const __m256i swap_bytes = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                                    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        const __m128i value_shift = _mm_cvtsi32_si128(static_cast<int>(64 - bit_count));
+        const __m128i reversed_shift = _mm_cvtsi32_si128(static_cast<int>(64 - reversed_bytes_count * 8));
+        const __m256i sign_bits = _mm256_set1_epi64x(static_cast<long long>(sign_bit));
+        const __m256i spacing_mask = _mm256_set1_epi64x(7);
+        const __m256i step = _mm256_set1_epi64x(static_cast<long long>(4 * bit_count));
+        __m256i bits = _mm256_setr_epi64x(static_cast<long long>(first_bit), static_cast<long long>(first_bit + bit_count),
+                                          static_cast<long long>(first_bit + 2 * bit_count), static_cast<long long>(first_bit + 3 * bit_count));
+
+        // Gathered bytes must not leave the array, remaining elements are handled by scalar kernel
+        for (; i + 4 <= count && (first_bit + (i + 3) * bit_count) / 8 + 8 <= end_byte; i += 4) {
+            __m256i words = _mm256_i64gather_epi64(reinterpret_cast<const long long*>(buffer), _mm256_srli_epi64(bits, 3), 1);
+            words = _mm256_shuffle_epi8(words, swap_bytes);
+            words = _mm256_sllv_epi64(words, _mm256_and_si256(bits, spacing_mask));
+            words = _mm256_srl_epi64(words, value_shift);
+            if (reversed_bytes_count)
+                words = _mm256_srl_epi64(_mm256_shuffle_epi8(words, swap_bytes), reversed_shift);
+            words = _mm256_sub_epi64(_mm256_xor_si256(words, sign_bits), sign_bits);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i), words);
+            bits = _mm256_add_epi64(bits, step);
+        }
+    }
+
+    ez::detail::unpack_uniform_scalar(buffer, first_bit + i * bit_count, bit_count, count - i, reversed_bytes_count, sign_extend, values + i);
+}
+
+// 32 bytes are reversed per iteration with a single byte shuffle
+EZ_TARGET_AVX2
+void copy_swapped_avx2(unsigned char* destination, const unsigned char* source, const size_t count, const unsigned int element_size)
+{
+    const __m256i swap_bytes = element_size == 2
+        ? _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14, 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14)
+        : element_size == 4
+        ? _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12)
+        : _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+
+    const size_t bytes_count = count * element_size;
+    size_t i = 0;
+    for (; i + 32 <= bytes_count; i += 32) {
+        const __m256i words = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_shuffle_epi8(words, swap_bytes));
+    }
+
+    copy_swapped_scalar(destination + i, source + i, count - i / element_size, element_size);
+}
+
+bool cpu_supports_avx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // YMM registers have to be enabled by OS as well
+    __cpuid(info, 1);
+    if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+unpack_kernel_t select_unpack_kernel()
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_AVX2
+    if (cpu_supports_avx2())
+        return unpack_uniform_avx2;
+#endif
+    return ez::detail::unpack_uniform_scalar;
+}
+
+copy_kernel_t select_copy_kernel()
+{
+#ifdef EZ_PROTOCOL_SERIALIZER_AVX2
+    if (cpu_supports_avx2())
+        return copy_swapped_avx2;
+#endif
+    return copy_swapped_scalar;
+}
+
+}
+
+void ez::detail::unpack_uniform(const unsigned char* buffer, const uint64_t first_bit, const unsigned int bit_count, const size_t count,
+                                const unsigned int reversed_bytes_count, const bool sign_extend, uint64_t* values)
+{
+    static const unpack_kernel_t kernel = select_unpack_kernel();
+    kernel(buffer, first_bit, bit_count, count, reversed_bytes_count, sign_extend, values);
+}
+
+void ez::detail::unpack_uniform_scalar(const unsigned char* buffer, const uint64_t first_bit, const unsigned int bit_count, const size_t count,
+                                       const unsigned int reversed_bytes_count, const bool sign_extend, uint64_t* values)
+{
+    const uint64_t end_byte = (first_bit + count * bit_count + 7) / 8;
+    const uint64_t sign_bit = sign_extend ? uint64_t(1) << (bit_count - 1) : 0;
+    uint64_t bit = first_bit;
+    for (size_t i = 0; i < count; ++i, bit += bit_count) {
+        const uint64_t byte = bit / 8;
+        const unsigned int left_spacing = bit % 8;
+        uint64_t raw;
+        // Single 8-byte load is enough unless element is too long or array ends earlier
+        if (left_spacing + bit_count <= 64 && byte + 8 <= end_byte)
+            raw = (load_be64(buffer + byte) << left_spacing) >> (64 - bit_count);
+        else {
+            const unsigned int touched_bytes_count = (left_spacing + bit_count + 7) / 8;
+            raw = extract_bits(buffer + byte, touched_bytes_count, touched_bytes_count * 8 - left_spacing - bit_count, bit_count);
+        }
+        values[i] = finish_unpacked(raw, reversed_bytes_count, sign_bit);
+    }
+}
+
+void ez::detail::copy_elements(void* destination, const void* source, const size_t count, const unsigned int element_size, const bool reverse_bytes)
+{
+    if (!reverse_bytes || element_size == 1) {
+        memcpy(destination, source, count * element_size);
+        return;
+    }
+
+    static const copy_kernel_t kernel = select_copy_kernel();
+    kernel(static_cast<unsigned char*>(destination), static_cast<const unsigned char*>(source), count, element_size);
+}
+
+// Bits are moved by chunks of up to 32 bits. Chunks are processed from the beginning when bits move towards
+// the beginning of the buffer and from the end otherwise, so source bits are never overwritten before they are read
+void ez::detail::move_bits(unsigned char* buffer, const uint64_t destination_bit, const uint64_t source_bit, const uint64_t bit_count)
+{
+    if (bit_count == 0 || destination_bit == source_bit)
+        return;
+
+    if (destination_bit % 8 == 0 && source_bit % 8 == 0 && bit_count % 8 == 0) {
+        memmove(buffer + destination_bit / 8, buffer + source_bit / 8, bit_count / 8);
+        return;
+    }
+
+    const auto move_chunk = [buffer](const uint64_t destination, const uint64_t source, const unsigned int chunk_bit_count) {
+        const unsigned int source_spacing = source % 8;
+        const unsigned int source_touched = (source_spacing + chunk_bit_count + 7) / 8;
+        const uint64_t value = extract_bits(buffer + source / 8, source_touched, source_touched * 8 - source_spacing - chunk_bit_count, chunk_bit_count);
+        const unsigned int destination_spacing = destination % 8;
+        const unsigned int destination_touched = (destination_spacing + chunk_bit_count + 7) / 8;
+        insert_bits(buffer + destination / 8, destination_touched, destination_spacing,
+                    destination_touched * 8 - destination_spacing - chunk_bit_count, chunk_bit_count, value);
+    };
+
+    if (destination_bit < source_bit) {
+        for (uint64_t offset = 0; offset < bit_count; offset += 32) {
+            const unsigned int chunk_bit_count = static_cast<unsigned int>(bit_count - offset < 32 ? bit_count - offset : 32);
+            move_chunk(destination_bit + offset, source_bit + offset, chunk_bit_count);
+        }
+        return;
+    }
+
+    for (uint64_t end = bit_count; end > 0;) {
+        const unsigned int chunk_bit_count = static_cast<unsigned int>(end < 32 ? end : 32);
+        end -= chunk_bit_count;
+        move_chunk(destination_bit + end, source_bit + end, chunk_bit_count);
+    }
+}
+
+void ez::detail::clear_bits(unsigned char* buffer, const uint64_t first_bit, const uint64_t bit_count)
+{
+    for (uint64_t offset = 0; offset < bit_count; offset += 32) {
+        const unsigned int chunk_bit_count = static_cast<unsigned int>(bit_count - offset < 32 ? bit_count - offset : 32);
+        const uint64_t bit = first_bit + offset;
+        const unsigned int spacing = bit % 8;
+        const unsigned int touched = (spacing + chunk_bit_count + 7) / 8;
+        insert_bits(buffer + bit / 8, touched, spacing, touched * 8 - spacing - chunk_bit_count, chunk_bit_count, 0);
+    }
+}
+
+// Field bits are the bytes of the span shifted left by right_spacing bits: interior bytes are moved by whole 64-bit words
+// and only the first and the last touched bytes are merged with bits around the field.
+// Span is one byte shorter than touched bytes when leading bits of the field fit into the first span byte together with the rest
+void ez::detail::extract_span(const unsigned char* buffer, const uint64_t first_bit, const unsigned int bit_count, unsigned char* bytes)
+{
+    const unsigned int bytes_count = (bit_count + 7) / 8;
+    if (bit_count <= 64) {
+        const unsigned int touched = static_cast<unsigned int>((first_bit + bit_count + 7) / 8 - first_bit / 8);
+        const unsigned int right_spacing = touched * 8 - bit_count - static_cast<unsigned int>(first_bit % 8);
+        store_be(bytes, bytes_count, extract_bits(buffer + first_bit / 8, touched, right_spacing, bit_count));
+        return;
+    }
+    if (first_bit % 8 == 0 && bit_count % 8 == 0) {
+        memcpy(bytes, buffer + first_bit / 8, bytes_count);
+        return;
+    }
+
+    const unsigned char* source = buffer + first_bit / 8;
+    const unsigned int touched = static_cast<unsigned int>((first_bit + bit_count + 7) / 8 - first_bit / 8);
+    const unsigned int right_spacing = touched * 8 - bit_count - static_cast<unsigned int>(first_bit % 8);
+    const unsigned int offset = touched - bytes_count;
+    const auto read_word = [&](const unsigned int k) {
+        uint64_t word = load_be64(source + k - 8) >> right_spacing;
+        if (right_spacing)
+            word |= uint64_t(source[k - 9]) << (64 - right_spacing);
+        store_be64(bytes + k - 8 - offset, word);
+    };
+
+    // Span byte k - offset takes its bits from touched bytes k - 1 and k. The leading ones are read by a word which overlaps already read bytes
+    for (unsigned int k = touched; k > 9; k -= 8)
+        read_word(k);
+    read_word(9);
+    if (offset == 0)
+        bytes[0] = static_cast<unsigned char>(source[0] >> right_spacing);
+    bytes[0] &= static_cast<unsigned char>(0xFF >> ((8 - bit_count % 8) % 8));
+}
+
+void ez::detail::insert_span(unsigned char* buffer, const uint64_t first_bit, const unsigned int bit_count, const unsigned char* bytes)
+{
+    const unsigned int bytes_count = (bit_count + 7) / 8;
+    const unsigned int left_spacing = static_cast<unsigned int>(first_bit % 8);
+    const unsigned int touched = static_cast<unsigned int>((first_bit + bit_count + 7) / 8 - first_bit / 8);
+    const unsigned int right_spacing = touched * 8 - bit_count - left_spacing;
+    if (bit_count <= 64) {
+        insert_bits(buffer + first_bit / 8, touched, left_spacing, right_spacing, bit_count, load_be(bytes, bytes_count));
+        return;
+    }
+    if (left_spacing == 0 && right_spacing == 0) {
+        memcpy(buffer + first_bit / 8, bytes, bytes_count);
+        return;
+    }
+
+    // Touched byte k takes its bits from span bytes k - offset and k - offset + 1. Interior bytes are written by 64-bit words
+    // from the end, the leading ones by one more word which overlaps already written bytes
+    unsigned char* destination = buffer + first_bit / 8;
+    const unsigned int offset = touched - bytes_count;
+    const auto write_word = [&](const unsigned int k) {
+        const unsigned char* source = bytes + k - 8 - offset;
+        uint64_t word = load_be64(source) << right_spacing;
+        if (right_spacing)
+            word |= source[8] >> (8 - right_spacing);
+        store_be64(destination + k - 8, word);
+    };
+    const unsigned char first_byte = static_cast<unsigned char>(offset ? bytes[0] >> (8 - right_spacing) : (bytes[0] << right_spacing) | (bytes[1] >> (8 - right_spacing)));
+    const unsigned char first_mask = static_cast<unsigned char>(0xFF >> left_spacing);
+    const unsigned char last_mask = static_cast<unsigned char>(0xFF << right_spacing);
+    const unsigned char last_byte = static_cast<unsigned char>(bytes[bytes_count - 1] << right_spacing);
+
+    if (touched > 9) {
+        for (unsigned int k = touched - 1; k > 9; k -= 8)
+            write_word(k);
+        write_word(9);
+    }
+    else {
+        // 9 touched bytes hold no span bytes with offset
+        for (unsigned int k = 1; k < 8; ++k)
+            destination[k] = static_cast<unsigned char>((bytes[k] << right_spacing) | (bytes[k + 1] >> (8 - right_spacing)));
+    }
+    destination[0] = static_cast<unsigned char>((destination[0] & ~first_mask) | (first_byte & first_mask));
+    destination[touched - 1] = static_cast<unsigned char>((destination[touched - 1] & ~last_mask) | (last_byte & last_mask));
+}
+
+// Elements are streamed into accumulator which is flushed into the buffer by 32 bits.
+// AVX2 has no scatter and elements straddle bytes, so single streaming pass is faster than any vector variant here
+void ez::detail::pack_uniform(unsigned char* buffer, const uint64_t first_bit, const unsigned int bit_count, const size_t count, const uint64_t* values)
+{
+    if (count == 0)
+        return;
+
+    unsigned char* ptr = buffer + first_bit / 8;
+    const unsigned int left_spacing = first_bit % 8;
+    const uint64_t mask = low_bits_mask(bit_count);
+
+    // pending_bits least significant bits of accumulator are not stored yet. Bits before the array are pending as well,
+    // so they are written back unchanged
+    uint64_t accumulator = left_spacing ? (*ptr >> (8 - left_spacing)) : 0;
+    unsigned int pending_bits = left_spacing;
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t value = values[i] & mask;
+        if (bit_count > 32) {
+            accumulator = (accumulator << (bit_count - 32)) | (value >> 32);
+            pending_bits += bit_count - 32;
+            if (pending_bits >= 32) {
+                pending_bits -= 32;
+                store_be32(ptr, static_cast<uint32_t>(accumulator >> pending_bits));
+                ptr += 4;
+            }
+            accumulator = (accumulator << 32) | (value & 0xFFFFFFFF);
+            pending_bits += 32;
+        } else {
+            accumulator = (accumulator << bit_count) | value;
+            pending_bits += bit_count;
+        }
+
+        if (pending_bits >= 32) {
+            pending_bits -= 32;
+            store_be32(ptr, static_cast<uint32_t>(accumulator >> pending_bits));
+            ptr += 4;
+        }
+    }
+
+    for (; pending_bits >= 8; pending_bits -= 8)
+        *ptr++ = static_cast<unsigned char>(accumulator >> (pending_bits - 8));
+
+    // Last byte is shared with whatever follows the array
+    if (pending_bits) {
+        const unsigned char last_mask = static_cast<unsigned char>(0xFF << (8 - pending_bits));
+        *ptr = static_cast<unsigned char>((*ptr & ~last_mask) | ((accumulator << (8 - pending_bits)) & last_mask));
+    }
 }
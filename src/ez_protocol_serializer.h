@@ -21,17 +21,396 @@
 #define EZ_PROTOCOL_SERIALIZER
 
 #include <list>
+#include <array>
 #include <memory>
 #include <vector>
 #include <string>
 #include <cstring>
+#include <cstdint>
+#include <functional>
 #include <type_traits>
 #include <unordered_map>
+#if defined(_MSC_VER)
+#include <stdlib.h>
+#endif
+#include <ez_serializer_stats.h>
+
+// Fields of up to 128 bits may be read/written as integers where compiler provides 128-bit integers
+#if defined(__SIZEOF_INT128__)
+#define EZ_PROTOCOL_SERIALIZER_INT128
+#endif
 
 namespace ez {
 
+#ifdef EZ_PROTOCOL_SERIALIZER_INT128
+__extension__ typedef unsigned __int128 uint128_t;
+#endif
+
+namespace detail {
+
+// Bit-level kernels shared by everything which reads or writes protocol fields.
+// Fields are numbered as a big-endian bit stream: bit 0 is the most significant bit of byte 0.
+
+inline uint64_t byte_swap(const uint64_t value)
+{
+#if defined(_MSC_VER)
+    return _byteswap_uint64(value);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap64(value);
+#else
+    uint64_t result = 0;
+    for (int i = 0; i < 8; ++i)
+        result |= ((value >> (i * 8)) & 0xFF) << ((7 - i) * 8);
+    return result;
+#endif
+}
+
+inline uint16_t byte_swap(const uint16_t value)
+{
+    return static_cast<uint16_t>((value >> 8) | (value << 8));
+}
+
+inline uint32_t byte_swap(const uint32_t value)
+{
+#if defined(_MSC_VER)
+    return _byteswap_ulong(value);
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(value);
+#else
+    return (value >> 24) | ((value >> 8) & 0xFF00) | ((value << 8) & 0xFF0000) | (value << 24);
+#endif
+}
+
+inline constexpr bool is_host_little_endian()
+{
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+#else
+    return true; // MSVC only targets little-endian platforms
+#endif
+}
+
+// Mask of bit_count least significant bits (bit_count is in [0, 64])
+inline uint64_t low_bits_mask(const unsigned int bit_count)
+{
+    return bit_count >= 64 ? ~uint64_t(0) : (uint64_t(1) << bit_count) - 1;
+}
+
+// Reverses order of bytes_count least significant bytes (bytes_count is in [1, 8])
+inline uint64_t reverse_bytes(const uint64_t value, const unsigned int bytes_count)
+{
+    return byte_swap(value) >> (64 - bytes_count * 8);
+}
+
+inline uint32_t load_be32(const unsigned char* ptr)
+{
+    uint32_t word;
+    memcpy(&word, ptr, 4);
+    return is_host_little_endian() ? byte_swap(word) : word;
+}
+
+inline uint64_t load_be64(const unsigned char* ptr)
+{
+    uint64_t word;
+    memcpy(&word, ptr, 8);
+    return is_host_little_endian() ? byte_swap(word) : word;
+}
+
+inline void store_be32(unsigned char* ptr, uint32_t word)
+{
+    word = is_host_little_endian() ? byte_swap(word) : word;
+    memcpy(ptr, &word, 4);
+}
+
+inline void store_be64(unsigned char* ptr, uint64_t word)
+{
+    word = is_host_little_endian() ? byte_swap(word) : word;
+    memcpy(ptr, &word, 8);
+}
+
+// Loads bytes_count (in [1, 8]) bytes as big-endian integer without touching any byte outside of them.
+// Lengths of 4 and more are loaded with two (possibly overlapping) 4-byte loads.
+inline uint64_t load_be(const unsigned char* ptr, const unsigned int bytes_count)
+{
+    if (bytes_count >= 4)
+        return (uint64_t(load_be32(ptr)) << ((bytes_count - 4) * 8)) | load_be32(ptr + bytes_count - 4);
+
+    uint64_t word = ptr[0];
+    for (unsigned int i = 1; i < bytes_count; ++i)
+        word = (word << 8) | ptr[i];
+    return word;
+}
+
+inline void store_be(unsigned char* ptr, const unsigned int bytes_count, const uint64_t word)
+{
+    if (bytes_count >= 4) {
+        store_be32(ptr, static_cast<uint32_t>(word >> ((bytes_count - 4) * 8)));
+        store_be32(ptr + bytes_count - 4, static_cast<uint32_t>(word));
+        return;
+    }
+
+    for (unsigned int i = 0; i < bytes_count; ++i)
+        ptr[i] = static_cast<unsigned char>(word >> ((bytes_count - 1 - i) * 8));
+}
+
+// Extracts field of up to 64 bits which spans touched_bytes_count (up to 9) bytes starting at ptr
+// and ends right_spacing bits before the end of the last touched byte
+inline uint64_t extract_bits(const unsigned char* ptr, const unsigned int touched_bytes_count,
+                             const unsigned int right_spacing, const unsigned int bit_count)
+{
+    uint64_t value;
+    if (touched_bytes_count <= 8)
+        value = load_be(ptr, touched_bytes_count) >> right_spacing;
+    else
+        value = (load_be(ptr, 8) << (8 - right_spacing)) | (ptr[8] >> right_spacing);
+    return value & low_bits_mask(bit_count);
+}
+
+// Replaces field bits with bit_count least significant bits of value. Bits around the field are preserved
+inline void insert_bits(unsigned char* ptr, const unsigned int touched_bytes_count, const unsigned int left_spacing,
+                        const unsigned int right_spacing, const unsigned int bit_count, const uint64_t value)
+{
+    if (touched_bytes_count <= 8) {
+        if (left_spacing == 0 && right_spacing == 0) {
+            store_be(ptr, touched_bytes_count, value);
+            return;
+        }
+        const uint64_t mask = low_bits_mask(bit_count) << right_spacing;
+        const uint64_t word = load_be(ptr, touched_bytes_count);
+        store_be(ptr, touched_bytes_count, (word & ~mask) | ((value << right_spacing) & mask));
+        return;
+    }
+
+    const uint64_t mask = low_bits_mask(64 - left_spacing);
+    const uint64_t word = load_be(ptr, 8);
+    store_be(ptr, 8, (word & ~mask) | ((value >> (8 - right_spacing)) & mask));
+    const unsigned char last_mask = static_cast<unsigned char>(0xFF << right_spacing);
+    ptr[8] = static_cast<unsigned char>((ptr[8] & ~last_mask) | ((value << right_spacing) & last_mask));
+}
+
+// Converts value with already applied byte order and sign extension into T.
+// Floating point values are bit_count == bytes_count * 8 bits in host byte order
+template<class T>
+typename std::enable_if<std::is_integral<T>::value, T>::type
+unpacked_to_value(const uint64_t raw, const unsigned int bytes_count)
+{
+    (void)bytes_count;
+    return static_cast<T>(raw);
+}
+template<class T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type
+unpacked_to_value(const uint64_t raw, const unsigned int bytes_count)
+{
+    if (bytes_count == 4) {
+        const uint32_t bits = static_cast<uint32_t>(raw);
+        float value;
+        memcpy(&value, &bits, 4);
+        return static_cast<T>(value);
+    }
+
+    double value;
+    memcpy(&value, &raw, 8);
+    return static_cast<T>(value);
+}
+
+// Converts raw field bits into T. Integers are interpreted according to protocol byte order,
+// while floating point values are always stored in host byte order
+template<class T>
+typename std::enable_if<std::is_integral<T>::value, T>::type
+decode_value(uint64_t raw, const unsigned int bit_count, const unsigned int bytes_count, const bool is_little_endian)
+{
+    if (is_little_endian && bytes_count > 1)
+        raw = reverse_bytes(raw, bytes_count);
+
+    // Sign-extend values which are shorter than T. Longer values are narrowed by cutting most significant bits
+    if (std::is_signed<T>::value && bit_count < sizeof(T) * 8) {
+        const uint64_t sign_bit = uint64_t(1) << (bit_count - 1);
+        raw = (raw ^ sign_bit) - sign_bit;
+    }
+    return static_cast<T>(raw);
+}
+
+template<class T>
+typename std::enable_if<std::is_floating_point<T>::value, T>::type
+decode_value(uint64_t raw, const unsigned int bit_count, const unsigned int bytes_count, const bool is_little_endian)
+{
+    (void)bit_count;
+    (void)is_little_endian;
+    if (is_host_little_endian())
+        raw = reverse_bytes(raw, bytes_count);
+    return unpacked_to_value<T>(raw, bytes_count);
+}
+
+// Converts value into raw field bits (only bit_count least significant bits are meaningful)
+template<class T>
+typename std::enable_if<std::is_integral<T>::value, uint64_t>::type
+encode_value(const T& value, const unsigned int bytes_count, const bool is_little_endian)
+{
+    const uint64_t raw = static_cast<uint64_t>(value);
+    if (is_little_endian && bytes_count > 1)
+        return reverse_bytes(raw, bytes_count);
+    return raw;
+}
+
+template<class T>
+typename std::enable_if<std::is_floating_point<T>::value, uint64_t>::type
+encode_value(const T& value, const unsigned int bytes_count, const bool is_little_endian)
+{
+    (void)is_little_endian;
+    uint64_t raw = 0;
+    if (bytes_count == 4) {
+        const float float_value = static_cast<float>(value);
+        uint32_t bits;
+        memcpy(&bits, &float_value, 4);
+        raw = bits;
+    } else {
+        const double double_value = static_cast<double>(value);
+        memcpy(&raw, &double_value, 8);
+    }
+    return is_host_little_endian() ? reverse_bytes(raw, bytes_count) : raw;
+}
+
+// Column kernels decode/encode one field of records_count records which are record_stride bytes apart.
+// Number of touched bytes is a template parameter, so the loop body has no layout-dependent branches.
+template<class T, unsigned int TouchedBytesCount>
+void read_column(const unsigned char* first_field_byte, const size_t record_stride, const size_t records_count, const unsigned int right_spacing,
+                 const unsigned int bit_count, const unsigned int bytes_count, const bool is_little_endian, T* column)
+{
+    for (size_t i = 0; i < records_count; ++i) {
+        const uint64_t raw = extract_bits(first_field_byte + i * record_stride, TouchedBytesCount, right_spacing, bit_count);
+        column[i] = decode_value<T>(raw, bit_count, bytes_count, is_little_endian);
+    }
+}
+
+template<class T, unsigned int TouchedBytesCount>
+void write_column(unsigned char* first_field_byte, const size_t record_stride, const size_t records_count, const unsigned int left_spacing,
+                  const unsigned int right_spacing, const unsigned int bit_count, const unsigned int bytes_count, const bool is_little_endian, const T* column)
+{
+    for (size_t i = 0; i < records_count; ++i) {
+        const uint64_t raw = encode_value(column[i], bytes_count, is_little_endian);
+        insert_bits(first_field_byte + i * record_stride, TouchedBytesCount, left_spacing, right_spacing, bit_count, raw);
+    }
+}
+
+template<class T>
+void read_column(const unsigned char* first_field_byte, const size_t record_stride, const size_t records_count, const unsigned int touched_bytes_count,
+                 const unsigned int right_spacing, const unsigned int bit_count, const unsigned int bytes_count, const bool is_little_endian, T* column)
+{
+    using kernel_t = void(*)(const unsigned char*, size_t, size_t, unsigned int, unsigned int, unsigned int, bool, T*);
+    static const kernel_t kernels[] = {read_column<T, 1>, read_column<T, 2>, read_column<T, 3>, read_column<T, 4>, read_column<T, 5>,
+                                       read_column<T, 6>, read_column<T, 7>, read_column<T, 8>, read_column<T, 9>};
+    kernels[touched_bytes_count - 1](first_field_byte, record_stride, records_count, right_spacing, bit_count, bytes_count, is_little_endian, column);
+}
+
+template<class T>
+void write_column(unsigned char* first_field_byte, const size_t record_stride, const size_t records_count, const unsigned int touched_bytes_count,
+                  const unsigned int left_spacing, const unsigned int right_spacing, const unsigned int bit_count, const unsigned int bytes_count,
+                  const bool is_little_endian, const T* column)
+{
+    using kernel_t = void(*)(unsigned char*, size_t, size_t, unsigned int, unsigned int, unsigned int, unsigned int, bool, const T*);
+    static const kernel_t kernels[] = {write_column<T, 1>, write_column<T, 2>, write_column<T, 3>, write_column<T, 4>, write_column<T, 5>,
+                                       write_column<T, 6>, write_column<T, 7>, write_column<T, 8>, write_column<T, 9>};
+    kernels[touched_bytes_count - 1](first_field_byte, record_stride, records_count, left_spacing, right_spacing, bit_count, bytes_count, is_little_endian, column);
+}
+
+// Number of array elements which protocol_serializer unpacks/packs at once
+const size_t array_chunk_length = 256;
+
+// Array kernels work with count elements of bit_count (in [1, 64]) bits each, first one starts at first_bit of buffer.
+// unpack_uniform reverses reversed_bytes_count (0 means none) least significant bytes of every element and optionally
+// sign-extends it. It is dispatched at runtime to AVX2 implementation when CPU supports it (see ez_protocol_serializer.cpp)
+void unpack_uniform(const unsigned char* buffer, uint64_t first_bit, unsigned int bit_count, size_t count,
+                    unsigned int reversed_bytes_count, bool sign_extend, uint64_t* values);
+void unpack_uniform_scalar(const unsigned char* buffer, uint64_t first_bit, unsigned int bit_count, size_t count,
+                           unsigned int reversed_bytes_count, bool sign_extend, uint64_t* values);
+// Stores bit_count least significant bits of every value. Bits around the array are preserved
+void pack_uniform(unsigned char* buffer, uint64_t first_bit, unsigned int bit_count, size_t count, const uint64_t* values);
+// Moves bit_count bits from source_bit to destination_bit of buffer. Ranges may overlap
+void move_bits(unsigned char* buffer, uint64_t destination_bit, uint64_t source_bit, uint64_t bit_count);
+// Sets bit_count bits starting at first_bit to zero
+void clear_bits(unsigned char* buffer, uint64_t first_bit, uint64_t bit_count);
+// Copy field of any width to/from (bit_count + 7) / 8 bytes, where it is right-aligned (leading bits of the first byte are zero).
+// Fields are copied by 64-bit words from their end, byte-aligned ones are copied with memcpy()
+void extract_span(const unsigned char* buffer, uint64_t first_bit, unsigned int bit_count, unsigned char* bytes);
+void insert_span(unsigned char* buffer, uint64_t first_bit, unsigned int bit_count, const unsigned char* bytes);
+// Copies count elements of element_size (1, 2, 4 or 8) bytes, optionally reversing bytes of every element.
+// Byte reversal is dispatched at runtime to AVX2 implementation when CPU supports it
+void copy_elements(void* destination, const void* source, size_t count, unsigned int element_size, bool reverse_bytes);
+
+// Contiguous storage of array elements, so byte-aligned arrays may be copied as a whole.
+// Array types without one get nullptr
+template<class Array>
+struct contiguous_array
+{
+    static std::nullptr_t data(Array&) { return nullptr; }
+};
+template<class T>
+struct contiguous_array<T*>
+{
+    static T* data(T* array) { return array; }
+};
+template<class T>
+struct contiguous_array<T* const>
+{
+    static T* data(T* array) { return array; }
+};
+template<class T, size_t N>
+struct contiguous_array<T[N]>
+{
+    static T* data(T (&array)[N]) { return array; }
+};
+template<class T, class Allocator>
+struct contiguous_array<std::vector<T, Allocator>>
+{
+    static T* data(std::vector<T, Allocator>& array) { return array.data(); }
+};
+template<class T, class Allocator>
+struct contiguous_array<const std::vector<T, Allocator>>
+{
+    static const T* data(const std::vector<T, Allocator>& array) { return array.data(); }
+};
+template<class T, size_t N>
+struct contiguous_array<std::array<T, N>>
+{
+    static T* data(std::array<T, N>& array) { return array.data(); }
+};
+template<class T, size_t N>
+struct contiguous_array<const std::array<T, N>>
+{
+    static const T* data(const std::array<T, N>& array) { return array.data(); }
+};
+template<class T, class Deleter>
+struct contiguous_array<std::unique_ptr<T[], Deleter>>
+{
+    static T* data(const std::unique_ptr<T[], Deleter>& array) { return array.get(); }
+};
+template<class T, class Deleter>
+struct contiguous_array<const std::unique_ptr<T[], Deleter>>
+{
+    static T* data(const std::unique_ptr<T[], Deleter>& array) { return array.get(); }
+};
+
+}
+
+template<class Byte>
+class basic_message_view;
+using message_view = basic_message_view<unsigned char>;
+using const_message_view = basic_message_view<const unsigned char>;
+
 class protocol_serializer
 {
+    template<class Byte>
+    friend class basic_message_view;
+    friend class record_framer;
+    friend class parallel_decoder;
+    friend class record_filter;
+    friend class record_plan;
+    friend class schema_loader;
+    template<class Struct>
+    friend class struct_binding;
+    template<class... Ts>
+    friend class projection;
+
 public:
     enum class buffer_source
     {
@@ -51,7 +430,9 @@ public:
         ok,
         bad_input,
         not_applicable,
-        field_not_found
+        field_not_found,
+        buffer_too_short,
+        io_error
     };
 
     struct field_init
@@ -59,6 +440,8 @@ public:
         std::string name;
         unsigned int bit_count;
         visualization_type vis_type = visualization_type::unsigned_integer;
+        // Variable-length field: it takes as many units of bit_count bits as value of earlier field length_field says
+        std::string length_field = {};
     };
 
     struct field_metadata
@@ -76,6 +459,15 @@ public:
         visualization_type vis_type;
     };
 
+    // Resolved reference to a field which lets reading/writing skip name lookup. Handle is valid only for the layout id it was
+    // obtained from (see protocol_layout): inserting or removing fields and clearing protocol invalidate it, and so does any change
+    // of fields (appending included) while layout is shared with a copy, a view, a projection, a record plan or a get_layout() caller
+    struct field_handle
+    {
+        unsigned int index = 0;
+        uint64_t layout_id = 0;
+    };
+
     struct visualization_params
     {
         visualization_params& set_draw_header(const bool draw) { this->draw_header = draw; return *this; }
@@ -111,10 +503,53 @@ public:
     };
 
     using fields_list_t = std::list<std::string>;
-    using fields_metadata_t = std::unordered_map<std::string, field_metadata>;
+    using fields_names_t = std::vector<std::string>;
+    using fields_metadata_t = std::vector<field_metadata>;
+    using fields_indices_t = std::unordered_map<std::string, unsigned int>;
     using internal_buffer_ptr_t = std::unique_ptr<unsigned char[]>;
     using byte_ptr_t = unsigned char*;
 
+    // Description of protocol fields in protocol order. Layout is shared by copies of a serializer and is never
+    // modified while shared: serializer which changes its fields gets its own copy first (copy-on-write).
+    // Layout id changes whenever handles obtained before may stop matching: a layout detached from a shared one gets a new id,
+    // and so does a layout whose field indices shift. Only appending to a layout nobody else holds keeps its id
+    // Variable-length fields have no bits in fields_metadata, so metadata of fields after the first of them holds
+    // offsets for all variable-length fields being empty. Actual offsets depend on buffer and are resolved by serializer
+    // Group field holds repeat_count elements of another protocol back to back, layout of that protocol is shared, not copied
+    struct protocol_layout
+    {
+        struct variable_field
+        {
+            unsigned int field_ind;
+            unsigned int length_field_ind;
+            unsigned int unit_bit_count;
+        };
+
+        struct group
+        {
+            unsigned int                           field_ind;
+            unsigned int                           repeat_count;
+            unsigned int                           stride;       // Bits of one element
+            std::shared_ptr<const protocol_layout> layout;
+        };
+
+        fields_names_t              fields;
+        fields_metadata_t           fields_metadata;
+        fields_indices_t            fields_indices;
+        std::vector<variable_field> variable_fields;       // In protocol order
+        std::vector<group>          groups;                // In protocol order
+        unsigned int                length_fields_end = 0; // Writing fields past the last length field never moves any field
+        uint64_t                    id = generate_layout_id();
+
+        // Fields before the first variable-length one have fixed offsets, only they are found here
+        size_t                get_fixed_fields_count() const { return variable_fields.empty() ? fields.size() : variable_fields.front().field_ind; }
+        const field_metadata* find_metadata(const std::string& name) const;
+        const field_metadata* find_metadata(const field_handle& handle) const;
+        field_handle          get_field_handle(const std::string& name, result_code* result = nullptr) const;
+        const group*          find_group(const size_t field_ind) const;
+    };
+    using layout_ptr_t = std::shared_ptr<const protocol_layout>;
+
     // Creation
     protocol_serializer(const bool is_little_endian = false,
                         const buffer_source source = buffer_source::internal,
@@ -130,12 +565,26 @@ public:
 
     // Protocol description
     result_code     append_field(const field_init& init, bool preserve_internal_buffer_values = true);
+    result_code     append_fields(const std::vector<field_init>& fields, bool preserve_internal_buffer_values = true);
+    void            reserve(const size_t fields_count, const unsigned int internal_buffer_length = 0);
     result_code     append_protocol(const protocol_serializer& other, bool preserve_internal_buffer_values = true);
+    // Appends field name which holds repeat_count elements of protocol group (see read(group, element, field)).
+    // Group has to have fields at fixed offsets only, its elements use byte order of this serializer
+    result_code     append_group(const std::string& name, const protocol_serializer& group, const unsigned int repeat_count = 1,
+                                 bool preserve_internal_buffer_values = true);
+    result_code     insert_field(const size_t index, const field_init& init, bool preserve_internal_buffer_values = true);
     result_code     remove_field(const std::string& name, bool preserve_internal_buffer_values = true);
     result_code     remove_last_field(bool preserve_internal_buffer_values = true);
     result_code     clear_protocol();
     fields_list_t   get_fields_list() const;
     field_metadata  get_field_metadata(const std::string& name) const;
+    field_metadata  get_field_metadata(const field_handle& handle) const;
+    layout_ptr_t    get_layout() const;
+
+    // Field handles, see field_handle for when they become invalid
+    field_handle get_field_handle(const std::string& name, result_code* result = nullptr) const;
+    field_handle get_group_field_handle(const std::string& group, const std::string& field, result_code* result = nullptr) const;
+    bool         is_valid_handle(const field_handle& handle) const;
 
     // Byte order for multi-byte integers
     void set_is_little_endian(const bool is_little_endian);
@@ -158,95 +607,288 @@ public:
     unsigned int                 get_internal_buffer_length() const;
     byte_ptr_t                   get_external_buffer() const;
     void                         set_external_buffer(byte_ptr_t const external_buffer);
+    result_code                  set_external_buffer(byte_ptr_t const external_buffer, const size_t length, const bool allow_partial = false);
+    size_t                       get_external_buffer_length() const;
+    size_t                       get_available_fields_count() const;
     byte_ptr_t                   get_working_buffer() const;
     void                         clear_working_buffer();
     byte_ptr_t                   get_field_pointer(const std::string& name) const;
+    byte_ptr_t                   get_field_pointer(const field_handle& handle) const;
+    // Offsets of fields after variable-length ones are resolved whenever buffer, layout or any length field changes
+    // through this serializer, const methods only read them. Call it once contents of external buffer are changed otherwise
+    void                         invalidate_offsets();
+
+    // Views of messages of this protocol placed in arbitrary buffers (see basic_message_view)
+    message_view       make_view(byte_ptr_t const buffer, const size_t length) const;
+    const_message_view make_view(const unsigned char* buffer, const size_t length) const;
 
     // Visualization
     std::string get_visualization(const visualization_params& vp) const;
     std::string get_data_visualization(const data_visualization_params& dvp) const;
+
+    // Access counters (see serializer_stats), empty unless EZ_PROTOCOL_SERIALIZER_STATS is defined.
+    // Counters are kept per field index, so reset them after editing the protocol
+    serializer_stats get_stats() const;
+    void             reset_stats();
     
     // Reading/writing
     template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
     result_code write(const std::string& name, const T& value)
     {
-        m_prealloc_metadata_itt = m_fields_metadata.find(name);
-        if (m_prealloc_metadata_itt == m_fields_metadata.cend())
-            return result_code::field_not_found;
+        const field_metadata* metadata = find_metadata(name);
+        if (metadata == nullptr)
+            return lookup_failure(name);
+
+        count_access<T>(true, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return note_write(metadata, _write(m_working_buffer, m_is_little_endian, *metadata, value));
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write(const field_handle& handle, const T& value)
+    {
+        const field_metadata* metadata = find_metadata(handle);
+        if (metadata == nullptr)
+            return lookup_failure(handle);
 
-        return _write(m_prealloc_metadata_itt->second, value);
+        count_access<T>(true, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return note_write(metadata, _write(m_working_buffer, m_is_little_endian, *metadata, value));
     }
 
     template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
     result_code write_ghost(const unsigned int field_first_bit, const unsigned int field_bit_count, const T& value)
     {
-        return _write(field_metadata(field_first_bit, field_bit_count), value);
+        count_access<T>(true, false, nullptr, field_first_bit, field_bit_count, spanned_bytes(field_first_bit, field_bit_count));
+        return note_write(nullptr, _write(m_working_buffer, m_is_little_endian, field_metadata(field_first_bit, field_bit_count), value));
     }
 
     template<class Array>
     result_code write_array(const std::string& name, Array& array, const size_t size)
     {
-        if (size == 0)
-            return result_code::bad_input;
-
-        m_prealloc_metadata_itt = m_fields_metadata.find(name);
-        if (m_prealloc_metadata_itt == m_fields_metadata.cend())
-            return result_code::field_not_found;
-
-        const field_metadata& metadata = m_prealloc_metadata_itt->second;
-        if (metadata.bit_count % size)
-            return result_code::not_applicable;
-
-        const unsigned char ghost_field_length = metadata.bit_count / size;
-        for (unsigned int i = 0; i < size; ++i) {
-            const unsigned int first_bit_ind = metadata.first_bit_ind + i * ghost_field_length;
-            const result_code result = write_ghost(first_bit_ind, ghost_field_length, array[i]);
-            if (result != result_code::ok)
-                return result;
-        }
+        return _write_array(find_metadata(name), name, array, size);
+    }
 
-        return result_code::ok;
+    template<class Array>
+    result_code write_array(const field_handle& handle, Array& array, const size_t size)
+    {
+        return _write_array(find_metadata(handle), handle, array, size);
     }
 
     template<class Array>
     result_code write_ghost_array(const unsigned int field_first_bit, const unsigned int field_bit_count, Array& array, const size_t size)
     {
-        if (field_bit_count % size)
-            return result_code::not_applicable;
+        count_access<typename std::decay<decltype(array[0])>::type>(true, true, nullptr, field_first_bit, field_bit_count,
+                                                                     spanned_bytes(field_first_bit, uint64_t(field_bit_count) * size));
+        return note_write(nullptr, _write_uniform_array(m_working_buffer, m_is_little_endian, field_first_bit, field_bit_count, array, size));
+    }
 
-        const unsigned char ghost_field_length = field_bit_count / size;
-        for (unsigned int i = 0; i < size; ++i) {
-            const unsigned int first_bit_ind = field_first_bit + i * ghost_field_length;
-            const result_code result = set_ghost(first_bit_ind, ghost_field_length, array[i]);
-            if (result != result_code::ok)
-                return result;
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    T read(const std::string& name, result_code* result = nullptr) const
+    {
+        const field_metadata* metadata = find_metadata(name);
+        if (metadata == nullptr) {
+            set_result(result, lookup_failure(name));
+            return T{};
         }
-        
-        return result_code::ok;
+        count_access<T>(false, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return _read<T>(m_working_buffer, m_is_little_endian, *metadata, result);
     }
 
     template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
-    T read(const std::string& name, result_code* result = nullptr) const
+    T read(const field_handle& handle, result_code* result = nullptr) const
     {
-        m_prealloc_metadata_itt = m_fields_metadata.find(name);
-        if (m_prealloc_metadata_itt == m_fields_metadata.cend()) {
-            set_result(result, result_code::field_not_found);
+        const field_metadata* metadata = find_metadata(handle);
+        if (metadata == nullptr) {
+            set_result(result, lookup_failure(handle));
             return T{};
         }
-        return _read<T>(m_prealloc_metadata_itt->second, result);
+        count_access<T>(false, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return _read<T>(m_working_buffer, m_is_little_endian, *metadata, result);
     }
 
     template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
     T read_ghost(const unsigned int field_first_bit, const unsigned int field_bit_count, result_code* result = nullptr) const
     {
-        return _read<T>(field_metadata(field_first_bit, field_bit_count), result);
+        count_access<T>(false, false, nullptr, field_first_bit, field_bit_count, spanned_bytes(field_first_bit, field_bit_count));
+        return _read<T>(m_working_buffer, m_is_little_endian, field_metadata(field_first_bit, field_bit_count), result);
     }
 
     template<class Array>
     void read_array(const std::string& name, Array& array, const size_t size, result_code* result = nullptr) const
     {
         using ElementType = typename std::decay<decltype(std::declval<Array>()[0])>::type;
-        _read_array<Array, ElementType>(name, array, size, result);
+        _read_array<Array, ElementType>(find_metadata(name), name, array, size, result);
+    }
+
+    template<class Array>
+    void read_array(const field_handle& handle, Array& array, const size_t size, result_code* result = nullptr) const
+    {
+        using ElementType = typename std::decay<decltype(std::declval<Array>()[0])>::type;
+        _read_array<Array, ElementType>(find_metadata(handle), handle, array, size, result);
+    }
+
+    // Fields of any width (including ones longer than 64 bits) as (bit_count + 7) / 8 bytes in protocol byte order.
+    // Value is right-aligned: leading bits of the first byte are zero. length has to be exactly that number of bytes
+    result_code read_bytes(const std::string& name, unsigned char* bytes, const size_t length) const
+    {
+        const field_metadata* metadata = find_metadata(name);
+        if (metadata == nullptr)
+            return lookup_failure(name);
+
+        count_access<uint64_t>(false, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return _read_bytes(m_working_buffer, m_is_little_endian, *metadata, bytes, length);
+    }
+
+    result_code read_bytes(const field_handle& handle, unsigned char* bytes, const size_t length) const
+    {
+        const field_metadata* metadata = find_metadata(handle);
+        if (metadata == nullptr)
+            return lookup_failure(handle);
+
+        count_access<uint64_t>(false, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return _read_bytes(m_working_buffer, m_is_little_endian, *metadata, bytes, length);
+    }
+
+    result_code write_bytes(const std::string& name, const unsigned char* bytes, const size_t length)
+    {
+        const field_metadata* metadata = find_metadata(name);
+        if (metadata == nullptr)
+            return lookup_failure(name);
+
+        count_access<uint64_t>(true, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return note_write(metadata, _write_bytes(m_working_buffer, m_is_little_endian, *metadata, bytes, length));
+    }
+
+    result_code write_bytes(const field_handle& handle, const unsigned char* bytes, const size_t length)
+    {
+        const field_metadata* metadata = find_metadata(handle);
+        if (metadata == nullptr)
+            return lookup_failure(handle);
+
+        count_access<uint64_t>(true, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return note_write(metadata, _write_bytes(m_working_buffer, m_is_little_endian, *metadata, bytes, length));
+    }
+
+#ifdef EZ_PROTOCOL_SERIALIZER_INT128
+    // Fields of up to 128 bits as unsigned integers (see read<T>()/write())
+    uint128_t read_uint128(const std::string& name, result_code* result = nullptr) const
+    {
+        const field_metadata* metadata = find_metadata(name);
+        if (metadata == nullptr) {
+            set_result(result, lookup_failure(name));
+            return 0;
+        }
+        count_access<uint64_t>(false, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return _read_uint128(m_working_buffer, m_is_little_endian, *metadata, result);
+    }
+
+    uint128_t read_uint128(const field_handle& handle, result_code* result = nullptr) const
+    {
+        const field_metadata* metadata = find_metadata(handle);
+        if (metadata == nullptr) {
+            set_result(result, lookup_failure(handle));
+            return 0;
+        }
+        count_access<uint64_t>(false, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return _read_uint128(m_working_buffer, m_is_little_endian, *metadata, result);
+    }
+
+    result_code write_uint128(const std::string& name, const uint128_t value)
+    {
+        const field_metadata* metadata = find_metadata(name);
+        if (metadata == nullptr)
+            return lookup_failure(name);
+
+        count_access<uint64_t>(true, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return note_write(metadata, _write_uint128(m_working_buffer, m_is_little_endian, *metadata, value));
+    }
+
+    result_code write_uint128(const field_handle& handle, const uint128_t value)
+    {
+        const field_metadata* metadata = find_metadata(handle);
+        if (metadata == nullptr)
+            return lookup_failure(handle);
+
+        count_access<uint64_t>(true, false, metadata, metadata->first_bit_ind, metadata->bit_count, metadata->touched_bytes_count);
+        return note_write(metadata, _write_uint128(m_working_buffer, m_is_little_endian, *metadata, value));
+    }
+#endif
+
+    // Fields of element of group field (see append_group), element's offset is computed from group stride.
+    // Fields are named as in group protocol, their handles are ones of group protocol (see get_group_field_handle())
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    T read(const std::string& group, const size_t element, const std::string& field, result_code* result = nullptr) const
+    {
+        const field_metadata* group_metadata = nullptr;
+        const field_metadata metadata = find_group_metadata(group, element, field, group_metadata, result);
+        if (group_metadata == nullptr)
+            return T{};
+
+        count_access<T>(false, false, group_metadata, metadata.first_bit_ind, metadata.bit_count, metadata.touched_bytes_count);
+        return _read<T>(m_working_buffer, m_is_little_endian, metadata, result);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    T read(const field_handle& group, const size_t element, const field_handle& field, result_code* result = nullptr) const
+    {
+        const field_metadata* group_metadata = nullptr;
+        const field_metadata metadata = find_group_metadata(group, element, field, group_metadata, result);
+        if (group_metadata == nullptr)
+            return T{};
+
+        count_access<T>(false, false, group_metadata, metadata.first_bit_ind, metadata.bit_count, metadata.touched_bytes_count);
+        return _read<T>(m_working_buffer, m_is_little_endian, metadata, result);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write(const std::string& group, const size_t element, const std::string& field, const T& value)
+    {
+        const field_metadata* group_metadata = nullptr;
+        result_code lookup_result = result_code::ok;
+        const field_metadata metadata = find_group_metadata(group, element, field, group_metadata, &lookup_result);
+        if (group_metadata == nullptr)
+            return lookup_result;
+
+        count_access<T>(true, false, group_metadata, metadata.first_bit_ind, metadata.bit_count, metadata.touched_bytes_count);
+        return note_write(group_metadata, _write(m_working_buffer, m_is_little_endian, metadata, value));
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write(const field_handle& group, const size_t element, const field_handle& field, const T& value)
+    {
+        const field_metadata* group_metadata = nullptr;
+        result_code lookup_result = result_code::ok;
+        const field_metadata metadata = find_group_metadata(group, element, field, group_metadata, &lookup_result);
+        if (group_metadata == nullptr)
+            return lookup_result;
+
+        count_access<T>(true, false, group_metadata, metadata.first_bit_ind, metadata.bit_count, metadata.touched_bytes_count);
+        return note_write(group_metadata, _write(m_working_buffer, m_is_little_endian, metadata, value));
+    }
+
+    // Batch reading/writing of a single field of records_count records of this protocol,
+    // which are placed record_stride bytes apart starting at records. Field values are stored in contiguous column.
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code read_column(const std::string& name, const unsigned char* records, const size_t record_stride, const size_t records_count, T* column) const
+    {
+        return _read_column(m_layout->find_metadata(name), records, record_stride, records_count, column);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code read_column(const field_handle& handle, const unsigned char* records, const size_t record_stride, const size_t records_count, T* column) const
+    {
+        return _read_column(m_layout->find_metadata(handle), records, record_stride, records_count, column);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write_column(const std::string& name, unsigned char* records, const size_t record_stride, const size_t records_count, const T* column) const
+    {
+        return _write_column(m_layout->find_metadata(name), records, record_stride, records_count, column);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write_column(const field_handle& handle, unsigned char* records, const size_t record_stride, const size_t records_count, const T* column) const
+    {
+        return _write_column(m_layout->find_metadata(handle), records, record_stride, records_count, column);
     }
 
     template<class Array>
@@ -257,199 +899,316 @@ public:
     }
 
 private:
-    template<class Array, class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
-    void _read_array(const std::string& name, Array& array, const size_t size, result_code* result = nullptr) const
+    template<class Array, class Key>
+    result_code _write_array(const field_metadata* metadata, const Key& key, Array& array, const size_t size)
     {
-        m_prealloc_metadata_itt = m_fields_metadata.find(name);
-        if (m_prealloc_metadata_itt == m_fields_metadata.cend()) {
-            set_result(result, result_code::field_not_found);
-            return;
+        if (size == 0)
+            return result_code::bad_input;
+
+        if (metadata == nullptr)
+            return lookup_failure(key);
+
+        count_access<typename std::decay<decltype(array[0])>::type>(true, true, metadata, metadata->first_bit_ind, metadata->bit_count,
+                                                                     spanned_bytes(metadata->first_bit_ind, uint64_t(metadata->bit_count) * size));
+        return note_write(metadata, _write_uniform_array(m_working_buffer, m_is_little_endian, metadata->first_bit_ind, metadata->bit_count, array, size));
+    }
+
+    // Elements are encoded in chunks on the stack and every chunk is packed into the buffer at once
+    template<class Array>
+    static result_code _write_uniform_array(byte_ptr_t const buffer, const bool is_little_endian,
+                                            const unsigned int field_first_bit, const unsigned int field_bit_count, Array& array, const size_t size)
+    {
+        using ElementType = typename std::decay<decltype(array[0])>::type;
+        if (size == 0)
+            return result_code::bad_input;
+
+        if (field_bit_count % size)
+            return result_code::not_applicable;
+
+        const unsigned int element_bit_count = static_cast<unsigned int>(field_bit_count / size);
+        const result_code validation_result = validate_access<ElementType>(is_little_endian, element_bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
+
+        if (buffer == nullptr)
+            return result_code::bad_input;
+
+        const auto data = detail::contiguous_array<Array>::data(array);
+        if (data != nullptr && is_copyable_array<ElementType>(field_first_bit, element_bit_count)) {
+            detail::copy_elements(buffer + field_first_bit / 8, data, size, sizeof(ElementType), is_reversed_array<ElementType>(is_little_endian));
+            return result_code::ok;
         }
 
-        const field_metadata& metadata = m_prealloc_metadata_itt->second;
-        if (metadata.bit_count % size) {
-            set_result(result, result_code::not_applicable);
-            return;
+        const unsigned int bytes_count = element_bit_count / 8 + ((element_bit_count % 8) ? 1 : 0);
+        uint64_t chunk[detail::array_chunk_length];
+        for (size_t done = 0; done < size; done += detail::array_chunk_length) {
+            const size_t chunk_length = size - done < detail::array_chunk_length ? size - done : detail::array_chunk_length;
+            for (size_t i = 0; i < chunk_length; ++i)
+                chunk[i] = detail::encode_value(array[done + i], bytes_count, is_little_endian);
+            detail::pack_uniform(buffer, field_first_bit + uint64_t(done) * element_bit_count, element_bit_count, chunk_length, chunk);
         }
 
-        const unsigned char ghost_field_length = metadata.bit_count / size;
-        for (unsigned int i = 0; i < size; ++i) {
-            const unsigned int first_bit_ind = metadata.first_bit_ind + i * ghost_field_length;
-            result_code local_result = result_code::ok;
-            array[i] = read_ghost<T>(first_bit_ind, ghost_field_length, &local_result);
-            if (local_result != result_code::ok) {
-                set_result(result, local_result);
-                return;
-            }
+        return result_code::ok;
+    }
+
+    template<class Array, class T, class Key, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    void _read_array(const field_metadata* metadata, const Key& key, Array& array, const size_t size, result_code* result = nullptr) const
+    {
+        if (metadata == nullptr) {
+            set_result(result, lookup_failure(key));
+            return;
         }
 
-        set_result(result, result_code::ok);
+        count_access<T>(false, true, metadata, metadata->first_bit_ind, metadata->bit_count, spanned_bytes(metadata->first_bit_ind, uint64_t(metadata->bit_count) * size));
+        _read_uniform_array<Array, T>(m_working_buffer, m_is_little_endian, metadata->first_bit_ind, metadata->bit_count, array, size, result);
     }
 
     template<class Array, class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
     void _read_ghost_array(const unsigned int field_first_bit, const unsigned int field_bit_count, Array& array, const size_t size, result_code* result = nullptr)
     {
+        count_access<T>(false, true, nullptr, field_first_bit, field_bit_count, spanned_bytes(field_first_bit, uint64_t(field_bit_count) * size));
+        _read_uniform_array<Array, T>(m_working_buffer, m_is_little_endian, field_first_bit, field_bit_count, array, size, result);
+    }
+
+    // Elements are unpacked in chunks on the stack (with vectorized kernel where available) and then converted into T
+    template<class Array, class T>
+    static void _read_uniform_array(const unsigned char* buffer, const bool is_little_endian,
+                                    const unsigned int field_first_bit, const unsigned int field_bit_count, Array& array, const size_t size, result_code* result)
+    {
+        if (size == 0) {
+            set_result(result, result_code::bad_input);
+            return;
+        }
+
         if (field_bit_count % size) {
             set_result(result, result_code::not_applicable);
             return;
         }
 
-        const unsigned char ghost_field_length = field_bit_count / size;
-        for (unsigned int i = 0; i < size; ++i) {
-            const unsigned int first_bit_ind = field_first_bit + i * ghost_field_length;
-            result_code local_result = result_code::ok;
-            array[i] = read_ghost<T>(first_bit_ind, ghost_field_length, &local_result);
-            if (local_result != result_code::ok) {
-                set_result(result, local_result);
-                return;
-            }
+        const unsigned int element_bit_count = static_cast<unsigned int>(field_bit_count / size);
+        const result_code validation_result = validate_access<T>(is_little_endian, element_bit_count);
+        if (validation_result != result_code::ok) {
+            set_result(result, validation_result);
+            return;
+        }
+
+        if (buffer == nullptr) {
+            set_result(result, result_code::bad_input);
+            return;
+        }
+
+        const auto data = detail::contiguous_array<Array>::data(array);
+        if (data != nullptr && is_copyable_array<T>(field_first_bit, element_bit_count)) {
+            detail::copy_elements(data, buffer + field_first_bit / 8, size, sizeof(T), is_reversed_array<T>(is_little_endian));
+            set_result(result, result_code::ok);
+            return;
+        }
+
+        // Same conversions as in detail::decode_value, but applied by the array kernel
+        const unsigned int bytes_count = element_bit_count / 8 + ((element_bit_count % 8) ? 1 : 0);
+        unsigned int reversed_bytes_count = 0;
+        if (std::is_floating_point<T>::value)
+            reversed_bytes_count = detail::is_host_little_endian() ? bytes_count : 0;
+        else if (is_little_endian && bytes_count > 1)
+            reversed_bytes_count = bytes_count;
+        const bool sign_extend = std::is_integral<T>::value && std::is_signed<T>::value && element_bit_count < sizeof(T) * 8;
+
+        uint64_t chunk[detail::array_chunk_length];
+        for (size_t done = 0; done < size; done += detail::array_chunk_length) {
+            const size_t chunk_length = size - done < detail::array_chunk_length ? size - done : detail::array_chunk_length;
+            detail::unpack_uniform(buffer, field_first_bit + uint64_t(done) * element_bit_count, element_bit_count,
+                                   chunk_length, reversed_bytes_count, sign_extend, chunk);
+            for (size_t i = 0; i < chunk_length; ++i)
+                array[done + i] = detail::unpacked_to_value<T>(chunk[i], bytes_count);
         }
 
         set_result(result, result_code::ok);
     }
 
-    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
-    result_code _write(const field_metadata& metadata, const T& value)
+    // Byte-aligned elements of exactly sizeof(T) bytes need no conversion except for (possibly) reversed byte order
+    template<class T>
+    static bool is_copyable_array(const unsigned int field_first_bit, const unsigned int element_bit_count)
     {
-        if (m_is_little_endian && metadata.bit_count > 8 && metadata.bit_count % 8)
+        return !std::is_same<T, bool>::value && field_first_bit % 8 == 0 && element_bit_count == sizeof(T) * 8
+               && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8);
+    }
+
+    // Integers are stored in protocol byte order, floating point values are always stored in host byte order
+    template<class T>
+    static bool is_reversed_array(const bool is_little_endian)
+    {
+        return std::is_integral<T>::value && sizeof(T) > 1 && is_little_endian != detail::is_host_little_endian();
+    }
+
+    // Checks whether value of type T can be read from/written into the field of bit_count bits at all
+    template<class T>
+    static result_code validate_access(const bool is_little_endian, const unsigned int bit_count)
+    {
+        if (bit_count == 0)
+            return result_code::not_applicable;
+
+        if (is_little_endian && bit_count > 8 && bit_count % 8)
             return result_code::not_applicable;
 
         if (std::is_floating_point<T>::value)
-            if (metadata.bit_count != 32 && metadata.bit_count != 64)
+            if (bit_count != 32 && bit_count != 64)
                 return result_code::not_applicable;
 
-        if (metadata.bit_count > 64)
+        if (bit_count > 64)
             return result_code::not_applicable;
 
-        if (m_working_buffer == nullptr)
-            return result_code::bad_input;
+        return result_code::ok;
+    }
 
-        memset(m_prealloc_raw_bytes, 0, 65);
-        if (std::is_integral<T>::value) {
-            m_prealloc_val = value;
-            m_prealloc_ptr_to_first_copyable_msb = (byte_ptr_t)&m_prealloc_val;
-            if (!get_is_host_little_endian()) {
-                m_prealloc_ptr_to_first_copyable_msb += sizeof(uint64_t) - metadata.bytes_count;
-            }
-            memcpy(m_prealloc_raw_bytes, m_prealloc_ptr_to_first_copyable_msb, metadata.bytes_count);
-            if (get_is_host_little_endian() != m_is_little_endian)
-                for (uint32_t i = 0; i < metadata.bytes_count / 2; ++i)
-                    std::swap(m_prealloc_raw_bytes[i], m_prealloc_raw_bytes[metadata.bytes_count - 1 - i]);
-        } else if (std::is_floating_point<T>::value) {
-            if (metadata.bytes_count == 4) {
-                float val = value;
-                memcpy(m_prealloc_raw_bytes, &val, 4);
-            } else if (metadata.bytes_count == 8) {
-                double val = value;
-                memcpy(m_prealloc_raw_bytes, &val, 8);
-            }
-        }
+    template<class T>
+    result_code _read_column(const field_metadata* metadata, const unsigned char* records, const size_t record_stride, const size_t records_count, T* column) const
+    {
+        if (metadata == nullptr)
+            return result_code::field_not_found;
 
-        if (metadata.left_spacing == 0 && metadata.right_spacing == 0) {
-            memcpy(m_working_buffer + metadata.first_byte_ind, m_prealloc_raw_bytes, metadata.bytes_count);
+        const result_code validation_result = validate_access<T>(m_is_little_endian, metadata->bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
+
+        if (records_count == 0)
             return result_code::ok;
-        }
 
-        m_prealloc_final_bytes = m_prealloc_raw_bytes;
-        if (metadata.right_spacing) {
-            shift_right(m_prealloc_raw_bytes, metadata.bytes_count + 1, 8 - metadata.right_spacing);
-            if (unsigned char transferable_bits_count = metadata.bit_count % 8)
-                if (8 - metadata.right_spacing >= transferable_bits_count)
-                    m_prealloc_final_bytes = m_prealloc_raw_bytes + 1;
-        }
+        if (records == nullptr || column == nullptr)
+            return result_code::bad_input;
 
-        unsigned char mask = 0;
-        for (uint32_t i = 0; i < metadata.touched_bytes_count; ++i) {
-            mask = i == 0 ? metadata.first_mask : i != metadata.touched_bytes_count - 1 ? 0xFF : metadata.last_mask;
-            m_working_buffer[metadata.first_byte_ind + i] &= ~mask;
-            m_working_buffer[metadata.first_byte_ind + i] |= m_prealloc_final_bytes[i] & mask;
-        }
+        count_access<T>(false, true, metadata, metadata->first_bit_ind, metadata->bit_count, uint64_t(metadata->touched_bytes_count) * records_count);
+        detail::read_column(records + metadata->first_byte_ind, record_stride, records_count, metadata->touched_bytes_count,
+                            metadata->right_spacing, metadata->bit_count, metadata->bytes_count, m_is_little_endian, column);
+        return result_code::ok;
+    }
+
+    template<class T>
+    result_code _write_column(const field_metadata* metadata, unsigned char* records, const size_t record_stride, const size_t records_count, const T* column) const
+    {
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        const result_code validation_result = validate_access<T>(m_is_little_endian, metadata->bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
+
+        if (records_count == 0)
+            return result_code::ok;
 
+        if (records == nullptr || column == nullptr)
+            return result_code::bad_input;
+
+        count_access<T>(true, true, metadata, metadata->first_bit_ind, metadata->bit_count, uint64_t(metadata->touched_bytes_count) * records_count);
+        detail::write_column(records + metadata->first_byte_ind, record_stride, records_count, metadata->touched_bytes_count,
+                             metadata->left_spacing, metadata->right_spacing, metadata->bit_count, metadata->bytes_count, m_is_little_endian, column);
         return result_code::ok;
     }
 
     template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
-    T _read(const field_metadata& metadata, result_code* result = nullptr) const
+    static result_code _write(byte_ptr_t const buffer, const bool is_little_endian, const field_metadata& metadata, const T& value)
     {
-        if (m_is_little_endian && metadata.bit_count > 8 && metadata.bit_count % 8) {
-            set_result(result, result_code::not_applicable);
-            return T{};
-        }
-        if (std::is_floating_point<T>::value) {
-            if (metadata.bit_count != 32 && metadata.bit_count != 64) {
-                set_result(result, result_code::not_applicable);
-                return T{};
-            }
-        }
+        const result_code validation_result = validate_access<T>(is_little_endian, metadata.bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
 
-        if (metadata.bit_count > 64) {
-            set_result(result, result_code::not_applicable);
+        if (buffer == nullptr)
+            return result_code::bad_input;
+
+        // Value is prepared in a register and merged into the buffer with at most two loads and two stores
+        const uint64_t raw = detail::encode_value(value, metadata.bytes_count, is_little_endian);
+        detail::insert_bits(buffer + metadata.first_byte_ind, metadata.touched_bytes_count,
+                            metadata.left_spacing, metadata.right_spacing, metadata.bit_count, raw);
+        return result_code::ok;
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    static T _read(const unsigned char* buffer, const bool is_little_endian, const field_metadata& metadata, result_code* result = nullptr)
+    {
+        const result_code validation_result = validate_access<T>(is_little_endian, metadata.bit_count);
+        if (validation_result != result_code::ok) {
+            set_result(result, validation_result);
             return T{};
         }
 
-        if (m_working_buffer == nullptr) {
+        if (buffer == nullptr) {
             set_result(result, result_code::bad_input);
             return T{};
         }
 
-        // Copy raw data into reinterpretable buffer
-        memset(m_prealloc_raw_bytes, 0, 65);
-        if (get_is_host_little_endian())
-            m_prealloc_final_bytes = m_prealloc_raw_bytes;
-        else
-            m_prealloc_final_bytes = m_prealloc_raw_bytes + 64 - metadata.touched_bytes_count;
-        memcpy(m_prealloc_final_bytes, m_working_buffer + metadata.first_byte_ind, metadata.touched_bytes_count);
-
-        // Apply masks and shift if necessary in order to align less significant bit of copied value with real less significant bit
-        if (metadata.right_spacing || metadata.left_spacing) {
-            m_prealloc_final_bytes[0] &= metadata.first_mask;
-            if (metadata.touched_bytes_count > 1)
-                m_prealloc_final_bytes[metadata.touched_bytes_count - 1] &= metadata.last_mask;
-
-            if (metadata.right_spacing) {
-                shift_right(m_prealloc_final_bytes, metadata.touched_bytes_count, metadata.right_spacing);
-                m_prealloc_final_bytes += metadata.touched_bytes_count - metadata.bytes_count;
-            }
-        }
+        // Whole field is loaded into a register, so no scratch memory is needed
+        const uint64_t raw = detail::extract_bits(buffer + metadata.first_byte_ind, metadata.touched_bytes_count,
+                                                  metadata.right_spacing, metadata.bit_count);
+        set_result(result, result_code::ok);
+        return detail::decode_value<T>(raw, metadata.bit_count, metadata.bytes_count, is_little_endian);
+    }
 
-        // Return floating point value
-        if (std::is_floating_point<T>::value) {
-            if (metadata.bytes_count == 4)
-                return static_cast<T>(*reinterpret_cast<float*>(m_prealloc_final_bytes));
-            else if (metadata.bytes_count == 8)
-                return static_cast<T>(*reinterpret_cast<double*>(m_prealloc_final_bytes));
-        }
+    static result_code _read_bytes(const unsigned char* buffer, const bool is_little_endian, const field_metadata& metadata, unsigned char* bytes, const size_t length);
+    static result_code _write_bytes(byte_ptr_t const buffer, const bool is_little_endian, const field_metadata& metadata, const unsigned char* bytes, const size_t length);
+#ifdef EZ_PROTOCOL_SERIALIZER_INT128
+    static uint128_t   _read_uint128(const unsigned char* buffer, const bool is_little_endian, const field_metadata& metadata, result_code* result);
+    static result_code _write_uint128(byte_ptr_t const buffer, const bool is_little_endian, const field_metadata& metadata, const uint128_t value);
+#endif
+
+    // Only fields which are available in working buffer are found (see get_available_fields_count())
+    const field_metadata* find_metadata(const std::string& name) const;
+    const field_metadata* find_metadata(const field_handle& handle) const;
+    const field_metadata* find_resolved_metadata(const size_t index) const;
+    // Metadata of field of group element, group_metadata is left nullptr if there is no such field or element
+    field_metadata        find_group_metadata(const std::string& group, const size_t element, const std::string& field,
+                                              const field_metadata*& group_metadata, result_code* result) const;
+    field_metadata        find_group_metadata(const field_handle& group, const size_t element, const field_handle& field,
+                                              const field_metadata*& group_metadata, result_code* result) const;
+    field_metadata        group_element_metadata(const field_metadata& found_metadata, const protocol_layout::group* group, const size_t element,
+                                                 const field_metadata* field, const field_metadata*& group_metadata, result_code* result) const;
+    static field_metadata shifted_metadata(const field_metadata& metadata, const uint64_t shift);
+    void                  resolve_offsets();
+
+    // Index of a field in protocol, metadata of fields after variable-length ones is not in the layout
+    size_t field_index(const field_metadata* field) const
+    {
+        const fields_metadata_t& fixed = m_layout->fields_metadata;
+        if (std::less<const field_metadata*>()(field, fixed.data()) || !std::less<const field_metadata*>()(field, fixed.data() + fixed.size()))
+            return m_layout->get_fixed_fields_count() + static_cast<size_t>(field - m_resolved_metadata.data());
+        return static_cast<size_t>(field - fixed.data());
+    }
 
-        // Swap bytes if byte orders do not match
-        if (get_is_host_little_endian() != m_is_little_endian)
-            for (uint32_t i = 0; i < metadata.bytes_count / 2; ++i)
-                std::swap(m_prealloc_final_bytes[i], m_prealloc_final_bytes[metadata.bytes_count - i - 1]);
-
-        // Back the pointer off for correct reinterpret cast
-        if (!get_is_host_little_endian())
-            m_prealloc_final_bytes = m_prealloc_raw_bytes + 64 - sizeof(T);
-
-        // If we read a signed value, then reinterpret cast will only work if most significant bit (which determines sign)
-        // of the value exactly matches expected position for type T (we could read a 3-bit signed value, then cast will not work)
-        if (std::is_signed<T>::value) {
-            const unsigned char shift_to_reach_most_significant_bit = 7 - (metadata.left_spacing + metadata.right_spacing) % 8;
-            const bool regular_cast_is_enough = metadata.bytes_count == sizeof(T) && shift_to_reach_most_significant_bit == 7;
-            if (!regular_cast_is_enough) {
-                if (!get_is_host_little_endian())
-                    m_prealloc_msb = m_prealloc_raw_bytes[64 - std::min(metadata.bytes_count, static_cast<unsigned int>(sizeof(T)))];
-                else
-                    m_prealloc_msb = m_prealloc_final_bytes[std::min(metadata.bytes_count, static_cast<unsigned int>(sizeof(T))) - 1];
-
-                // If most significant bit is 1 then we need a little trick to return negative value (Two's complement method of representing signed integers)
-                if (m_prealloc_msb & (1 << shift_to_reach_most_significant_bit)) {
-                    set_result(result, result_code::ok);
-                    return *reinterpret_cast<T*>(m_prealloc_final_bytes) - ((uint64_t)1 << (std::min(metadata.bit_count, static_cast<unsigned int>(sizeof(T)) * 8)));
-                }
-            }
-        }
+    // Writing a length field (or anything with ghost access) moves fields after its variable-length field
+    result_code note_write(const field_metadata* field, const result_code result)
+    {
+        if (m_layout->length_fields_end != 0 && (field == nullptr || field_index(field) < m_layout->length_fields_end))
+            invalidate_offsets();
+        return result;
+    }
 
-        set_result(result, result_code::ok);
-        return *reinterpret_cast<T*>(m_prealloc_final_bytes);
+    result_code           lookup_failure(const std::string& name) const;
+    result_code           lookup_failure(const field_handle& handle) const;
+    static uint64_t       generate_layout_id();
+
+    // Counts access to a field (nullptr for ghost fields). Compiled out unless EZ_PROTOCOL_SERIALIZER_STATS is defined
+    template<class T>
+    void count_access(const bool is_write, const bool is_batch, const field_metadata* field, const unsigned int first_bit,
+                      const unsigned int bit_count, const uint64_t bytes_touched) const
+    {
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+        const bool is_shifted = first_bit % 8 != 0 || bit_count % 8 != 0;
+        const bool is_swapped = std::is_integral<T>::value && m_is_little_endian && bit_count > 8;
+        const bool is_extended = !is_write && std::is_integral<T>::value && std::is_signed<T>::value && bit_count < sizeof(T) * 8;
+        detail::stats_shard& shard = m_stats->local();
+        detail::stats_counters& counters = field != nullptr ? m_stats->field(shard, field_index(field)) : shard.ghosts;
+        counters.add(is_write, is_batch, is_shifted, is_swapped, is_extended, bytes_touched);
+#else
+        (void)is_write;
+        (void)is_batch;
+        (void)field;
+        (void)first_bit;
+        (void)bit_count;
+        (void)bytes_touched;
+#endif
+    }
+
+    static uint64_t spanned_bytes(const unsigned int first_bit, const uint64_t bit_count)
+    {
+        return (first_bit % 8 + bit_count + 7) / 8;
     }
 
     std::string int_to_str_leading_zeros(int value, size_t length) const;
@@ -457,35 +1216,336 @@ private:
     void copy_from(const protocol_serializer& other);
     void move_from(protocol_serializer&& other);
 
-    static void shift_left (byte_ptr_t buf, int len, unsigned char shift);
-    static void shift_right(byte_ptr_t buf, int len, unsigned char shift);
+    protocol_layout& edit_layout();
+    static const std::shared_ptr<protocol_layout>& get_empty_layout();
 
-    static const std::unordered_map<unsigned char, unsigned char>& get_right_masks();
-    static const std::unordered_map<unsigned char, unsigned char>& get_left_masks();
+    static const unsigned char* get_right_masks();
+    static const unsigned char* get_left_masks();
     static const std::vector<std::string>& get_half_byte_binary();
 
-    void reallocate_internal_buffer();
-    void update_internal_buffer();
-
-    void set_result(result_code* result_ptr, const result_code code) const;
+    result_code  check_field_init(const field_init& init, const size_t index, const std::vector<field_init>* pending_fields = nullptr,
+                                  const fields_indices_t* pending_indices = nullptr) const;
+    unsigned int get_required_buffer_length() const;
+    unsigned int get_protocol_bit_count() const;
+    uint64_t     get_preserved_bit_count() const;
+    void         reserve_internal_buffer(const unsigned int capacity, const bool preserve_values);
+    void         reallocate_internal_buffer();
+    void         update_internal_buffer();
+    void         update_appended_internal_buffer(const unsigned int first_appended_bit);
+    void         set_internal_buffer_length(const unsigned int length);
+    void         update_available_fields();
+    unsigned int get_working_buffer_length() const;
+
+    static void set_result(result_code* result_ptr, const result_code code);
 
     internal_buffer_ptr_t m_internal_buffer;
     unsigned int          m_internal_buffer_length = 0;
+    unsigned int          m_internal_buffer_capacity = 0; // Internal buffer only grows, so appending fields is amortized O(1)
     byte_ptr_t            m_external_buffer = nullptr;
+    size_t                m_external_buffer_length = SIZE_MAX; // Unknown unless set along with the buffer
+    size_t                m_available_fields_count = 0;        // Leading fields which fit into working buffer
     byte_ptr_t            m_working_buffer = nullptr;
     buffer_source         m_buffer_source;
 
-    using metadata_const_itt = fields_metadata_t::const_iterator;
-    mutable byte_ptr_t         m_prealloc_final_bytes = nullptr;
-    mutable uint64_t           m_prealloc_val = 0;
-    mutable byte_ptr_t         m_prealloc_ptr_to_first_copyable_msb = nullptr; //msb - "Most significant byte"
-    mutable unsigned char      m_prealloc_raw_bytes[65] = "";
-    mutable unsigned char      m_prealloc_msb = 0;
-    mutable metadata_const_itt m_prealloc_metadata_itt;
-
-    fields_list_t     m_fields;
-    fields_metadata_t m_fields_metadata;
-    bool              m_is_little_endian;
+    std::shared_ptr<protocol_layout> m_layout = get_empty_layout();
+    bool                             m_is_little_endian;
+
+    // Metadata of fields from the first variable-length one, resolved against working buffer by invalidate_offsets()
+    fields_metadata_t m_resolved_metadata;
+    uint64_t          m_required_bit_count = 0; // Length of the protocol with resolved variable-length fields
+
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    std::unique_ptr<detail::stats_sink> m_stats{new detail::stats_sink}; // Copies start with own counters
+#endif
+};
+
+namespace detail {
+
+// Fields [first_field, first_field + fields_count) which are cut out of bytes_count bytes starting at first_byte_ind.
+// Window of 9 bytes holds a single unaligned 64-bit field
+struct field_window
+{
+    unsigned int first_byte_ind;
+    unsigned int bytes_count;
+    unsigned int first_field;
+    unsigned int fields_count;
+    uint64_t     fields_mask; // Bits of window which belong to its fields, zero for windows longer than 8 bytes
+};
+
+// Groups fields sorted by offset into windows of up to 8 bytes (used by record_plan, projection and struct_binding):
+// a window grows while its fields fit into 8 bytes, so it is loaded and stored once.
+// windows needs room for count windows, shifts[i] receives shift of i-th field inside of its window. Returns windows count
+inline size_t group_into_windows(const protocol_serializer::field_metadata* const* fields, const size_t count, field_window* windows, unsigned int* shifts)
+{
+    size_t windows_count = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const protocol_serializer::field_metadata& field = *fields[i];
+        const unsigned int last_byte_ind = field.first_byte_ind + field.touched_bytes_count - 1;
+        field_window* current = windows_count ? &windows[windows_count - 1] : nullptr;
+        if (current == nullptr || current->bytes_count > 8 || field.touched_bytes_count > 8 || last_byte_ind - current->first_byte_ind >= 8) {
+            current = &windows[windows_count++];
+            *current = field_window{field.first_byte_ind, 0, static_cast<unsigned int>(i), 0, 0};
+        }
+        if (last_byte_ind - current->first_byte_ind + 1 > current->bytes_count)
+            current->bytes_count = last_byte_ind - current->first_byte_ind + 1;
+        ++current->fields_count;
+    }
+
+    // Shift of a field is known once its window is complete
+    for (size_t w = 0; w < windows_count; ++w) {
+        field_window& current = windows[w];
+        for (unsigned int i = current.first_field; i < current.first_field + current.fields_count; ++i) {
+            const protocol_serializer::field_metadata& field = *fields[i];
+            shifts[i] = (current.first_byte_ind + current.bytes_count) * 8 - (field.first_bit_ind + field.bit_count);
+            if (current.bytes_count <= 8)
+                current.fields_mask |= low_bits_mask(field.bit_count) << shifts[i];
+        }
+    }
+    return windows_count;
+}
+
+}
+
+// Non-owning view of a single message: layout of its protocol, byte order and the bytes of the message.
+// View never allocates and is trivially copyable, so it can be created on the stack for every packet
+// and any number of views may read/write different packets concurrently.
+// View does not own the layout: keep a pointer returned by protocol_serializer::get_layout() while views are used,
+// which also prevents serializer from modifying the layout in place.
+// Fields which are not entirely inside [buffer, buffer + length) can not be accessed, neither can fields
+// without fixed offsets (variable-length ones and fields after them, see protocol_serializer::field_init).
+template<class Byte>
+class basic_message_view
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using field_handle = protocol_serializer::field_handle;
+    using field_metadata = protocol_serializer::field_metadata;
+    using protocol_layout = protocol_serializer::protocol_layout;
+
+    basic_message_view() = default;
+    basic_message_view(const protocol_layout& layout, Byte* const buffer, const size_t length, const bool is_little_endian = false) :
+        m_layout(&layout), m_buffer(buffer), m_length(length), m_is_little_endian(is_little_endian)
+    {
+    }
+
+    const protocol_layout* get_layout() const { return m_layout; }
+    Byte*                  get_buffer() const { return m_buffer; }
+    size_t                 get_length() const { return m_length; }
+    bool                   get_is_little_endian() const { return m_is_little_endian; }
+
+    field_handle get_field_handle(const std::string& name, result_code* result = nullptr) const
+    {
+        if (m_layout == nullptr) {
+            protocol_serializer::set_result(result, result_code::field_not_found);
+            return field_handle();
+        }
+        return m_layout->get_field_handle(name, result);
+    }
+
+    // Reading/writing (same semantics as in protocol_serializer)
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write(const std::string& name, const T& value) const
+    {
+        return _write(find_metadata(name), value);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write(const field_handle& handle, const T& value) const
+    {
+        return _write(find_metadata(handle), value);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    result_code write_ghost(const unsigned int field_first_bit, const unsigned int field_bit_count, const T& value) const
+    {
+        const field_metadata metadata(field_first_bit, field_bit_count);
+        return _write(&metadata, value);
+    }
+
+    template<class Array>
+    result_code write_array(const std::string& name, Array& array, const size_t size) const
+    {
+        return _write_array(find_metadata(name), array, size);
+    }
+
+    template<class Array>
+    result_code write_array(const field_handle& handle, Array& array, const size_t size) const
+    {
+        return _write_array(find_metadata(handle), array, size);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    T read(const std::string& name, result_code* result = nullptr) const
+    {
+        return _read<T>(find_metadata(name), result);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    T read(const field_handle& handle, result_code* result = nullptr) const
+    {
+        return _read<T>(find_metadata(handle), result);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    T read_ghost(const unsigned int field_first_bit, const unsigned int field_bit_count, result_code* result = nullptr) const
+    {
+        const field_metadata metadata(field_first_bit, field_bit_count);
+        return _read<T>(&metadata, result);
+    }
+
+    template<class Array>
+    void read_array(const std::string& name, Array& array, const size_t size, result_code* result = nullptr) const
+    {
+        _read_array(find_metadata(name), array, size, result);
+    }
+
+    template<class Array>
+    void read_array(const field_handle& handle, Array& array, const size_t size, result_code* result = nullptr) const
+    {
+        _read_array(find_metadata(handle), array, size, result);
+    }
+
+    // Fields of any width as bytes (see protocol_serializer::read_bytes())
+    template<class Key>
+    result_code read_bytes(const Key& key, unsigned char* bytes, const size_t length) const
+    {
+        const field_metadata* metadata = find_metadata(key);
+        const result_code check_result = check_access(metadata);
+        if (check_result != result_code::ok)
+            return check_result;
+
+        return protocol_serializer::_read_bytes(m_buffer, m_is_little_endian, *metadata, bytes, length);
+    }
+
+    template<class Key>
+    result_code write_bytes(const Key& key, const unsigned char* bytes, const size_t length) const
+    {
+        static_assert(!std::is_const<Byte>::value, "Read-only view can not be written");
+        const field_metadata* metadata = find_metadata(key);
+        const result_code check_result = check_access(metadata);
+        if (check_result != result_code::ok)
+            return check_result;
+
+        return protocol_serializer::_write_bytes(m_buffer, m_is_little_endian, *metadata, bytes, length);
+    }
+
+#ifdef EZ_PROTOCOL_SERIALIZER_INT128
+    template<class Key>
+    uint128_t read_uint128(const Key& key, result_code* result = nullptr) const
+    {
+        const field_metadata* metadata = find_metadata(key);
+        const result_code check_result = check_access(metadata);
+        if (check_result != result_code::ok) {
+            protocol_serializer::set_result(result, check_result);
+            return 0;
+        }
+
+        return protocol_serializer::_read_uint128(m_buffer, m_is_little_endian, *metadata, result);
+    }
+
+    template<class Key>
+    result_code write_uint128(const Key& key, const uint128_t value) const
+    {
+        static_assert(!std::is_const<Byte>::value, "Read-only view can not be written");
+        const field_metadata* metadata = find_metadata(key);
+        const result_code check_result = check_access(metadata);
+        if (check_result != result_code::ok)
+            return check_result;
+
+        return protocol_serializer::_write_uint128(m_buffer, m_is_little_endian, *metadata, value);
+    }
+#endif
+
+private:
+    const field_metadata* find_metadata(const std::string& name) const
+    {
+        return m_layout != nullptr ? m_layout->find_metadata(name) : nullptr;
+    }
+
+    const field_metadata* find_metadata(const field_handle& handle) const
+    {
+        return m_layout != nullptr ? m_layout->find_metadata(handle) : nullptr;
+    }
+
+    bool contains(const field_metadata& metadata) const
+    {
+        return metadata.first_bit_ind + uint64_t(metadata.bit_count) <= uint64_t(m_length) * 8;
+    }
+
+    result_code check_access(const field_metadata* metadata) const
+    {
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        return contains(*metadata) ? result_code::ok : result_code::buffer_too_short;
+    }
+
+    template<class T>
+    result_code _write(const field_metadata* metadata, const T& value) const
+    {
+        static_assert(!std::is_const<Byte>::value, "Read-only view can not be written");
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        if (!contains(*metadata))
+            return result_code::buffer_too_short;
+
+        return protocol_serializer::_write(m_buffer, m_is_little_endian, *metadata, value);
+    }
+
+    template<class Array>
+    result_code _write_array(const field_metadata* metadata, Array& array, const size_t size) const
+    {
+        static_assert(!std::is_const<Byte>::value, "Read-only view can not be written");
+        if (size == 0)
+            return result_code::bad_input;
+
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        if (!contains(*metadata))
+            return result_code::buffer_too_short;
+
+        return protocol_serializer::_write_uniform_array(m_buffer, m_is_little_endian, metadata->first_bit_ind, metadata->bit_count, array, size);
+    }
+
+    template<class T>
+    T _read(const field_metadata* metadata, result_code* result) const
+    {
+        if (metadata == nullptr) {
+            protocol_serializer::set_result(result, result_code::field_not_found);
+            return T{};
+        }
+
+        if (!contains(*metadata)) {
+            protocol_serializer::set_result(result, result_code::buffer_too_short);
+            return T{};
+        }
+
+        return protocol_serializer::_read<T>(m_buffer, m_is_little_endian, *metadata, result);
+    }
+
+    template<class Array>
+    void _read_array(const field_metadata* metadata, Array& array, const size_t size, result_code* result) const
+    {
+        using ElementType = typename std::decay<decltype(std::declval<Array>()[0])>::type;
+        if (metadata == nullptr) {
+            protocol_serializer::set_result(result, result_code::field_not_found);
+            return;
+        }
+
+        if (!contains(*metadata)) {
+            protocol_serializer::set_result(result, result_code::buffer_too_short);
+            return;
+        }
+
+        protocol_serializer::_read_uniform_array<Array, ElementType>(m_buffer, m_is_little_endian, metadata->first_bit_ind, metadata->bit_count, array, size, result);
+    }
+
+    const protocol_layout* m_layout = nullptr;
+    Byte*                  m_buffer = nullptr;
+    size_t                 m_length = 0;
+    bool                   m_is_little_endian = false;
 };
 
 }
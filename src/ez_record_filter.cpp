@@ -0,0 +1,177 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ez_record_filter.h>
+#include <algorithm>
+
+using ez::record_filter;
+using ez::record_predicate;
+
+record_filter::record_filter(const protocol_serializer& ps)
+    : record_filter(ps.get_layout(), ps.get_is_little_endian())
+{
+}
+
+record_filter::record_filter(const layout_ptr_t& layout, const bool is_little_endian)
+    : m_layout(layout)
+    , m_is_little_endian(is_little_endian)
+{
+}
+
+ez::protocol_serializer::result_code record_filter::set_predicate(const record_predicate& predicate)
+{
+    std::vector<plan_column> columns;
+    std::vector<plan_step> steps;
+    unsigned int depth = 0;
+    unsigned int max_depth = 0;
+
+    for (const record_predicate::step& s : predicate.get_steps()) {
+        if (s.op == record_predicate::operation::logical_and || s.op == record_predicate::operation::logical_or) {
+            if (depth < 2)
+                return result_code::bad_input;
+            --depth;
+            steps.push_back(plan_step{s.op, 0, 0, 0});
+            continue;
+        }
+
+        const protocol_serializer::field_metadata* metadata = m_layout->find_metadata(s.field);
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        if (metadata->vis_type == protocol_serializer::visualization_type::floating_point)
+            return result_code::not_applicable;
+
+        const result_code validation_result = protocol_serializer::validate_access<uint64_t>(m_is_little_endian, metadata->bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
+
+        // Field is extracted once per block however many leaves refer to it
+        const auto same_field = [metadata](const plan_column& c) { return c.metadata.first_bit_ind == metadata->first_bit_ind; };
+        const size_t column_index = std::find_if(columns.begin(), columns.end(), same_field) - columns.begin();
+        if (column_index == columns.size())
+            columns.push_back(plan_column{*metadata, metadata->vis_type == protocol_serializer::visualization_type::signed_integer});
+
+        plan_step step{s.op, static_cast<unsigned int>(column_index), s.first, s.second};
+        if (s.op == record_predicate::operation::in_range && columns[column_index].is_signed) {
+            // Flipping sign bit maps int64_t order onto uint64_t order
+            step.first ^= uint64_t(1) << 63;
+            step.second ^= uint64_t(1) << 63;
+        }
+        steps.push_back(step);
+        max_depth = std::max(max_depth, ++depth);
+    }
+
+    if (depth != 1)
+        return result_code::bad_input;
+
+    m_columns.swap(columns);
+    m_steps.swap(steps);
+    m_stack_depth = max_depth;
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code record_filter::select(const unsigned char* records, const size_t record_stride, const uint64_t records_count,
+                                                           std::vector<uint64_t>& selection) const
+{
+    if (m_steps.empty())
+        return result_code::not_applicable;
+
+    if (records_count == 0)
+        return result_code::ok;
+
+    if (records == nullptr)
+        return result_code::bad_input;
+
+    const size_t block_length = detail::array_chunk_length;
+    std::vector<uint64_t> values(m_columns.size() * block_length);
+    std::vector<unsigned char> masks(m_stack_depth * block_length);
+
+    for (uint64_t first_record = 0; first_record < records_count; first_record += block_length) {
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(block_length, records_count - first_record));
+        const unsigned char* block = records + first_record * record_stride;
+
+        // Signed fields are sign-extended, so that their values are compared as int64_t
+        for (size_t c = 0; c < m_columns.size(); ++c) {
+            const protocol_serializer::field_metadata& metadata = m_columns[c].metadata;
+            uint64_t* column = values.data() + c * block_length;
+            if (m_columns[c].is_signed) {
+                detail::read_column(block + metadata.first_byte_ind, record_stride, count, metadata.touched_bytes_count, metadata.right_spacing,
+                                    metadata.bit_count, metadata.bytes_count, m_is_little_endian, reinterpret_cast<int64_t*>(column));
+            }
+            else {
+                detail::read_column(block + metadata.first_byte_ind, record_stride, count, metadata.touched_bytes_count, metadata.right_spacing,
+                                    metadata.bit_count, metadata.bytes_count, m_is_little_endian, column);
+            }
+        }
+
+        // Postfix program over a stack of per-record masks
+        unsigned char* top = nullptr;
+        size_t level = 0;
+        for (const plan_step& s : m_steps) {
+            const uint64_t* v = values.data() + s.column_index * block_length;
+            const uint64_t first = s.first;
+            const uint64_t second = s.second;
+            switch (s.op) {
+            case record_predicate::operation::equal:
+                top = masks.data() + level++ * block_length;
+                for (size_t i = 0; i < count; ++i)
+                    top[i] = v[i] == first;
+                break;
+            case record_predicate::operation::in_range: {
+                top = masks.data() + level++ * block_length;
+                const uint64_t bias = m_columns[s.column_index].is_signed ? uint64_t(1) << 63 : 0;
+                for (size_t i = 0; i < count; ++i)
+                    top[i] = ((v[i] ^ bias) >= first) & ((v[i] ^ bias) <= second);
+                break;
+            }
+            case record_predicate::operation::any_bits:
+                top = masks.data() + level++ * block_length;
+                for (size_t i = 0; i < count; ++i)
+                    top[i] = (v[i] & first) != 0;
+                break;
+            case record_predicate::operation::all_bits:
+                top = masks.data() + level++ * block_length;
+                for (size_t i = 0; i < count; ++i)
+                    top[i] = (v[i] & first) == first;
+                break;
+            case record_predicate::operation::logical_and:
+                top = masks.data() + (--level - 1) * block_length;
+                for (size_t i = 0; i < count; ++i)
+                    top[i] &= top[i + block_length];
+                break;
+            case record_predicate::operation::logical_or:
+                top = masks.data() + (--level - 1) * block_length;
+                for (size_t i = 0; i < count; ++i)
+                    top[i] |= top[i + block_length];
+                break;
+            }
+        }
+
+        // Every index is written, but only matching ones are kept
+        size_t selected_count = selection.size();
+        selection.resize(selected_count + count);
+        for (size_t i = 0; i < count; ++i) {
+            selection[selected_count] = first_record + i;
+            selected_count += top[i];
+        }
+        selection.resize(selected_count);
+    }
+
+    return result_code::ok;
+}
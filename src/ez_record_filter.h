@@ -0,0 +1,151 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_RECORD_FILTER
+#define EZ_RECORD_FILTER
+
+#include <ez_protocol_serializer.h>
+
+namespace ez {
+
+// Condition on integer fields of a record: equality, inclusive range and bit mask tests combined with && and ||.
+// Values are compared the way fields are read: signed_integer fields as int64_t, other fields as uint64_t.
+class record_predicate
+{
+public:
+    enum class operation
+    {
+        equal,
+        in_range,
+        any_bits,
+        all_bits,
+        logical_and,
+        logical_or
+    };
+
+    // Single step of postfix program: leaf pushes its result, logical operation combines two top results
+    struct step
+    {
+        operation   op;
+        std::string field;
+        uint64_t    first;
+        uint64_t    second;
+    };
+
+    template<class T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    static record_predicate equal(const std::string& field, const T value)
+    {
+        return leaf(operation::equal, field, static_cast<uint64_t>(value), 0);
+    }
+
+    template<class T, typename = typename std::enable_if<std::is_integral<T>::value>::type>
+    static record_predicate in_range(const std::string& field, const T min, const T max)
+    {
+        return leaf(operation::in_range, field, static_cast<uint64_t>(min), static_cast<uint64_t>(max));
+    }
+
+    // (value & mask) != 0
+    static record_predicate any_bits(const std::string& field, const uint64_t mask)
+    {
+        return leaf(operation::any_bits, field, mask, 0);
+    }
+
+    // (value & mask) == mask
+    static record_predicate all_bits(const std::string& field, const uint64_t mask)
+    {
+        return leaf(operation::all_bits, field, mask, 0);
+    }
+
+    friend record_predicate operator&&(const record_predicate& left, const record_predicate& right)
+    {
+        return combine(operation::logical_and, left, right);
+    }
+
+    friend record_predicate operator||(const record_predicate& left, const record_predicate& right)
+    {
+        return combine(operation::logical_or, left, right);
+    }
+
+    const std::vector<step>& get_steps() const { return m_steps; }
+
+private:
+    static record_predicate leaf(const operation op, const std::string& field, const uint64_t first, const uint64_t second)
+    {
+        record_predicate predicate;
+        predicate.m_steps.push_back(step{op, field, first, second});
+        return predicate;
+    }
+
+    static record_predicate combine(const operation op, const record_predicate& left, const record_predicate& right)
+    {
+        record_predicate predicate = left;
+        predicate.m_steps.insert(predicate.m_steps.end(), right.m_steps.begin(), right.m_steps.end());
+        predicate.m_steps.push_back(step{op, std::string(), 0, 0});
+        return predicate;
+    }
+
+    std::vector<step> m_steps;
+};
+
+// Selects records which satisfy a predicate. Predicate is compiled once: fields are resolved, every field is extracted
+// only once per record however many times predicate refers to it and other fields are not touched at all.
+// Records are processed in blocks: needed fields of a block are extracted into columns and every comparison
+// is a branch-free loop over a column, which compilers vectorize.
+class record_filter
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+
+    explicit record_filter(const protocol_serializer& ps);
+    record_filter(const layout_ptr_t& layout, const bool is_little_endian = false);
+
+    // Fails with field_not_found/not_applicable (floating point or too long field) if predicate can not be evaluated
+    result_code set_predicate(const record_predicate& predicate);
+
+    // Appends indices of matching records to selection. Records are record_stride bytes apart starting at records
+    result_code select(const unsigned char* records, const size_t record_stride, const uint64_t records_count, std::vector<uint64_t>& selection) const;
+
+private:
+    // Field values extracted from a block of records
+    struct plan_column
+    {
+        protocol_serializer::field_metadata metadata;
+        bool                                is_signed;
+    };
+
+    // Leaf compares values of column, range and equality tests are done on values biased so that unsigned comparison works for signed fields
+    struct plan_step
+    {
+        record_predicate::operation op;
+        unsigned int                column_index;
+        uint64_t                    first;
+        uint64_t                    second;
+    };
+
+    layout_ptr_t             m_layout;
+    bool                     m_is_little_endian;
+    std::vector<plan_column> m_columns;
+    std::vector<plan_step>   m_steps;
+    unsigned int             m_stack_depth = 0;
+};
+
+}
+
+#endif // EZ_RECORD_FILTER
@@ -0,0 +1,159 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_RECORD_FRAMER
+#define EZ_RECORD_FRAMER
+
+#include <ez_protocol_serializer.h>
+#include <algorithm>
+
+namespace ez {
+
+// Splits a byte stream of back-to-back records of one protocol, which arrives in chunks of arbitrary size, into records.
+// Records which lie entirely inside of a chunk are handed out as views of the chunk itself, only records
+// which straddle chunk boundary are stitched together in a small buffer of the framer.
+// Optionally every record has to start with a sync word (value of one of protocol fields). Once it does not,
+// framer drops bytes one by one until it finds the sync word again.
+class record_framer
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+
+    explicit record_framer(const protocol_serializer& ps) :
+        record_framer(ps.get_layout(), ps.get_is_little_endian())
+    {
+    }
+
+    record_framer(const layout_ptr_t& layout, const bool is_little_endian = false) :
+        m_layout(layout), m_is_little_endian(is_little_endian)
+    {
+        // Records are byte-aligned, so every record takes whole number of bytes
+        if (!m_layout->fields_metadata.empty()) {
+            const protocol_serializer::field_metadata& last_field = m_layout->fields_metadata.back();
+            const unsigned int bit_count = last_field.first_bit_ind + last_field.bit_count;
+            m_record_length = bit_count / 8 + ((bit_count % 8) ? 1 : 0);
+        }
+        m_pending.resize(m_record_length);
+    }
+
+    // Only records which hold value in field name are handed out
+    result_code set_sync_word(const std::string& name, const uint64_t value)
+    {
+        const protocol_serializer::field_metadata* metadata = m_layout->find_metadata(name);
+        if (metadata == nullptr)
+            return result_code::field_not_found;
+
+        const result_code validation_result = protocol_serializer::validate_access<uint64_t>(m_is_little_endian, metadata->bit_count);
+        if (validation_result != result_code::ok)
+            return validation_result;
+
+        // Sync word is compared in the form it is stored in, so records are never decoded while searching for it
+        m_sync_field = *metadata;
+        m_sync_raw = detail::encode_value(value, metadata->bytes_count, m_is_little_endian) & detail::low_bits_mask(metadata->bit_count);
+        m_has_sync_word = true;
+        return result_code::ok;
+    }
+
+    void clear_sync_word()
+    {
+        m_has_sync_word = false;
+    }
+
+    // Calls on_record(const const_message_view&) for every complete record. View of a stitched record
+    // points into the framer and is only valid until on_record returns. Incomplete tail of the chunk is kept till next push().
+    template<class Callback>
+    void push(const unsigned char* chunk, const size_t length, Callback&& on_record)
+    {
+        if (m_record_length == 0)
+            return;
+
+        size_t position = 0;
+
+        // Complete a record which straddles chunk boundary
+        while (m_pending_length != 0) {
+            const size_t taken_length = std::min(m_record_length - m_pending_length, length - position);
+            memcpy(m_pending.data() + m_pending_length, chunk + position, taken_length);
+            if (m_pending_length + taken_length < m_record_length) {
+                m_pending_length += taken_length;
+                return;
+            }
+
+            if (is_synchronized(m_pending.data())) {
+                position += taken_length;
+                m_pending_length = 0;
+                on_record(const_message_view(*m_layout, m_pending.data(), m_record_length, m_is_little_endian));
+                break;
+            }
+
+            // Drop first byte and give taken bytes back to the chunk, they are going to be checked again
+            memmove(m_pending.data(), m_pending.data() + 1, --m_pending_length);
+            ++m_skipped_bytes_count;
+        }
+
+        // Records inside of the chunk are not copied
+        while (length - position >= m_record_length) {
+            if (!is_synchronized(chunk + position)) {
+                ++position;
+                ++m_skipped_bytes_count;
+                continue;
+            }
+
+            on_record(const_message_view(*m_layout, chunk + position, m_record_length, m_is_little_endian));
+            position += m_record_length;
+        }
+
+        m_pending_length = length - position;
+        memcpy(m_pending.data(), chunk + position, m_pending_length);
+    }
+
+    // Drops incomplete record (e.g. after a gap in the stream)
+    void reset()
+    {
+        m_pending_length = 0;
+    }
+
+    size_t   get_record_length() const { return m_record_length; }
+    size_t   get_pending_length() const { return m_pending_length; }
+    uint64_t get_skipped_bytes_count() const { return m_skipped_bytes_count; }
+
+private:
+    bool is_synchronized(const unsigned char* record) const
+    {
+        if (!m_has_sync_word)
+            return true;
+
+        return detail::extract_bits(record + m_sync_field.first_byte_ind, m_sync_field.touched_bytes_count,
+                                    m_sync_field.right_spacing, m_sync_field.bit_count) == m_sync_raw;
+    }
+
+    layout_ptr_t                        m_layout;
+    bool                                m_is_little_endian;
+    size_t                              m_record_length = 0;
+    std::vector<unsigned char>          m_pending;        // Beginning of a record which straddles chunk boundary
+    size_t                              m_pending_length = 0;
+    uint64_t                            m_skipped_bytes_count = 0;
+    bool                                m_has_sync_word = false;
+    protocol_serializer::field_metadata m_sync_field = protocol_serializer::field_metadata(0, 0);
+    uint64_t                            m_sync_raw = 0;
+};
+
+}
+
+#endif // EZ_RECORD_FRAMER
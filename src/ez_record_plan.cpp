@@ -0,0 +1,127 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ez_record_plan.h>
+#include <algorithm>
+
+using ez::record_plan;
+
+record_plan::record_plan(const protocol_serializer& ps)
+    : record_plan(ps.get_layout(), ps.get_is_little_endian())
+{
+}
+
+record_plan::record_plan(const layout_ptr_t& layout, const bool is_little_endian)
+    : m_layout(layout)
+    , m_is_little_endian(is_little_endian)
+{
+    const protocol_serializer::fields_metadata_t& fields = m_layout->fields_metadata;
+    if (!fields.empty()) {
+        const unsigned int bit_count = fields.back().first_bit_ind + fields.back().bit_count;
+        m_record_length = bit_count / 8 + ((bit_count % 8) ? 1 : 0);
+    }
+
+    // Fields from the first variable-length one on have no fixed offsets and are skipped
+    std::vector<const protocol_serializer::field_metadata*> planned_fields;
+    for (unsigned int i = 0; i < m_layout->get_fixed_fields_count(); ++i) {
+        const protocol_serializer::field_metadata& field = fields[i];
+        if (protocol_serializer::validate_access<uint64_t>(m_is_little_endian, field.bit_count) != result_code::ok)
+            continue;
+
+        const bool is_floating_point = field.vis_type == protocol_serializer::visualization_type::floating_point;
+        plan_field planned;
+        planned.field_index = i;
+        planned.shift = 0;
+        planned.bytes_count = field.bytes_count;
+        planned.mask = detail::low_bits_mask(field.bit_count);
+        planned.sign_bit = !is_floating_point && field.vis_type == protocol_serializer::visualization_type::signed_integer && field.bit_count < 64
+            ? uint64_t(1) << (field.bit_count - 1) : 0;
+        planned.is_reversed = is_floating_point ? detail::is_host_little_endian() : m_is_little_endian && field.bytes_count > 1;
+        m_fields.push_back(planned);
+        planned_fields.push_back(&field);
+    }
+
+    std::vector<unsigned int> shifts(m_fields.size());
+    m_windows.resize(m_fields.size());
+    m_windows.resize(detail::group_into_windows(planned_fields.data(), planned_fields.size(), m_windows.data(), shifts.data()));
+    for (size_t i = 0; i < m_fields.size(); ++i)
+        m_fields[i].shift = shifts[i];
+}
+
+ez::protocol_serializer::result_code record_plan::decode(const unsigned char* record, const size_t length, uint64_t* values) const
+{
+    if (record == nullptr || (values == nullptr && !m_fields.empty()))
+        return result_code::bad_input;
+
+    if (length < m_record_length)
+        return result_code::buffer_too_short;
+
+    // Skipped fields keep zero
+    if (m_fields.size() != get_fields_count())
+        std::fill(values, values + get_fields_count(), 0);
+
+    for (const window& current : m_windows) {
+        const unsigned char* ptr = record + current.first_byte_ind;
+        const plan_field* first = m_fields.data() + current.first_field;
+        const plan_field* last = first + current.fields_count;
+        const uint64_t word = current.bytes_count <= 8 ? detail::load_be(ptr, current.bytes_count) : 0;
+        for (const plan_field* f = first; f != last; ++f) {
+            uint64_t raw = (current.bytes_count <= 8 ? word >> f->shift : detail::extract_bits(ptr, current.bytes_count, f->shift, 64)) & f->mask;
+            if (f->is_reversed)
+                raw = detail::reverse_bytes(raw, f->bytes_count);
+            values[f->field_index] = (raw ^ f->sign_bit) - f->sign_bit;
+        }
+    }
+
+    return result_code::ok;
+}
+
+ez::protocol_serializer::result_code record_plan::encode(const uint64_t* values, unsigned char* record, const size_t length) const
+{
+    if (record == nullptr || (values == nullptr && !m_fields.empty()))
+        return result_code::bad_input;
+
+    if (length < m_record_length)
+        return result_code::buffer_too_short;
+
+    for (const window& current : m_windows) {
+        unsigned char* ptr = record + current.first_byte_ind;
+        const plan_field* first = m_fields.data() + current.first_field;
+        const plan_field* last = first + current.fields_count;
+        if (current.bytes_count > 8) {
+            const uint64_t raw = first->is_reversed ? detail::reverse_bytes(values[first->field_index], first->bytes_count) : values[first->field_index];
+            const protocol_serializer::field_metadata& field = m_layout->fields_metadata[first->field_index];
+            detail::insert_bits(ptr, current.bytes_count, field.left_spacing, field.right_spacing, field.bit_count, raw);
+            continue;
+        }
+
+        uint64_t word = 0;
+        for (const plan_field* f = first; f != last; ++f) {
+            const uint64_t raw = f->is_reversed ? detail::reverse_bytes(values[f->field_index], f->bytes_count) : values[f->field_index];
+            word |= (raw & f->mask) << f->shift;
+        }
+
+        // Bytes shared with neighbouring windows or skipped fields are merged, the others are simply stored
+        if (current.fields_mask != detail::low_bits_mask(current.bytes_count * 8))
+            word |= detail::load_be(ptr, current.bytes_count) & ~current.fields_mask;
+        detail::store_be(ptr, current.bytes_count, word);
+    }
+
+    return result_code::ok;
+}
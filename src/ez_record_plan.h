@@ -0,0 +1,74 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_RECORD_PLAN
+#define EZ_RECORD_PLAN
+
+#include <ez_protocol_serializer.h>
+
+namespace ez {
+
+// Whole-record decoding/encoding. Layout is compiled once into windows of up to 8 bytes: adjacent fields which fit
+// into a window (a run of byte-aligned fields as well as a run of sub-byte ones) are loaded with one load and stored
+// with one store, instead of a load and a store per field.
+// Values are kept as uint64_t per field: integers are converted as read<uint64_t>()/read<int64_t>() would convert them
+// (signed_integer fields are sign-extended), floating point values are bits of float/double.
+// Fields which read<uint64_t>() can not access (longer than 64 bits) are skipped: decoded as zero and left intact by encoding.
+// So are variable-length fields and fields after them.
+class record_plan
+{
+public:
+    using result_code = protocol_serializer::result_code;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+
+    explicit record_plan(const protocol_serializer& ps);
+    record_plan(const layout_ptr_t& layout, const bool is_little_endian = false);
+
+    // values has to have room for get_fields_count() values, record has to hold get_record_length() bytes
+    result_code decode(const unsigned char* record, const size_t length, uint64_t* values) const;
+    result_code encode(const uint64_t* values, unsigned char* record, const size_t length) const;
+
+    size_t get_fields_count() const { return m_layout->fields_metadata.size(); }
+    size_t get_record_length() const { return m_record_length; }
+    size_t get_windows_count() const { return m_windows.size(); }
+
+private:
+    // Fields of a window are a range of m_fields
+    using window = detail::field_window;
+
+    struct plan_field
+    {
+        unsigned int field_index;
+        unsigned int shift;
+        unsigned int bytes_count;
+        uint64_t     mask;
+        uint64_t     sign_bit;    // Zero unless value is sign-extended
+        bool         is_reversed;
+    };
+
+    layout_ptr_t            m_layout;
+    bool                    m_is_little_endian;
+    size_t                  m_record_length = 0;
+    std::vector<window>     m_windows;
+    std::vector<plan_field> m_fields;
+};
+
+}
+
+#endif // EZ_RECORD_PLAN
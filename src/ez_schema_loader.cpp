@@ -0,0 +1,391 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include <ez_schema_loader.h>
+#include <ez_mapped_file.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using ez::schema_loader;
+using ez::protocol_serializer;
+
+namespace {
+
+using protocol_layout = protocol_serializer::protocol_layout;
+using result_code = protocol_serializer::result_code;
+
+// Snapshot is the header followed by field metadata, variable-length fields and zero-terminated names, all in host format.
+// Header is a multiple of 8 bytes long, so tables which follow it are aligned in the mapping
+struct snapshot_header
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t metadata_size;
+    uint32_t flags;
+    uint32_t fields_count;
+    uint32_t variable_fields_count;
+    uint64_t names_length;
+    uint64_t source_hash;
+    uint64_t payload_hash;
+};
+
+const uint32_t snapshot_magic = 0x53505A45; // "EZPS" on little-endian hosts, so snapshots of hosts of other byte order are rejected
+const uint32_t snapshot_version = 1;
+const uint32_t snapshot_little_endian_flag = 1;
+
+// FNV-1a over 8-byte words (and bytes of the tail), which detects damage as well as the bytewise one at a fraction of its cost
+uint64_t hash_bytes(const unsigned char* data, const size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+    for (; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash ^ (hash >> 32);
+}
+
+// Snapshot metadata is not recomputed, but whatever bounds buffer accesses is checked against what field_metadata() would compute
+bool is_consistent_field(const protocol_serializer::field_metadata& field, const uint64_t first_bit_ind, const bool is_variable)
+{
+    using vt = protocol_serializer::visualization_type;
+    if (field.first_bit_ind != first_bit_ind || field.first_byte_ind != field.first_bit_ind / 8 || field.left_spacing != field.first_bit_ind % 8)
+        return false;
+
+    if (field.vis_type != vt::signed_integer && field.vis_type != vt::unsigned_integer && field.vis_type != vt::floating_point)
+        return false;
+
+    // Nominal width of a variable-length field is zero, its metadata is resolved against the buffer
+    if (is_variable || field.bit_count == 0)
+        return is_variable && field.bit_count == 0;
+
+    if (field.vis_type == vt::floating_point && field.bit_count != 32 && field.bit_count != 64)
+        return false;
+
+    const uint64_t touched_bytes_count = (uint64_t(field.left_spacing) + field.bit_count + 7) / 8;
+    return field.bytes_count == (uint64_t(field.bit_count) + 7) / 8 && field.touched_bytes_count == touched_bytes_count &&
+           field.right_spacing == (8 - (first_bit_ind + field.bit_count) % 8) % 8 && (field.bit_count > 64 || touched_bytes_count <= 9);
+}
+
+bool is_consistent_layout(const protocol_layout& layout)
+{
+    const std::vector<protocol_layout::variable_field>& variable_fields = layout.variable_fields;
+    const auto is_variable = [&variable_fields](const unsigned int field_ind) {
+        const auto found = std::lower_bound(variable_fields.cbegin(), variable_fields.cend(), field_ind,
+                                            [](const protocol_layout::variable_field& field, const unsigned int i) { return field.field_ind < i; });
+        return found != variable_fields.cend() && found->field_ind == field_ind;
+    };
+
+    for (size_t i = 0; i < variable_fields.size(); ++i) {
+        const protocol_layout::variable_field& field = variable_fields[i];
+        if ((i != 0 && field.field_ind <= variable_fields[i - 1].field_ind) || field.field_ind >= layout.fields_metadata.size())
+            return false;
+        if (field.length_field_ind >= field.field_ind || is_variable(field.length_field_ind) || field.unit_bit_count == 0 ||
+            layout.fields_metadata[field.length_field_ind].bit_count > 64)
+            return false;
+    }
+
+    uint64_t first_bit_ind = 0;
+    for (size_t i = 0; i < layout.fields_metadata.size(); ++i) {
+        const protocol_serializer::field_metadata& field = layout.fields_metadata[i];
+        if (!is_consistent_field(field, first_bit_ind, is_variable(static_cast<unsigned int>(i))))
+            return false;
+        first_bit_ind += field.bit_count;
+    }
+    return first_bit_ind <= UINT32_MAX;
+}
+
+bool read_file(const std::string& path, std::string& contents)
+{
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    contents.clear();
+    char chunk[4096];
+    size_t read_count;
+    while ((read_count = fread(chunk, 1, sizeof(chunk), file)) != 0)
+        contents.append(chunk, read_count);
+    const bool is_ok = ferror(file) == 0;
+    fclose(file);
+    return is_ok;
+}
+
+// Splits [begin, end) into words separated by spaces and tabs
+void split_words(const char* begin, const char* const end, std::vector<std::string>& words)
+{
+    words.clear();
+    while (begin != end) {
+        while (begin != end && (*begin == ' ' || *begin == '\t' || *begin == '\r'))
+            ++begin;
+        const char* word_end = begin;
+        while (word_end != end && *word_end != ' ' && *word_end != '\t' && *word_end != '\r')
+            ++word_end;
+        if (word_end != begin)
+            words.emplace_back(begin, word_end);
+        begin = word_end;
+    }
+}
+
+bool parse_bit_count(const std::string& word, unsigned int& bit_count)
+{
+    char* end = nullptr;
+    const unsigned long long value = strtoull(word.c_str(), &end, 10);
+    if (word.empty() || word[0] == '-' || *end != '\0' || value == 0 || value > UINT32_MAX)
+        return false;
+
+    bit_count = static_cast<unsigned int>(value);
+    return true;
+}
+
+}
+
+result_code schema_loader::parse(const std::string& text, protocol_serializer& ps)
+{
+    using vt = protocol_serializer::visualization_type;
+    m_error_line = 0;
+    m_used_snapshot = false;
+
+    bool is_little_endian = false;
+    std::vector<protocol_serializer::field_init> fields;
+    std::vector<size_t> fields_lines;
+    std::vector<std::string> words;
+    const char* line = text.data();
+    const char* const text_end = text.data() + text.size();
+    for (size_t line_num = 1; line != text_end; ++line_num) {
+        const char* line_end = static_cast<const char*>(memchr(line, '\n', static_cast<size_t>(text_end - line)));
+        const char* const next_line = line_end != nullptr ? line_end + 1 : text_end;
+        line_end = line_end != nullptr ? line_end : text_end;
+        const char* const comment = static_cast<const char*>(memchr(line, '#', static_cast<size_t>(line_end - line)));
+        split_words(line, comment != nullptr ? comment : line_end, words);
+        line = next_line;
+        if (words.empty())
+            continue;
+
+        result_code line_result = result_code::ok;
+        if (words[0] == "byte_order") {
+            if (words.size() == 2 && (words[1] == "little" || words[1] == "big"))
+                is_little_endian = words[1] == "little";
+            else
+                line_result = result_code::bad_input;
+        }
+        else {
+            protocol_serializer::field_init init = {words[0], 0, vt::unsigned_integer};
+            if (words.size() < 2 || words.size() > 4 || !parse_bit_count(words[1], init.bit_count))
+                line_result = result_code::bad_input;
+
+            for (size_t i = 2; i < words.size() && line_result == result_code::ok; ++i) {
+                if (words[i] == "unsigned")
+                    init.vis_type = vt::unsigned_integer;
+                else if (words[i] == "signed")
+                    init.vis_type = vt::signed_integer;
+                else if (words[i] == "float")
+                    init.vis_type = vt::floating_point;
+                else if (words[i].compare(0, 7, "length=") == 0 && words[i].size() > 7)
+                    init.length_field = words[i].substr(7);
+                else
+                    line_result = result_code::bad_input;
+            }
+
+            fields.push_back(std::move(init));
+            fields_lines.push_back(line_num);
+        }
+
+        if (line_result != result_code::ok) {
+            m_error_line = line_num;
+            return line_result;
+        }
+    }
+
+    // Fields are collected by a separate serializer, so failure leaves ps intact
+    protocol_serializer parsed(false, protocol_serializer::buffer_source::external);
+    const result_code append_result = parsed.append_fields(fields, false);
+    if (append_result == result_code::ok) {
+        adopt_layout(ps, parsed.m_layout, is_little_endian);
+        return result_code::ok;
+    }
+
+    // Fields are appended one by one only to find the invalid one
+    protocol_serializer located;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (located.append_field(fields[i], false) != result_code::ok) {
+            m_error_line = fields_lines[i];
+            break;
+        }
+    }
+    return append_result;
+}
+
+result_code schema_loader::load(const std::string& path, protocol_serializer& ps)
+{
+    std::string text;
+    if (!read_file(path, text)) {
+        m_error_line = 0;
+        m_used_snapshot = false;
+        return result_code::io_error;
+    }
+
+    return parse(text, ps);
+}
+
+result_code schema_loader::save_snapshot(const protocol_serializer& ps, const std::string& path, const uint64_t source_hash)
+{
+    // Groups refer to other layouts, which snapshot does not hold
+    const protocol_layout& layout = *ps.m_layout;
+    if (!layout.groups.empty())
+        return result_code::not_applicable;
+
+    std::string payload;
+    payload.append(reinterpret_cast<const char*>(layout.fields_metadata.data()), layout.fields_metadata.size() * sizeof(protocol_serializer::field_metadata));
+    payload.append(reinterpret_cast<const char*>(layout.variable_fields.data()), layout.variable_fields.size() * sizeof(protocol_layout::variable_field));
+    const size_t names_offset = payload.size();
+    for (const std::string& name : layout.fields) {
+        if (name.find('\0') != std::string::npos)
+            return result_code::bad_input;
+        payload.append(name.c_str(), name.size() + 1);
+    }
+
+    snapshot_header header;
+    header.magic = snapshot_magic;
+    header.version = snapshot_version;
+    header.metadata_size = sizeof(protocol_serializer::field_metadata);
+    header.flags = ps.get_is_little_endian() ? snapshot_little_endian_flag : 0;
+    header.fields_count = static_cast<uint32_t>(layout.fields.size());
+    header.variable_fields_count = static_cast<uint32_t>(layout.variable_fields.size());
+    header.names_length = payload.size() - names_offset;
+    header.source_hash = source_hash;
+    header.payload_hash = hash_bytes(reinterpret_cast<const unsigned char*>(payload.data()), payload.size());
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return result_code::io_error;
+
+    const bool is_written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(payload.data(), 1, payload.size(), file) == payload.size();
+    return fclose(file) == 0 && is_written ? result_code::ok : result_code::io_error;
+}
+
+// Snapshots are checked for corruption and truncation, metadata is copied without being recomputed and only checked for consistency
+result_code schema_loader::load_snapshot(const std::string& path, protocol_serializer& ps, const uint64_t source_hash)
+{
+    using field_metadata = protocol_serializer::field_metadata;
+    m_error_line = 0;
+    m_used_snapshot = false;
+
+    ez::detail::mapped_file file;
+    const result_code open_result = file.open(path);
+    if (open_result != result_code::ok)
+        return open_result;
+
+    snapshot_header header;
+    if (file.get_length() < sizeof(header))
+        return result_code::bad_input;
+    memcpy(&header, file.get_data(), sizeof(header));
+    if (header.magic != snapshot_magic || header.version != snapshot_version || header.metadata_size != sizeof(field_metadata))
+        return result_code::bad_input;
+
+    if (source_hash != 0 && header.source_hash != source_hash)
+        return result_code::not_applicable;
+
+    const uint64_t metadata_length = uint64_t(header.fields_count) * sizeof(field_metadata);
+    const uint64_t variable_fields_length = uint64_t(header.variable_fields_count) * sizeof(protocol_layout::variable_field);
+    const unsigned char* payload = file.get_data() + sizeof(header);
+    const uint64_t payload_length = file.get_length() - sizeof(header);
+    if (header.names_length > payload_length || metadata_length + variable_fields_length != payload_length - header.names_length ||
+        hash_bytes(payload, static_cast<size_t>(payload_length)) != header.payload_hash)
+        return result_code::bad_input;
+
+    const std::shared_ptr<protocol_layout> layout = std::make_shared<protocol_layout>();
+    layout->fields_metadata.assign(header.fields_count, field_metadata(0, 0));
+    if (header.fields_count != 0)
+        memcpy(layout->fields_metadata.data(), payload, static_cast<size_t>(metadata_length));
+    layout->variable_fields.resize(header.variable_fields_count);
+    if (header.variable_fields_count != 0)
+        memcpy(layout->variable_fields.data(), payload + metadata_length, static_cast<size_t>(variable_fields_length));
+
+    const char* name = reinterpret_cast<const char*>(payload + metadata_length + variable_fields_length);
+    const char* const names_end = name + header.names_length;
+    layout->fields.reserve(header.fields_count);
+    layout->fields_indices.reserve(header.fields_count);
+    while (name != names_end) {
+        const char* const name_end = static_cast<const char*>(memchr(name, '\0', static_cast<size_t>(names_end - name)));
+        if (name_end == nullptr || layout->fields.size() == header.fields_count)
+            return result_code::bad_input;
+
+        layout->fields.emplace_back(name, name_end);
+        if (!layout->fields_indices.insert(protocol_serializer::fields_indices_t::value_type(layout->fields.back(), static_cast<unsigned int>(layout->fields.size() - 1))).second)
+            return result_code::bad_input;
+        name = name_end + 1;
+    }
+    if (layout->fields.size() != header.fields_count)
+        return result_code::bad_input;
+
+    if (!is_consistent_layout(*layout))
+        return result_code::bad_input;
+    for (const protocol_layout::variable_field& field : layout->variable_fields)
+        layout->length_fields_end = std::max(layout->length_fields_end, field.length_field_ind + 1);
+
+    adopt_layout(ps, layout, (header.flags & snapshot_little_endian_flag) != 0);
+    m_used_snapshot = true;
+    return result_code::ok;
+}
+
+result_code schema_loader::load_cached(const std::string& schema_path, const std::string& snapshot_path, protocol_serializer& ps)
+{
+    std::string text;
+    if (!read_file(schema_path, text)) {
+        m_error_line = 0;
+        m_used_snapshot = false;
+        return result_code::io_error;
+    }
+
+    const uint64_t source_hash = get_source_hash(text);
+    if (load_snapshot(snapshot_path, ps, source_hash) == result_code::ok)
+        return result_code::ok;
+
+    const result_code parse_result = parse(text, ps);
+    if (parse_result != result_code::ok)
+        return parse_result;
+
+    // Snapshot is only a cache, schema is loaded even if it can not be written
+    save_snapshot(ps, snapshot_path, source_hash);
+    return result_code::ok;
+}
+
+uint64_t schema_loader::get_source_hash(const std::string& text)
+{
+    // Zero means no hash
+    const uint64_t hash = hash_bytes(reinterpret_cast<const unsigned char*>(text.data()), text.size());
+    return hash != 0 ? hash : 1;
+}
+
+void schema_loader::adopt_layout(protocol_serializer& ps, const std::shared_ptr<protocol_serializer::protocol_layout>& layout, const bool is_little_endian)
+{
+    // Offsets are resolved only once buffer fits the new layout, set_is_little_endian() would resolve them against the old one
+    ps.m_layout = layout;
+    ps.m_is_little_endian = is_little_endian;
+    ps.reallocate_internal_buffer();
+}
@@ -0,0 +1,61 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_SCHEMA_LOADER
+#define EZ_SCHEMA_LOADER
+
+#include <ez_protocol_serializer.h>
+
+namespace ez {
+
+// Builds protocols from text schemas, one field or directive per line ('#' starts a comment):
+//   byte_order little|big
+//   <name> <bit_count> [unsigned|signed|float] [length=<length field>]
+// Computed layout may be saved as a binary snapshot. Loading it maps the file and copies field metadata as is,
+// so neither text is parsed nor metadata is computed. Snapshots are only meant for hosts of the same byte order and build.
+class schema_loader
+{
+public:
+    using result_code = protocol_serializer::result_code;
+
+    // Protocol of ps is replaced only if the whole schema is valid
+    result_code parse(const std::string& text, protocol_serializer& ps);
+    result_code load(const std::string& path, protocol_serializer& ps);
+
+    // Snapshot remembers source_hash, load_snapshot() fails with not_applicable unless it matches exactly (zero skips the check)
+    static result_code save_snapshot(const protocol_serializer& ps, const std::string& path, const uint64_t source_hash = 0);
+    result_code        load_snapshot(const std::string& path, protocol_serializer& ps, const uint64_t source_hash = 0);
+
+    // Loads schema through its snapshot, which is rebuilt whenever it is missing or was made of different text
+    result_code load_cached(const std::string& schema_path, const std::string& snapshot_path, protocol_serializer& ps);
+
+    static uint64_t get_source_hash(const std::string& text);
+    size_t          get_error_line() const { return m_error_line; } // First invalid line of the last parsed schema, 0 if none
+    bool            get_used_snapshot() const { return m_used_snapshot; }
+
+private:
+    static void adopt_layout(protocol_serializer& ps, const std::shared_ptr<protocol_serializer::protocol_layout>& layout, const bool is_little_endian);
+
+    size_t m_error_line = 0;
+    bool   m_used_snapshot = false;
+};
+
+}
+
+#endif // EZ_SCHEMA_LOADER
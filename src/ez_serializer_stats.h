@@ -0,0 +1,184 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_SERIALIZER_STATS
+#define EZ_SERIALIZER_STATS
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace ez {
+
+// Snapshot of protocol_serializer counters (see protocol_serializer::get_stats()).
+// Counters are only collected when EZ_PROTOCOL_SERIALIZER_STATS is defined for the whole program, otherwise snapshots are empty.
+struct serializer_stats
+{
+    struct counters
+    {
+        uint64_t reads = 0;            // Calls of read()/read_ghost()
+        uint64_t writes = 0;           // Calls of write()/write_ghost()
+        uint64_t batch_calls = 0;      // Calls of array and column reading/writing
+        uint64_t shifted_accesses = 0; // Fields which do not start and end on byte boundaries, so they are shifted and masked
+        uint64_t byte_swaps = 0;       // Little-endian integer fields longer than a byte
+        uint64_t sign_extensions = 0;  // Reads of signed values which are shorter than their type
+        uint64_t bytes_touched = 0;
+    };
+
+    struct field_stats
+    {
+        std::string name;
+        counters    values;
+    };
+
+    bool                     is_enabled = false;
+    counters                 total;             // All accesses including ghost ones
+    std::vector<field_stats> fields;            // Fields of current protocol in protocol order
+    uint64_t                 lookup_misses = 0; // Fields which were not found or are outside of external buffer
+    uint64_t                 reallocations = 0; // Allocations of internal buffer
+
+    // Text lists only fields which were accessed, JSON lists all of them
+    std::string to_text() const;
+    std::string to_json() const;
+};
+
+namespace detail {
+
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+// Only owning thread writes counters of a shard, so increment is a relaxed load and store rather than a locked instruction
+inline void bump(std::atomic<uint64_t>& counter, const uint64_t n)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct stats_counters
+{
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> batch_calls{0};
+    std::atomic<uint64_t> shifted_accesses{0};
+    std::atomic<uint64_t> byte_swaps{0};
+    std::atomic<uint64_t> sign_extensions{0};
+    std::atomic<uint64_t> bytes_touched{0};
+
+    void add(const bool is_write, const bool is_batch, const bool is_shifted, const bool is_swapped, const bool is_extended, const uint64_t bytes)
+    {
+        bump(is_batch ? batch_calls : (is_write ? writes : reads), 1);
+        if (is_shifted)
+            bump(shifted_accesses, 1);
+        if (is_swapped)
+            bump(byte_swaps, 1);
+        if (is_extended)
+            bump(sign_extensions, 1);
+        bump(bytes_touched, bytes);
+    }
+};
+
+const size_t stats_page_length = 64;
+
+// Counters of one serializer collected by one thread. Totals are summed up by snapshots, so every access updates one set of counters
+struct stats_shard
+{
+    std::thread::id                                owner;             // Guarded by mutex of the sink
+    std::atomic<bool>                              is_retired{false}; // Owner has exited, next thread which uses the sink adopts the shard
+    std::mutex                                     pages_mutex;       // Guards growth of pages against snapshots
+    std::vector<std::unique_ptr<stats_counters[]>> pages;             // Counters of fields, pages never move
+    stats_counters                                 ghosts;            // Accesses to ghost fields
+    std::atomic<uint64_t>                          lookup_misses{0};
+    std::atomic<uint64_t>                          reallocations{0};
+};
+
+const size_t stats_cache_length = 16;
+
+// Shards of one thread. Sink ids are consecutive, so up to stats_cache_length sinks used by a thread at once never evict each other.
+// Shards are retired once their thread exits, so sinks keep as many shards as there were threads using them at the same time
+struct stats_shard_cache
+{
+    struct slot
+    {
+        uint64_t     sink_id = 0; // Sink ids are never reused, so slot of a destroyed sink is never matched
+        stats_shard* shard = nullptr;
+    };
+
+    ~stats_shard_cache()
+    {
+        for (const std::shared_ptr<stats_shard>& shard : owned)
+            shard->is_retired.store(true, std::memory_order_release);
+    }
+
+    slot                                      slots[stats_cache_length];
+    std::vector<std::shared_ptr<stats_shard>> owned;
+};
+
+// Counters of one serializer: a shard per thread which used it, merged into serializer_stats on demand
+class stats_sink
+{
+public:
+    stats_sink();
+
+    stats_shard& local()
+    {
+        static thread_local stats_shard_cache cache;
+        stats_shard_cache::slot& slot = cache.slots[m_id % stats_cache_length];
+        if (slot.sink_id != m_id) {
+            slot.shard = &find_shard(cache);
+            slot.sink_id = m_id;
+        }
+        return *slot.shard;
+    }
+
+    stats_counters& field(stats_shard& shard, const size_t index)
+    {
+        const size_t page = index / stats_page_length;
+        if (page >= shard.pages.size()) {
+            std::lock_guard<std::mutex> lock(shard.pages_mutex);
+            while (shard.pages.size() <= page)
+                shard.pages.emplace_back(new stats_counters[stats_page_length]);
+        }
+        return shard.pages[page][index % stats_page_length];
+    }
+
+    serializer_stats snapshot(const std::vector<std::string>& names) const;
+
+    // Counters are never cleared (their owners write them without locks), current values become a baseline instead
+    void reset();
+
+private:
+    stats_shard&     find_shard(stats_shard_cache& cache);
+    serializer_stats merge() const;
+
+    const uint64_t                            m_id;
+    mutable std::mutex                        m_mutex;
+    std::vector<std::shared_ptr<stats_shard>> m_shards;
+    serializer_stats                          m_baseline;
+};
+#endif
+
+}
+
+}
+
+#endif // EZ_SERIALIZER_STATS
@@ -0,0 +1,179 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_STATIC_PROTOCOL
+#define EZ_STATIC_PROTOCOL
+
+#include <ez_protocol_serializer.h>
+
+namespace ez {
+
+namespace detail {
+
+template<unsigned int BitCount, protocol_serializer::visualization_type VisType>
+struct static_field_value_type
+{
+    using unsigned_type = typename std::conditional<BitCount <= 8, uint8_t,
+                          typename std::conditional<BitCount <= 16, uint16_t,
+                          typename std::conditional<BitCount <= 32, uint32_t, uint64_t>::type>::type>::type;
+    using signed_type = typename std::make_signed<unsigned_type>::type;
+    using float_type = typename std::conditional<BitCount == 32, float, double>::type;
+    using type = typename std::conditional<VisType == protocol_serializer::visualization_type::floating_point, float_type,
+                 typename std::conditional<VisType == protocol_serializer::visualization_type::signed_integer, signed_type, unsigned_type>::type>::type;
+};
+
+// Finds position of Field inside Fields... at compile time
+template<class Field, class... Fields>
+struct static_field_position
+{
+    static constexpr unsigned int occurrences = 0;
+    static constexpr unsigned int first_bit_ind = 0;
+};
+
+template<class Field, class First, class... Rest>
+struct static_field_position<Field, First, Rest...>
+{
+    using next = static_field_position<Field, Rest...>;
+    static constexpr bool is_first = std::is_same<Field, First>::value;
+    static constexpr unsigned int occurrences = (is_first ? 1 : 0) + next::occurrences;
+    static constexpr unsigned int first_bit_ind = is_first ? 0 : First::bit_count + next::first_bit_ind;
+};
+
+template<class... Fields>
+struct static_bit_count
+{
+    static constexpr unsigned int value = 0;
+};
+
+template<class First, class... Rest>
+struct static_bit_count<First, Rest...>
+{
+    static constexpr unsigned int value = First::bit_count + static_bit_count<Rest...>::value;
+};
+
+// Compile-time counterpart of protocol_serializer::field_metadata
+template<unsigned int FirstBitInd, unsigned int BitCount>
+struct static_field_plan
+{
+    static constexpr unsigned int first_byte_ind = FirstBitInd / 8;
+    static constexpr unsigned int bytes_count = BitCount / 8 + ((BitCount % 8) ? 1 : 0);
+    static constexpr unsigned int touched_bytes_count = (FirstBitInd + BitCount - 1) / 8 - first_byte_ind + 1;
+    static constexpr unsigned int left_spacing = FirstBitInd % 8;
+    static constexpr unsigned int right_spacing = (8 - (FirstBitInd + BitCount) % 8) % 8;
+};
+
+}
+
+// Base of every field of static_protocol. Derived type has to provide static name() method,
+// which is only used when static protocol is converted into protocol_serializer (see EZ_STATIC_FIELD).
+template<unsigned int BitCount, protocol_serializer::visualization_type VisType = protocol_serializer::visualization_type::unsigned_integer>
+struct static_field
+{
+    static_assert(BitCount > 0, "Field must have at least one bit");
+    static_assert(VisType != protocol_serializer::visualization_type::floating_point || BitCount == 32 || BitCount == 64,
+                  "Floating point fields must be 32 or 64 bits long");
+
+    static constexpr unsigned int bit_count = BitCount;
+    static constexpr protocol_serializer::visualization_type vis_type = VisType;
+    // Smallest arithmetic type which holds a value of this field (used by default in get())
+    using value_type = typename detail::static_field_value_type<BitCount, VisType>::type;
+};
+
+// Definitions are required in C++14 in case members are odr-used
+template<unsigned int BitCount, protocol_serializer::visualization_type VisType>
+constexpr unsigned int static_field<BitCount, VisType>::bit_count;
+template<unsigned int BitCount, protocol_serializer::visualization_type VisType>
+constexpr protocol_serializer::visualization_type static_field<BitCount, VisType>::vis_type;
+
+#define EZ_STATIC_FIELD(field_name, bits, visualization) \
+    struct field_name : ::ez::static_field<bits, ::ez::protocol_serializer::visualization_type::visualization> \
+    { \
+        static const char* name() { return #field_name; } \
+    }
+
+// Protocol which layout is known at compile time. Offsets, masks and shifts of every field are
+// compile-time constants, so get()/set() are reduced to a couple of loads, shifts and stores
+// with no runtime validation (every check protocol_serializer does at runtime is a static_assert here).
+template<bool IsLittleEndian, class... Fields>
+class static_protocol
+{
+public:
+    static constexpr bool is_little_endian = IsLittleEndian;
+    static constexpr unsigned int fields_count = sizeof...(Fields);
+    static constexpr unsigned int bit_count = detail::static_bit_count<Fields...>::value;
+    static constexpr unsigned int bytes_count = bit_count / 8 + ((bit_count % 8) ? 1 : 0);
+
+    template<class Field>
+    static constexpr unsigned int first_bit_ind()
+    {
+        static_assert(detail::static_field_position<Field, Fields...>::occurrences == 1, "Field must be present in protocol exactly once");
+        return detail::static_field_position<Field, Fields...>::first_bit_ind;
+    }
+
+    template<class Field, class T = typename Field::value_type>
+    static T get(const unsigned char* buffer)
+    {
+        using plan = detail::static_field_plan<first_bit_ind<Field>(), Field::bit_count>;
+        check_access<Field, T>();
+        const uint64_t raw = detail::extract_bits(buffer + plan::first_byte_ind, plan::touched_bytes_count, plan::right_spacing, Field::bit_count);
+        return detail::decode_value<T>(raw, Field::bit_count, plan::bytes_count, IsLittleEndian);
+    }
+
+    template<class Field, class T>
+    static void set(unsigned char* buffer, const T& value)
+    {
+        using plan = detail::static_field_plan<first_bit_ind<Field>(), Field::bit_count>;
+        check_access<Field, T>();
+        const uint64_t raw = detail::encode_value(value, plan::bytes_count, IsLittleEndian);
+        detail::insert_bits(buffer + plan::first_byte_ind, plan::touched_bytes_count, plan::left_spacing, plan::right_spacing, Field::bit_count, raw);
+    }
+
+    // Creates runtime protocol with identical layout (useful for visualization and everything else which needs field names)
+    static protocol_serializer make_serializer(const protocol_serializer::buffer_source source = protocol_serializer::buffer_source::internal,
+                                               protocol_serializer::byte_ptr_t const external_buffer = nullptr)
+    {
+        return protocol_serializer({protocol_serializer::field_init{Fields::name(), Fields::bit_count, Fields::vis_type}...},
+                                   IsLittleEndian, source, external_buffer);
+    }
+
+private:
+    template<class Field, class T>
+    static constexpr void check_access()
+    {
+        static_assert(std::is_arithmetic<T>::value, "Only arithmetic values can be read or written");
+        static_assert(Field::bit_count <= 64, "Standalone values can not be longer than 64 bits");
+        static_assert(!IsLittleEndian || Field::bit_count <= 8 || Field::bit_count % 8 == 0,
+                      "Little-endian fields must either fit into a byte or consist of whole bytes");
+        static_assert(!std::is_floating_point<T>::value || Field::bit_count == 32 || Field::bit_count == 64,
+                      "Floating point values can only be stored in 32 or 64-bit fields");
+    }
+};
+
+template<bool IsLittleEndian, class... Fields>
+constexpr bool static_protocol<IsLittleEndian, Fields...>::is_little_endian;
+template<bool IsLittleEndian, class... Fields>
+constexpr unsigned int static_protocol<IsLittleEndian, Fields...>::fields_count;
+template<bool IsLittleEndian, class... Fields>
+constexpr unsigned int static_protocol<IsLittleEndian, Fields...>::bit_count;
+template<bool IsLittleEndian, class... Fields>
+constexpr unsigned int static_protocol<IsLittleEndian, Fields...>::bytes_count;
+
+}
+
+#endif // EZ_STATIC_PROTOCOL
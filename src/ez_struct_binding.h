@@ -0,0 +1,239 @@
+// MIT License
+//
+// Copyright(c) 2024 Danila Mokhov (mokhoffdv@gmail.com)
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this softwareand associated documentation files(the "Software"), to deal
+//  the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions :
+// The above copyright noticeand this permission notice shall be included in all
+// copies or substantial portions of the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#ifndef EZ_STRUCT_BINDING
+#define EZ_STRUCT_BINDING
+
+#include <ez_protocol_serializer.h>
+#include <algorithm>
+
+namespace ez {
+
+// Maps members of Struct to protocol fields once, so that decode()/encode() move the whole struct in one pass without name lookups.
+// Bound fields are grouped into windows of up to 8 bytes (see record_plan), every window is loaded/stored once.
+// When bound members tile a byte range of the struct which has the same layout as the record (byte-aligned fields
+// of the same width at the same relative offsets in host byte order), decode()/encode() are a single memcpy().
+template<class Struct>
+class struct_binding
+{
+    static_assert(std::is_default_constructible<Struct>::value, "Struct must be default constructible, offsets of its members are measured on an instance");
+
+public:
+    using result_code = protocol_serializer::result_code;
+    using layout_ptr_t = protocol_serializer::layout_ptr_t;
+
+    explicit struct_binding(const protocol_serializer& ps) :
+        struct_binding(ps.get_layout(), ps.get_is_little_endian())
+    {
+    }
+
+    struct_binding(const layout_ptr_t& layout, const bool is_little_endian = false) :
+        m_layout(layout), m_is_little_endian(is_little_endian)
+    {
+    }
+
+    // Failures (field_not_found, not_applicable like read<T>()) are reported by get_result(), member is not bound then
+    template<class T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    struct_binding& bind(const std::string& name, T Struct::* member)
+    {
+        const protocol_serializer::field_metadata* metadata = m_layout->find_metadata(name);
+        result_code result = metadata == nullptr ? result_code::field_not_found : protocol_serializer::validate_access<T>(m_is_little_endian, metadata->bit_count);
+        if (result != result_code::ok) {
+            if (m_result == result_code::ok)
+                m_result = result;
+            return *this;
+        }
+
+        const Struct probe{};
+        bound_member bound;
+        bound.metadata = *metadata;
+        bound.offset = static_cast<size_t>(reinterpret_cast<const unsigned char*>(&(probe.*member)) - reinterpret_cast<const unsigned char*>(&probe));
+        bound.size = sizeof(T);
+        bound.is_copyable = metadata->left_spacing == 0 && metadata->right_spacing == 0 && metadata->bit_count == sizeof(T) * 8 &&
+                            !std::is_same<T, bool>::value &&
+                            (std::is_floating_point<T>::value || sizeof(T) == 1 || m_is_little_endian == detail::is_host_little_endian());
+        bound.decode = &decode_member<T>;
+        bound.encode = &encode_member<T>;
+        m_members.push_back(bound);
+        compile();
+        return *this;
+    }
+
+    result_code get_result() const { return m_result; }
+    bool        get_is_memcpy() const { return m_is_memcpy; }
+    size_t      get_required_length() const { return m_required_length; }
+
+    // Buffer has to hold at least get_required_length() bytes
+    result_code decode(const unsigned char* buffer, const size_t length, Struct& value) const
+    {
+        const result_code check_result = check_buffer(buffer, length);
+        if (check_result != result_code::ok)
+            return check_result;
+
+        unsigned char* object = reinterpret_cast<unsigned char*>(&value);
+        if (m_is_memcpy) {
+            memcpy(object + m_copy_offset, buffer + m_copy_first_byte, m_copy_length);
+            return result_code::ok;
+        }
+
+        for (const window& current : m_windows) {
+            const unsigned char* ptr = buffer + current.first_byte_ind;
+            const uint64_t word = current.bytes_count <= 8 ? detail::load_be(ptr, current.bytes_count) : 0;
+            for (unsigned int i = current.first_field; i < current.first_field + current.fields_count; ++i) {
+                const bound_member& member = m_members[i];
+                const uint64_t raw = current.bytes_count <= 8 ? (word >> member.shift) & detail::low_bits_mask(member.metadata.bit_count)
+                                                              : detail::extract_bits(ptr, current.bytes_count, member.shift, member.metadata.bit_count);
+                member.decode(raw, member.metadata, m_is_little_endian, object + member.offset);
+            }
+        }
+        return result_code::ok;
+    }
+
+    result_code encode(const Struct& value, unsigned char* buffer, const size_t length) const
+    {
+        const result_code check_result = check_buffer(buffer, length);
+        if (check_result != result_code::ok)
+            return check_result;
+
+        const unsigned char* object = reinterpret_cast<const unsigned char*>(&value);
+        if (m_is_memcpy) {
+            memcpy(buffer + m_copy_first_byte, object + m_copy_offset, m_copy_length);
+            return result_code::ok;
+        }
+
+        for (const window& current : m_windows) {
+            unsigned char* ptr = buffer + current.first_byte_ind;
+            if (current.bytes_count > 8) {
+                const bound_member& member = m_members[current.first_field];
+                const uint64_t raw = member.encode(object + member.offset, member.metadata, m_is_little_endian);
+                detail::insert_bits(ptr, current.bytes_count, member.metadata.left_spacing, member.metadata.right_spacing, member.metadata.bit_count, raw);
+                continue;
+            }
+
+            uint64_t word = 0;
+            for (unsigned int i = current.first_field; i < current.first_field + current.fields_count; ++i) {
+                const bound_member& member = m_members[i];
+                const uint64_t raw = member.encode(object + member.offset, member.metadata, m_is_little_endian);
+                word |= (raw & detail::low_bits_mask(member.metadata.bit_count)) << member.shift;
+            }
+
+            // Bits of fields which are not bound are preserved
+            if (current.fields_mask != detail::low_bits_mask(current.bytes_count * 8))
+                word |= detail::load_be(ptr, current.bytes_count) & ~current.fields_mask;
+            detail::store_be(ptr, current.bytes_count, word);
+        }
+        return result_code::ok;
+    }
+
+private:
+    using decode_t = void(*)(uint64_t, const protocol_serializer::field_metadata&, bool, unsigned char*);
+    using encode_t = uint64_t(*)(const unsigned char*, const protocol_serializer::field_metadata&, bool);
+
+    struct bound_member
+    {
+        protocol_serializer::field_metadata metadata = protocol_serializer::field_metadata(0, 0);
+        size_t                              offset = 0; // Of the member inside of Struct
+        size_t                              size = 0;
+        unsigned int                        shift = 0;  // Of the field inside of its window
+        bool                                is_copyable = false;
+        decode_t                            decode = nullptr;
+        encode_t                            encode = nullptr;
+    };
+
+    // Members of a window are a range of m_members
+    using window = detail::field_window;
+
+    template<class T>
+    static void decode_member(const uint64_t raw, const protocol_serializer::field_metadata& metadata, const bool is_little_endian, unsigned char* member)
+    {
+        const T value = detail::decode_value<T>(raw, metadata.bit_count, metadata.bytes_count, is_little_endian);
+        memcpy(member, &value, sizeof(T));
+    }
+
+    template<class T>
+    static uint64_t encode_member(const unsigned char* member, const protocol_serializer::field_metadata& metadata, const bool is_little_endian)
+    {
+        T value;
+        memcpy(&value, member, sizeof(T));
+        return detail::encode_value(value, metadata.bytes_count, is_little_endian);
+    }
+
+    result_code check_buffer(const void* buffer, const size_t length) const
+    {
+        if (buffer == nullptr)
+            return result_code::bad_input;
+
+        if (length < m_required_length)
+            return result_code::buffer_too_short;
+
+        return result_code::ok;
+    }
+
+    void compile()
+    {
+        std::sort(m_members.begin(), m_members.end(), [](const bound_member& a, const bound_member& b) {
+            return a.metadata.first_bit_ind < b.metadata.first_bit_ind;
+        });
+
+        std::vector<const protocol_serializer::field_metadata*> fields(m_members.size());
+        std::vector<unsigned int> shifts(m_members.size());
+        for (size_t i = 0; i < m_members.size(); ++i)
+            fields[i] = &m_members[i].metadata;
+        m_windows.resize(m_members.size());
+        m_windows.resize(detail::group_into_windows(fields.data(), fields.size(), m_windows.data(), shifts.data()));
+
+        m_required_length = 0;
+        for (size_t i = 0; i < m_members.size(); ++i) {
+            const protocol_serializer::field_metadata& field = m_members[i].metadata;
+            m_members[i].shift = shifts[i];
+            m_required_length = std::max<size_t>(m_required_length, field.first_byte_ind + field.touched_bytes_count);
+        }
+
+        // Single copy is possible when record bytes and struct bytes are the same range shifted by a constant
+        m_is_memcpy = std::is_trivially_copyable<Struct>::value && !m_members.empty();
+        for (size_t i = 0; i < m_members.size() && m_is_memcpy; ++i) {
+            const bound_member& member = m_members[i];
+            m_is_memcpy = member.is_copyable && member.offset + m_members[0].metadata.first_byte_ind == m_members[0].offset + member.metadata.first_byte_ind &&
+                          (i == 0 || m_members[i - 1].offset + m_members[i - 1].size == member.offset);
+        }
+        if (m_is_memcpy) {
+            m_copy_offset = m_members.front().offset;
+            m_copy_first_byte = m_members.front().metadata.first_byte_ind;
+            m_copy_length = m_members.back().offset + m_members.back().size - m_copy_offset;
+        }
+    }
+
+    layout_ptr_t              m_layout;
+    bool                      m_is_little_endian;
+    result_code               m_result = result_code::ok;
+    std::vector<bound_member> m_members;
+    std::vector<window>       m_windows;
+    size_t                    m_required_length = 0;
+    bool                      m_is_memcpy = false;
+    size_t                    m_copy_offset = 0;
+    size_t                    m_copy_first_byte = 0;
+    size_t                    m_copy_length = 0;
+};
+
+// Binds member to the field of the same name: binding.bind(EZ_BIND(quote, price))
+#define EZ_BIND(struct_name, member) #member, &struct_name::member
+
+}
+
+#endif // EZ_STRUCT_BINDING
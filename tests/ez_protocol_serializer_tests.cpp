@@ -1,12 +1,35 @@
 #include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <thread>
 #include <type_traits>
 #include <gtest/gtest.h>
 #include <ez_protocol_serializer.h>
+#include <ez_static_protocol.h>
+#include <ez_record_framer.h>
+#include <ez_capture_reader.h>
+#include <ez_parallel_decoder.h>
+#include <ez_record_filter.h>
+#include <ez_projection.h>
+#include <ez_record_plan.h>
+#include <ez_struct_binding.h>
+#include <ez_schema_loader.h>
 
 using ez::protocol_serializer;
 using buffer_source = ez::protocol_serializer::buffer_source;
 using result_code = ez::protocol_serializer::result_code;
 
+// File in temporary directory of the test run. Leftovers of interrupted runs are removed first,
+// the file itself is removed when the test ends even if an assertion fails
+struct TemporaryFile
+{
+    explicit TemporaryFile(const std::string& name) : path(::testing::TempDir() + name) { remove(path.c_str()); }
+    ~TemporaryFile() { remove(path.c_str()); }
+    const std::string path;
+};
+
 template<class T>
 std::vector<T> generateEquallySpreadValues(T min, T max, const unsigned int N = 100)
 {
@@ -236,6 +259,43 @@ TEST(Constructing, Move)
     EXPECT_EQ(psMoveConstructor.get_fields_list().size(), 0);
 }
 
+// Check if copies share layout until one of them changes it
+TEST(Constructing, SharedLayout)
+{
+    protocol_serializer ps({{"field_1", 8}, {"field_2", 12}, {"field_3", 4}});
+    const protocol_serializer::field_handle handle = ps.get_field_handle("field_3");
+    ps.write("field_2", 1234);
+
+    protocol_serializer copy(ps);
+    EXPECT_EQ(copy.get_layout(), ps.get_layout());
+    EXPECT_NE(copy.get_working_buffer(), ps.get_working_buffer());
+    EXPECT_EQ(copy.read<int>("field_2"), 1234);
+    EXPECT_TRUE(copy.is_valid_handle(handle));
+
+    // Changed copy gets its own layout, original one stays intact
+    EXPECT_EQ(copy.remove_field("field_1"), result_code::ok);
+    EXPECT_NE(copy.get_layout(), ps.get_layout());
+    EXPECT_EQ(copy.get_fields_list().size(), 2);
+    EXPECT_EQ(ps.get_fields_list().size(), 3);
+    EXPECT_EQ(ps.get_field_metadata("field_2").first_bit_ind, 8);
+    EXPECT_EQ(copy.get_field_metadata("field_2").first_bit_ind, 0);
+    EXPECT_FALSE(copy.is_valid_handle(handle));
+    EXPECT_TRUE(ps.is_valid_handle(handle));
+
+    // Layout which is not shared is changed in place
+    const protocol_serializer::layout_ptr_t::element_type* layout = ps.get_layout().get();
+    EXPECT_EQ(ps.append_field({"field_4", 3}), result_code::ok);
+    EXPECT_EQ(ps.get_layout().get(), layout);
+
+    // Handles do not survive clearing even if fields with same names are added again
+    EXPECT_EQ(ps.clear_protocol(), result_code::ok);
+    EXPECT_EQ(ps.append_field({"field_1", 8}), result_code::ok);
+    EXPECT_EQ(ps.append_field({"field_2", 12}), result_code::ok);
+    EXPECT_EQ(ps.append_field({"field_3", 4}), result_code::ok);
+    EXPECT_FALSE(ps.is_valid_handle(handle));
+    EXPECT_EQ(ps.append_protocol(ps), result_code::bad_input);
+}
+
 // Checks if host endiannes is correctly recognized
 TEST(Constructing, Endiannes)
 {
@@ -319,6 +379,136 @@ TEST(Modifying, ProtocolLayout)
     EXPECT_EQ(psSecond.clear_protocol(), result_code::not_applicable);
 }
 
+// Checks if values follow their fields when fields are inserted or removed in the middle of protocol
+TEST(Modifying, InsertAndRemoveKeepValues)
+{
+    protocol_serializer ps({{"a", 3}, {"b", 13}, {"c", 8}, {"d", 29}, {"e", 1}});
+    ps.write("a", 5);
+    ps.write("b", 4321);
+    ps.write("c", 200);
+    ps.write("d", 123456789);
+    ps.write("e", 1);
+    const protocol_serializer::field_handle handle = ps.get_field_handle("a");
+
+    EXPECT_EQ(ps.insert_field(2, {"inserted", 11}), result_code::ok);
+    EXPECT_EQ(ps.get_fields_list(), protocol_serializer::fields_list_t({"a", "b", "inserted", "c", "d", "e"}));
+    EXPECT_EQ(ps.get_field_metadata("c").first_bit_ind, 3 + 13 + 11);
+    EXPECT_EQ(ps.get_internal_buffer_length(), 9);
+    EXPECT_EQ(ps.read<unsigned int>("a"), 5);
+    EXPECT_EQ(ps.read<unsigned int>("b"), 4321);
+    EXPECT_EQ(ps.read<unsigned int>("inserted"), 0);
+    EXPECT_EQ(ps.read<unsigned int>("c"), 200);
+    EXPECT_EQ(ps.read<unsigned int>("d"), 123456789);
+    EXPECT_EQ(ps.read<unsigned int>("e"), 1);
+    EXPECT_FALSE(ps.is_valid_handle(handle));
+
+    EXPECT_EQ(ps.remove_field("b"), result_code::ok);
+    EXPECT_EQ(ps.get_field_handle("c").index, 2);
+    EXPECT_EQ(ps.read<unsigned int>("a"), 5);
+    EXPECT_EQ(ps.read<unsigned int>("c"), 200);
+    EXPECT_EQ(ps.read<unsigned int>("d"), 123456789);
+    EXPECT_EQ(ps.read<unsigned int>("e"), 1);
+
+    EXPECT_EQ(ps.insert_field(0, {"first", 64}), result_code::ok);
+    EXPECT_EQ(ps.insert_field(ps.get_fields_list().size(), {"last", 2}), result_code::ok);
+    EXPECT_EQ(ps.insert_field(100, {"too_far", 2}), result_code::bad_input);
+    EXPECT_EQ(ps.insert_field(1, {"last", 2}), result_code::bad_input);
+    EXPECT_EQ(ps.read<unsigned int>("a"), 5);
+    EXPECT_EQ(ps.read<unsigned int>("d"), 123456789);
+
+    // Bits vacated by a removal must not show up as values of fields appended later
+    protocol_serializer vacated({{"a", 4}, {"b", 4}});
+    vacated.write("b", 0xF);
+    EXPECT_EQ(vacated.remove_field("a"), result_code::ok);
+    EXPECT_EQ(vacated.insert_field(1, {"c", 4}), result_code::ok);
+    EXPECT_EQ(vacated.read<unsigned int>("b"), 0xF);
+    EXPECT_EQ(vacated.read<unsigned int>("c"), 0);
+    vacated.write("c", 0xF);
+    EXPECT_EQ(vacated.remove_last_field(), result_code::ok);
+    EXPECT_EQ(vacated.append_fields({{"d", 2}, {"e", 2}}), result_code::ok);
+    EXPECT_EQ(vacated.read<unsigned int>("d"), 0);
+    EXPECT_EQ(vacated.read<unsigned int>("e"), 0);
+
+    // Randomized sequence of edits is checked against expected values of every field
+    std::vector<std::pair<std::string, uint32_t>> expected;
+    protocol_serializer randomized;
+    unsigned int seed = 1;
+    const auto next = [&seed]() { seed = seed * 1103515245u + 12345u; return seed >> 8; };
+    for (unsigned int step = 0; step < 500; ++step) {
+        if (expected.size() < 5 || next() % 3) {
+            const size_t index = next() % (expected.size() + 1);
+            const unsigned int bitCount = 1 + next() % 32;
+            const std::string name = "field_" + std::to_string(step);
+            ASSERT_EQ(randomized.insert_field(index, {name, bitCount}), result_code::ok);
+            const uint32_t value = static_cast<uint32_t>(next() & ((uint64_t(1) << bitCount) - 1));
+            randomized.write(name, value);
+            expected.insert(expected.begin() + index, {name, value});
+        } else {
+            const size_t index = next() % expected.size();
+            ASSERT_EQ(randomized.remove_field(expected[index].first), result_code::ok);
+            expected.erase(expected.begin() + index);
+        }
+        for (const std::pair<std::string, uint32_t>& field : expected)
+            ASSERT_EQ(randomized.read<uint32_t>(field.first), field.second);
+    }
+}
+
+// Checks if bulk appending and reserving behave like appending fields one by one
+TEST(Modifying, AppendFields)
+{
+    std::vector<protocol_serializer::field_init> fields;
+    for (unsigned int i = 0; i < 1000; ++i)
+        fields.push_back({"field_" + std::to_string(i), 1 + i % 13});
+
+    protocol_serializer bulk(fields);
+    protocol_serializer oneByOne;
+    for (const protocol_serializer::field_init& init : fields)
+        EXPECT_EQ(oneByOne.append_field(init), result_code::ok);
+    EXPECT_EQ(bulk.get_fields_list(), oneByOne.get_fields_list());
+    EXPECT_EQ(bulk.get_internal_buffer_length(), oneByOne.get_internal_buffer_length());
+    EXPECT_EQ(bulk.get_field_metadata("field_999").first_bit_ind, oneByOne.get_field_metadata("field_999").first_bit_ind);
+
+    // Either all fields are appended or none of them
+    bulk.write("field_998", 5);
+    EXPECT_EQ(bulk.append_fields({{"extra_1", 8}, {"extra_2", 8}, {"extra_1", 8}}), result_code::bad_input);
+    EXPECT_EQ(bulk.append_fields({{"extra_1", 8}, {"bad_float", 12, protocol_serializer::visualization_type::floating_point}}), result_code::not_applicable);
+    EXPECT_EQ(bulk.get_fields_list().size(), 1000);
+    EXPECT_EQ(bulk.get_internal_buffer_length(), oneByOne.get_internal_buffer_length());
+    EXPECT_EQ(bulk.append_fields({{"extra_1", 8}, {"extra_2", 16}}), result_code::ok);
+    EXPECT_EQ(bulk.get_fields_list().size(), 1002);
+    EXPECT_EQ(bulk.read<int>("field_998"), 5);
+    EXPECT_EQ(bulk.read<int>("extra_2"), 0);
+
+    // Rejected batch leaves shared layout attached, so handles stay valid
+    const protocol_serializer::field_handle handle = bulk.get_field_handle("field_998");
+    const protocol_serializer bulkCopy(bulk);
+    EXPECT_EQ(bulk.append_fields({{"extra_3", 8}, {"extra_3", 8}}), result_code::bad_input);
+    EXPECT_EQ(bulk.append_fields({{"len", 8}, {"data", 8, protocol_serializer::visualization_type::unsigned_integer, "missing"}}), result_code::field_not_found);
+    EXPECT_EQ(bulk.append_fields({{"len", 8, protocol_serializer::visualization_type::unsigned_integer, "data"}, {"data", 8}}), result_code::field_not_found);
+    EXPECT_EQ(bulk.get_layout().get(), bulkCopy.get_layout().get());
+    EXPECT_TRUE(bulk.is_valid_handle(handle));
+    EXPECT_EQ(bulk.append_fields({{"len", 8}, {"data", 8, protocol_serializer::visualization_type::unsigned_integer, "len"}}), result_code::ok);
+    EXPECT_FALSE(bulk.is_valid_handle(handle));
+
+    // Reserved buffer is not reallocated by appending
+    protocol_serializer reserved;
+    reserved.reserve(100, 100);
+    EXPECT_EQ(reserved.append_field({"first", 8}), result_code::ok);
+    reserved.write("first", 42);
+    const unsigned char* buffer = reserved.get_working_buffer();
+    for (unsigned int i = 0; i < 99; ++i)
+        EXPECT_EQ(reserved.append_field({"field_" + std::to_string(i), 8}), result_code::ok);
+    EXPECT_EQ(reserved.get_working_buffer(), buffer);
+    EXPECT_EQ(reserved.read<int>("first"), 42);
+
+    // Bytes which are exposed again after shrinking are zeroed
+    reserved.write("field_98", 7);
+    EXPECT_EQ(reserved.remove_last_field(), result_code::ok);
+    EXPECT_EQ(reserved.append_field({"field_98", 8}), result_code::ok);
+    EXPECT_EQ(reserved.read<int>("field_98"), 0);
+    EXPECT_EQ(reserved.get_working_buffer(), buffer);
+}
+
 // Checks if internal protocol endiannes results in mirrored values written
 TEST(ReadWrite, Endiannes)
 {
@@ -468,4 +658,1326 @@ TEST(ReadWrite, TypeOverflow)
         checkTypeOverflowOf<int16_t, int64_t>(offset);
         checkTypeOverflowOf<int32_t, int64_t>(offset);
     }
-}
\ No newline at end of file
+}
+
+// Checks if field handles work the same way as names and get invalidated on layout changes
+TEST(ReadWrite, FieldHandles)
+{
+    protocol_serializer ps({{"field_1", 3}, {"field_2", 13}, {"array", 4 * 6}, {"field_3", 7}});
+
+    result_code result = result_code::ok;
+    const protocol_serializer::field_handle field2 = ps.get_field_handle("field_2", &result);
+    EXPECT_EQ(result, result_code::ok);
+    EXPECT_TRUE(ps.is_valid_handle(field2));
+    EXPECT_FALSE(ps.is_valid_handle(ps.get_field_handle("non_existing_field", &result)));
+    EXPECT_EQ(result, result_code::field_not_found);
+    EXPECT_FALSE(ps.is_valid_handle(protocol_serializer::field_handle()));
+
+    // Reading/writing by handle and by name are interchangeable
+    EXPECT_EQ(ps.write(field2, -1234), result_code::ok);
+    EXPECT_EQ(ps.read<int>("field_2"), -1234);
+    EXPECT_EQ(ps.write("field_2", 4011), result_code::ok);
+    EXPECT_EQ(ps.read<int>(field2), 4011);
+    EXPECT_EQ(ps.get_field_metadata(field2).first_bit_ind, ps.get_field_metadata("field_2").first_bit_ind);
+    EXPECT_EQ(ps.get_field_pointer(field2), ps.get_field_pointer("field_2"));
+
+    const protocol_serializer::field_handle array = ps.get_field_handle("array");
+    const int writtenArray[4] = {-32, 31, 0, -1};
+    int readArray[4] = {};
+    EXPECT_EQ(ps.write_array(array, writtenArray, 4), result_code::ok);
+    ps.read_array(array, readArray, 4, &result);
+    EXPECT_EQ(result, result_code::ok);
+    for (int i = 0; i < 4; ++i)
+        EXPECT_EQ(readArray[i], writtenArray[i]);
+
+    // Handles stay valid in copies and after appending fields
+    protocol_serializer psCopy(ps);
+    EXPECT_EQ(psCopy.read<int>(field2), 4011);
+    EXPECT_EQ(psCopy.append_field({"copy_field", 5}), result_code::ok);
+    EXPECT_EQ(ps.append_field({"field_4", 5}), result_code::ok);
+    const protocol_serializer::field_handle field4 = ps.get_field_handle("field_4");
+    EXPECT_EQ(ps.read<int>(field2), 4011);
+    EXPECT_FALSE(psCopy.is_valid_handle(field4));
+
+    // Removing fields invalidates handles
+    const protocol_serializer::field_handle field3 = ps.get_field_handle("field_3");
+    EXPECT_EQ(ps.remove_field("field_1"), result_code::ok);
+    EXPECT_FALSE(ps.is_valid_handle(field2));
+    EXPECT_FALSE(ps.is_valid_handle(field3));
+    ps.read<int>(field2, &result);
+    EXPECT_EQ(result, result_code::field_not_found);
+    EXPECT_EQ(ps.write(field2, 1), result_code::field_not_found);
+    EXPECT_EQ(ps.get_field_handle("field_3").index, 2);
+    EXPECT_EQ(ps.remove_last_field(), result_code::ok);
+    EXPECT_FALSE(ps.is_valid_handle(field4));
+
+    // Clearing protocol invalidates handles
+    const protocol_serializer::field_handle newField2 = ps.get_field_handle("field_2");
+    EXPECT_TRUE(ps.is_valid_handle(newField2));
+    EXPECT_EQ(ps.clear_protocol(), result_code::ok);
+    EXPECT_FALSE(ps.is_valid_handle(newField2));
+    EXPECT_EQ(ps.append_field({"field_2", 13}), result_code::ok);
+    EXPECT_FALSE(ps.is_valid_handle(newField2));
+}
+
+// Checks if handles of copies which diverged after copying never refer to fields of each other
+TEST(ReadWrite, FieldHandlesOfDivergedCopies)
+{
+    protocol_serializer original({{"x", 8}});
+    protocol_serializer copy(original);
+    EXPECT_EQ(original.append_field({"secret", 16}), result_code::ok);
+    EXPECT_EQ(copy.append_field({"other", 4}), result_code::ok);
+
+    const protocol_serializer::field_handle secret = original.get_field_handle("secret");
+    const protocol_serializer::field_handle other = copy.get_field_handle("other");
+    EXPECT_FALSE(copy.is_valid_handle(secret));
+    EXPECT_FALSE(original.is_valid_handle(other));
+    result_code result = result_code::ok;
+    copy.read<int>(secret, &result);
+    EXPECT_EQ(result, result_code::field_not_found);
+    EXPECT_EQ(copy.get_field_metadata(secret).bit_count, 0u);
+    EXPECT_EQ(copy.get_layout()->find_metadata(secret), nullptr);
+}
+
+// Checks if one serializer can be read from multiple threads simultaneously (run with EZ_PROTOCOL_SERIALIZER_TSAN=ON)
+TEST(ReadWrite, ConcurrentReads)
+{
+    const unsigned int fieldsCount = 64;
+    protocol_serializer ps;
+    for (unsigned int i = 0; i < fieldsCount; ++i)
+        ps.append_field({"field_" + std::to_string(i), 1 + i % 64, protocol_serializer::visualization_type::signed_integer});
+    for (unsigned int i = 0; i < fieldsCount; ++i)
+        ps.write("field_" + std::to_string(i), -static_cast<int64_t>(i) / 2);
+
+    const protocol_serializer& sharedPs = ps;
+    const std::string expectedVisualization = sharedPs.get_visualization(protocol_serializer::visualization_params().set_print_values(true));
+    std::atomic<unsigned int> mismatches(0);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < 8; ++t) {
+        threads.emplace_back([&sharedPs, &mismatches, &expectedVisualization, t, fieldsCount]() {
+            std::vector<protocol_serializer::field_handle> handles;
+            for (unsigned int i = 0; i < fieldsCount; ++i)
+                handles.push_back(sharedPs.get_field_handle("field_" + std::to_string(i)));
+
+            for (unsigned int iteration = 0; iteration < 200; ++iteration) {
+                for (unsigned int i = (t + iteration) % fieldsCount, n = 0; n < fieldsCount; i = (i + 1) % fieldsCount, ++n) {
+                    const int64_t expected = -static_cast<int64_t>(i) / 2;
+                    result_code result = result_code::ok;
+                    if (sharedPs.read<int64_t>(handles[i], &result) != expected || result != result_code::ok)
+                        ++mismatches;
+                    if (sharedPs.read<int64_t>("field_" + std::to_string(i)) != expected)
+                        ++mismatches;
+                }
+                int64_t array[2] = {};
+                sharedPs.read_array(handles[fieldsCount - 1], array, 2);
+                if (sharedPs.get_field_pointer(handles[t]) == nullptr)
+                    ++mismatches;
+            }
+            if (sharedPs.get_visualization(protocol_serializer::visualization_params().set_print_values(true)) != expectedVisualization)
+                ++mismatches;
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(mismatches, 0);
+}
+
+TEST(ReadWrite, ConcurrentVariableLengthReads)
+{
+    using vt = protocol_serializer::visualization_type;
+    unsigned char packet[] = {0x13, 0xAA, 0xBB, 0xCC, 0x12, 0x34};
+    protocol_serializer ps({{"type", 4}, {"count", 4}, {"payload", 8, vt::unsigned_integer, "count"}, {"tail", 16}});
+    ASSERT_EQ(ps.set_external_buffer(packet, sizeof(packet)), result_code::ok);
+    ps.set_buffer_source(protocol_serializer::buffer_source::external);
+
+    const protocol_serializer& sharedPs = ps;
+    const protocol_serializer::field_handle tail = sharedPs.get_field_handle("tail");
+    std::atomic<unsigned int> mismatches(0);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < 8; ++t) {
+        threads.emplace_back([&sharedPs, &mismatches, tail]() {
+            for (unsigned int iteration = 0; iteration < 1000; ++iteration) {
+                result_code result = result_code::ok;
+                if (sharedPs.read<unsigned int>("tail", &result) != 0x1234 || result != result_code::ok)
+                    ++mismatches;
+                if (sharedPs.read<unsigned int>(tail) != 0x1234 || sharedPs.get_available_fields_count() != 4)
+                    ++mismatches;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(mismatches, 0);
+}
+
+namespace static_fields {
+EZ_STATIC_FIELD(version, 4, unsigned_integer);
+EZ_STATIC_FIELD(offset, 7, signed_integer);
+EZ_STATIC_FIELD(value, 61, signed_integer);
+EZ_STATIC_FIELD(ratio, 32, floating_point);
+EZ_STATIC_FIELD(counter, 16, unsigned_integer);
+EZ_STATIC_FIELD(precise, 64, floating_point);
+EZ_STATIC_FIELD(flag, 1, unsigned_integer);
+}
+
+template<bool IsLittleEndian, class... Fields>
+void checkStaticProtocolMatchesRuntime()
+{
+    using protocol = ez::static_protocol<IsLittleEndian, Fields...>;
+    protocol_serializer ps = protocol::make_serializer();
+    EXPECT_EQ(ps.get_is_little_endian(), IsLittleEndian);
+    EXPECT_EQ(ps.get_internal_buffer_length(), protocol::bytes_count);
+    EXPECT_EQ(ps.get_fields_list().size(), protocol::fields_count);
+
+    // Static layout must be identical to the runtime one
+    const bool sameLayout[] = {(ps.get_field_metadata(Fields::name()).first_bit_ind == protocol::template first_bit_ind<Fields>())...};
+    for (const bool same : sameLayout)
+        EXPECT_TRUE(same);
+
+    // Values written by static accessors are read back by runtime ones and vise-versa
+    unsigned int seed = 1;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        for (unsigned int i = 0; i < ps.get_internal_buffer_length(); ++i) {
+            seed = seed * 1103515245u + 12345u;
+            ps.get_working_buffer()[i] = static_cast<unsigned char>(seed >> 16);
+        }
+        const bool sameValues[] = {(protocol::template get<Fields>(ps.get_working_buffer()) == ps.read<typename Fields::value_type>(Fields::name())
+                                    || std::is_floating_point<typename Fields::value_type>::value)...};
+        for (const bool same : sameValues)
+            EXPECT_TRUE(same);
+
+        const bool sameNarrowedValues[] = {(protocol::template get<Fields, int8_t>(ps.get_working_buffer()) == ps.read<int8_t>(Fields::name()))...};
+        for (const bool same : sameNarrowedValues)
+            EXPECT_TRUE(same);
+
+        std::vector<unsigned char> buffer(ps.get_working_buffer(), ps.get_working_buffer() + ps.get_internal_buffer_length());
+        const int dummy[] = {(protocol::template set<Fields>(buffer.data(), static_cast<int64_t>(seed) - attempt), 0)...};
+        (void)dummy;
+        const int dummy2[] = {(ps.write(Fields::name(), static_cast<int64_t>(seed) - attempt), 0)...};
+        (void)dummy2;
+        EXPECT_EQ(memcmp(buffer.data(), ps.get_working_buffer(), buffer.size()), 0);
+    }
+}
+
+// Checks if compile-time protocols produce the same results as runtime ones
+TEST(StaticProtocol, MatchesRuntimeProtocol)
+{
+    using namespace static_fields;
+    checkStaticProtocolMatchesRuntime<false, version, offset, value, ratio, counter, precise, flag>();
+    checkStaticProtocolMatchesRuntime<false, flag, value, offset, version>();
+    checkStaticProtocolMatchesRuntime<true, version, ratio, counter, precise, flag>();
+
+    using protocol = ez::static_protocol<false, version, offset, ratio, flag>;
+    unsigned char buffer[protocol::bytes_count] = {};
+    protocol::set<ratio>(buffer, 3.5f);
+    protocol::set<offset>(buffer, -3);
+    EXPECT_EQ(protocol::get<ratio>(buffer), 3.5f);
+    EXPECT_EQ(protocol::get<offset>(buffer), -3);
+    EXPECT_EQ((protocol::get<offset, unsigned int>(buffer)), 0x7Du);
+    static_assert(std::is_same<ratio::value_type, float>::value && std::is_same<offset::value_type, int8_t>::value, "");
+
+    // Visualization is available through runtime protocol
+    protocol_serializer ps = protocol::make_serializer(buffer_source::external, buffer);
+    EXPECT_EQ(ps.read<int>("offset"), -3);
+    EXPECT_NE(ps.get_visualization(protocol_serializer::visualization_params().set_print_values(true)).find("=3.5"), std::string::npos);
+}
+
+// Checks if batch column reading/writing matches per-record reading/writing
+TEST(ReadWrite, Columns)
+{
+    for (int isLittleEndian = 0; isLittleEndian <= 1; ++isLittleEndian) {
+        protocol_serializer ps({{"flag", 1}, {"small", 5}, {"word", 16}, {"wide", 64}, {"ratio", 32}, {"tail", 3}}, isLittleEndian != 0);
+        const size_t recordStride = ps.get_internal_buffer_length() + 3;
+        const size_t recordsCount = 1000;
+        std::vector<unsigned char> records(recordStride * recordsCount);
+        unsigned int seed = 7;
+        for (unsigned char& byte : records) {
+            seed = seed * 1103515245u + 12345u;
+            byte = static_cast<unsigned char>(seed >> 16);
+        }
+
+        // Reading
+        std::vector<int8_t> small(recordsCount);
+        std::vector<uint16_t> word(recordsCount);
+        std::vector<int64_t> wide(recordsCount);
+        std::vector<float> ratio(recordsCount);
+        std::vector<uint32_t> tail(recordsCount);
+        EXPECT_EQ(ps.read_column("small", records.data(), recordStride, recordsCount, small.data()), result_code::ok);
+        EXPECT_EQ(ps.read_column(ps.get_field_handle("word"), records.data(), recordStride, recordsCount, word.data()), result_code::ok);
+        EXPECT_EQ(ps.read_column("wide", records.data(), recordStride, recordsCount, wide.data()), result_code::ok);
+        EXPECT_EQ(ps.read_column("ratio", records.data(), recordStride, recordsCount, ratio.data()), result_code::ok);
+        EXPECT_EQ(ps.read_column("tail", records.data(), recordStride, recordsCount, tail.data()), result_code::ok);
+        for (size_t i = 0; i < recordsCount; ++i) {
+            ps.set_buffer_source(buffer_source::external);
+            ps.set_external_buffer(&records[i * recordStride]);
+            EXPECT_EQ(small[i], ps.read<int8_t>("small"));
+            EXPECT_EQ(word[i], ps.read<uint16_t>("word"));
+            EXPECT_EQ(wide[i], ps.read<int64_t>("wide"));
+            const float expectedRatio = ps.read<float>("ratio");
+            EXPECT_TRUE(ratio[i] == expectedRatio || (std::isnan(ratio[i]) && std::isnan(expectedRatio)));
+            EXPECT_EQ(tail[i], ps.read<uint32_t>("tail"));
+        }
+
+        // Writing must only touch bits of the field
+        std::vector<unsigned char> expectedRecords(records);
+        for (size_t i = 0; i < recordsCount; ++i) {
+            small[i] = static_cast<int8_t>(i % 32) - 16;
+            wide[i] = -static_cast<int64_t>(i) * 1000003;
+            ps.set_external_buffer(&expectedRecords[i * recordStride]);
+            ps.write("small", small[i]);
+            ps.write("wide", wide[i]);
+        }
+        EXPECT_EQ(ps.write_column("small", records.data(), recordStride, recordsCount, small.data()), result_code::ok);
+        EXPECT_EQ(ps.write_column(ps.get_field_handle("wide"), records.data(), recordStride, recordsCount, wide.data()), result_code::ok);
+        EXPECT_EQ(records, expectedRecords);
+
+        // Same validation rules as for single values
+        EXPECT_EQ(ps.read_column("non_existing_field", records.data(), recordStride, recordsCount, wide.data()), result_code::field_not_found);
+        EXPECT_EQ(ps.read_column("word", records.data(), recordStride, recordsCount, ratio.data()), result_code::not_applicable);
+        EXPECT_EQ(ps.write_column("small", static_cast<unsigned char*>(nullptr), recordStride, recordsCount, small.data()), result_code::bad_input);
+    }
+}
+
+// Checks if packed arrays (which are read/written by array kernels) match element-wise reading/writing
+TEST(ReadWrite, PackedArrays)
+{
+    const unsigned int samplesCount = 600;
+    for (int isLittleEndian = 0; isLittleEndian <= 1; ++isLittleEndian) {
+        for (unsigned int bitCount = 1; bitCount <= 64; ++bitCount) {
+            if (isLittleEndian && bitCount > 8 && bitCount % 8)
+                continue;
+
+            protocol_serializer ps({{"head", 3}, {"samples", bitCount * samplesCount}, {"tail", 5}}, isLittleEndian != 0);
+            const unsigned int firstBit = ps.get_field_metadata("samples").first_bit_ind;
+            unsigned int seed = bitCount;
+            for (unsigned int i = 0; i < ps.get_internal_buffer_length(); ++i) {
+                seed = seed * 1103515245u + 12345u;
+                ps.get_working_buffer()[i] = static_cast<unsigned char>(seed >> 16);
+            }
+
+            // Reading (including narrowing into smaller type)
+            std::vector<int64_t> signedSamples(samplesCount);
+            std::vector<uint16_t> narrowSamples(samplesCount);
+            result_code result = result_code::bad_input;
+            ps.read_array("samples", signedSamples, samplesCount, &result);
+            EXPECT_EQ(result, result_code::ok);
+            ps.read_array(ps.get_field_handle("samples"), narrowSamples, samplesCount, &result);
+            EXPECT_EQ(result, result_code::ok);
+            for (unsigned int i = 0; i < samplesCount; ++i) {
+                EXPECT_EQ(signedSamples[i], ps.read_ghost<int64_t>(firstBit + i * bitCount, bitCount));
+                EXPECT_EQ(narrowSamples[i], ps.read_ghost<uint16_t>(firstBit + i * bitCount, bitCount));
+            }
+
+            // Writing must only touch bits of the array
+            std::vector<int64_t> written(samplesCount);
+            for (unsigned int i = 0; i < samplesCount; ++i)
+                written[i] = static_cast<int64_t>(i) * 2654435761u - 1000000;
+            protocol_serializer expected(ps);
+            for (unsigned int i = 0; i < samplesCount; ++i)
+                expected.write_ghost(firstBit + i * bitCount, bitCount, written[i]);
+            EXPECT_EQ(ps.write_array("samples", written, samplesCount), result_code::ok);
+            EXPECT_EQ(memcmp(ps.get_working_buffer(), expected.get_working_buffer(), ps.get_internal_buffer_length()), 0);
+        }
+    }
+
+    protocol_serializer ps({{"head", 3}, {"samples", 10 * 12}}, true);
+    std::vector<int16_t> samples(10);
+    EXPECT_EQ(ps.write_array("samples", samples, samples.size()), result_code::not_applicable);
+    EXPECT_EQ(ps.write_array("samples", samples, 0), result_code::bad_input);
+}
+
+// Checks if byte-aligned arrays of exactly sizeof(T) bytes per element (which are copied as a whole) match element-wise writing/reading
+TEST(ReadWrite, ByteAlignedArrays)
+{
+    const unsigned int N = 37;
+    for (int isLittleEndian = 0; isLittleEndian <= 1; ++isLittleEndian) {
+        protocol_serializer ps({{"head", 8}, {"words", 16 * N}, {"dwords", 32 * N}, {"qwords", 64 * N}, {"floats", 32 * N}}, isLittleEndian != 0);
+        std::vector<int16_t> words(N);
+        uint32_t dwords[N];
+        std::unique_ptr<int64_t[]> qwords(new int64_t[N]);
+        std::array<float, N> floats;
+        for (unsigned int i = 0; i < N; ++i) {
+            words[i] = static_cast<int16_t>(i * 1237 - 20000);
+            dwords[i] = i * 2654435761u;
+            qwords[i] = static_cast<int64_t>(i) * -922337203685477LL;
+            floats[i] = static_cast<float>(i) / 7.0f - 2.0f;
+        }
+
+        protocol_serializer expected(ps);
+        const auto writeGhosts = [&expected](const std::string& name, auto& array) {
+            const protocol_serializer::field_metadata metadata = expected.get_field_metadata(name);
+            const unsigned int elementBitCount = metadata.bit_count / N;
+            for (unsigned int i = 0; i < N; ++i)
+                expected.write_ghost(metadata.first_bit_ind + i * elementBitCount, elementBitCount, array[i]);
+        };
+        writeGhosts("words", words);
+        writeGhosts("dwords", dwords);
+        writeGhosts("qwords", qwords);
+        writeGhosts("floats", floats);
+
+        EXPECT_EQ(ps.write_array("words", words, N), result_code::ok);
+        EXPECT_EQ(ps.write_array("dwords", dwords, N), result_code::ok);
+        EXPECT_EQ(ps.write_array("qwords", qwords, N), result_code::ok);
+        EXPECT_EQ(ps.write_array("floats", floats, N), result_code::ok);
+        EXPECT_EQ(memcmp(ps.get_working_buffer(), expected.get_working_buffer(), ps.get_internal_buffer_length()), 0);
+
+        std::vector<int16_t> readWords(N);
+        uint32_t readDwords[N];
+        std::unique_ptr<int64_t[]> readQwords(new int64_t[N]);
+        std::array<float, N> readFloats;
+        ps.read_array("words", readWords, N);
+        ps.read_array("dwords", readDwords, N);
+        ps.read_array("qwords", readQwords, N);
+        ps.read_array("floats", readFloats, N);
+        for (unsigned int i = 0; i < N; ++i) {
+            EXPECT_EQ(readWords[i], words[i]);
+            EXPECT_EQ(readDwords[i], dwords[i]);
+            EXPECT_EQ(readQwords[i], qwords[i]);
+            EXPECT_EQ(readFloats[i], floats[i]);
+        }
+    }
+}
+
+TEST(MessageView, ReadWrite)
+{
+    static_assert(std::is_trivially_copyable<ez::message_view>::value, "View must be trivially copyable");
+    static_assert(std::is_trivially_copyable<ez::const_message_view>::value, "View must be trivially copyable");
+
+    protocol_serializer ps({{"a", 3}, {"b", 13, protocol_serializer::visualization_type::signed_integer}, {"c", 32}, {"d", 32}});
+    const protocol_serializer::layout_ptr_t layout = ps.get_layout();
+    unsigned char first[10] = {};
+    unsigned char second[10] = {};
+    const ez::message_view firstView = ps.make_view(first, sizeof(first));
+    const ez::message_view secondView(*layout, second, sizeof(second));
+
+    EXPECT_EQ(firstView.write("a", 5), result_code::ok);
+    EXPECT_EQ(firstView.write("b", -1000), result_code::ok);
+    EXPECT_EQ(firstView.write("c", 0xDEADBEEFu), result_code::ok);
+    EXPECT_EQ(secondView.write(secondView.get_field_handle("a"), 2), result_code::ok);
+    const uint8_t array[4] = {1, 2, 3, 4};
+    EXPECT_EQ(secondView.write_array("d", array, 4), result_code::ok);
+
+    // Views write exactly what serializer writes into its own buffer
+    ps.write("a", 5);
+    ps.write("b", -1000);
+    ps.write("c", 0xDEADBEEFu);
+    EXPECT_EQ(memcmp(ps.get_internal_buffer().get(), first, sizeof(first)), 0);
+
+    const ez::const_message_view readView = ps.make_view(static_cast<const unsigned char*>(first), sizeof(first));
+    result_code result = result_code::bad_input;
+    EXPECT_EQ(readView.read<int>("b", &result), -1000);
+    EXPECT_EQ(result, result_code::ok);
+    EXPECT_EQ(readView.read<uint32_t>(ps.get_field_handle("c")), 0xDEADBEEFu);
+    EXPECT_EQ(secondView.read<int>("a"), 2);
+    EXPECT_EQ(secondView.read_ghost<int>(0, 3), 2);
+    uint8_t readArray[4] = {};
+    secondView.read_array("d", readArray, 4, &result);
+    EXPECT_EQ(result, result_code::ok);
+    EXPECT_EQ(memcmp(array, readArray, 4), 0);
+
+    // Fields outside of the span and unknown fields are rejected
+    const ez::const_message_view shortView = ps.make_view(static_cast<const unsigned char*>(first), 6);
+    EXPECT_EQ(shortView.read<uint32_t>("c", &result), 0xDEADBEEFu);
+    EXPECT_EQ(result, result_code::ok);
+    shortView.read<uint32_t>("d", &result);
+    EXPECT_EQ(result, result_code::buffer_too_short);
+    EXPECT_EQ(firstView.write("e", 1), result_code::field_not_found);
+    ez::message_view().read<int>("a", &result);
+    EXPECT_EQ(result, result_code::field_not_found);
+
+    // Layout held by a view is not modified by its serializer
+    ps.remove_field("a");
+    EXPECT_EQ(secondView.read<int>("a"), 2);
+}
+
+TEST(MessageView, ConcurrentPackets)
+{
+    const unsigned int packetsCount = 1000;
+    const unsigned int packetLength = 8;
+    protocol_serializer ps({{"id", 20}, {"value", 36, protocol_serializer::visualization_type::signed_integer}, {"flags", 8}});
+    std::vector<unsigned char> packets(packetsCount * packetLength);
+    for (unsigned int i = 0; i < packetsCount; ++i) {
+        const ez::message_view view = ps.make_view(packets.data() + i * packetLength, packetLength);
+        view.write("id", i);
+        view.write("value", -static_cast<int64_t>(i) * 1000);
+        view.write("flags", i % 256);
+    }
+
+    const protocol_serializer::layout_ptr_t layout = ps.get_layout();
+    std::atomic<unsigned int> mismatches(0);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            const protocol_serializer::field_handle value = layout->get_field_handle("value");
+            for (unsigned int i = t; i < packetsCount; i += 4) {
+                const ez::const_message_view view(*layout, packets.data() + i * packetLength, packetLength);
+                if (view.read<uint32_t>("id") != i || view.read<int64_t>(value) != -static_cast<int64_t>(i) * 1000 || view.read<unsigned int>("flags") != i % 256)
+                    ++mismatches;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(mismatches, 0);
+}
+
+TEST(ExternalBuffer, LengthChecks)
+{
+    protocol_serializer ps({{"a", 8}, {"b", 12}, {"c", 20}, {"d", 16}}, false, buffer_source::external);
+    unsigned char packet[7] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77};
+
+    // Short buffer is rejected and previous buffer is kept
+    EXPECT_EQ(ps.set_external_buffer(packet, 6), result_code::buffer_too_short);
+    EXPECT_EQ(ps.get_external_buffer(), nullptr);
+    EXPECT_EQ(ps.set_external_buffer(packet, sizeof(packet)), result_code::ok);
+    EXPECT_EQ(ps.get_external_buffer(), packet);
+    EXPECT_EQ(ps.get_external_buffer_length(), sizeof(packet));
+    EXPECT_EQ(ps.get_available_fields_count(), 4);
+    EXPECT_EQ(ps.read<uint32_t>("d"), 0x6677u);
+
+    // Partial buffer keeps leading fields which are entirely inside of it
+    EXPECT_EQ(ps.set_external_buffer(packet, 4, true), result_code::buffer_too_short);
+    EXPECT_EQ(ps.get_available_fields_count(), 2);
+    result_code result = result_code::ok;
+    EXPECT_EQ(ps.read<uint32_t>("b", &result), 0x223u);
+    EXPECT_EQ(result, result_code::ok);
+    ps.read<uint32_t>("c", &result);
+    EXPECT_EQ(result, result_code::buffer_too_short);
+    ps.read<uint32_t>(ps.get_field_handle("d"), &result);
+    EXPECT_EQ(result, result_code::buffer_too_short);
+    EXPECT_EQ(ps.write("c", 1), result_code::buffer_too_short);
+    uint8_t array[2] = {};
+    EXPECT_EQ(ps.write_array("d", array, 2), result_code::buffer_too_short);
+    ps.read<uint32_t>("e", &result);
+    EXPECT_EQ(result, result_code::field_not_found);
+    EXPECT_TRUE(ps.is_valid_handle(ps.get_field_handle("d")));
+    EXPECT_EQ(ps.get_field_metadata("d").bit_count, 16);
+    EXPECT_EQ(ps.get_data_visualization(protocol_serializer::data_visualization_params().set_bytes_per_line(4)), "1: 11 22 33 44");
+    EXPECT_EQ(memcmp(packet, "\x11\x22\x33\x44\x55\x66\x77", sizeof(packet)), 0);
+
+    // Available fields follow protocol changes and buffer source
+    ps.remove_field("a");
+    EXPECT_EQ(ps.get_available_fields_count(), 2);
+    EXPECT_EQ(ps.read<uint32_t>("c"), 0x23344u);
+    ps.insert_field(0, {"a", 8});
+    EXPECT_EQ(ps.get_available_fields_count(), 2);
+    ps.set_buffer_source(buffer_source::internal);
+    EXPECT_EQ(ps.get_available_fields_count(), 4);
+    EXPECT_EQ(ps.write("d", 1), result_code::ok);
+    ps.set_buffer_source(buffer_source::external);
+    EXPECT_EQ(ps.get_available_fields_count(), 2);
+    ps.set_external_buffer(packet);
+    EXPECT_EQ(ps.get_available_fields_count(), 4);
+}
+
+TEST(RecordFramer, ArbitraryChunks)
+{
+    // 83-bit records take 11 bytes, so they straddle chunks of any size
+    protocol_serializer ps({{"sync", 16}, {"id", 32}, {"value", 35, protocol_serializer::visualization_type::signed_integer}});
+    ASSERT_EQ(ps.get_internal_buffer_length(), 11);
+    const unsigned int recordsCount = 2000;
+    std::vector<unsigned char> stream;
+    for (unsigned int i = 0; i < recordsCount; ++i) {
+        ps.write("sync", 0xA55A);
+        ps.write("id", i);
+        ps.write("value", -static_cast<int64_t>(i) * 3);
+        stream.insert(stream.end(), ps.get_internal_buffer().get(), ps.get_internal_buffer().get() + 11);
+    }
+
+    const unsigned int chunkLengths[] = {1, 2, 7, 11, 64, 100000};
+    for (const unsigned int chunkLength : chunkLengths) {
+        ez::record_framer framer(ps);
+        unsigned int received = 0;
+        unsigned int zeroCopy = 0;
+        bool ordered = true;
+        for (size_t position = 0; position < stream.size(); position += chunkLength) {
+            const size_t length = std::min<size_t>(chunkLength, stream.size() - position);
+            const unsigned char* chunk = stream.data() + position;
+            framer.push(chunk, length, [&](const ez::const_message_view& view) {
+                ordered = ordered && view.read<unsigned int>("id") == received && view.read<int64_t>("value") == -static_cast<int64_t>(received) * 3;
+                zeroCopy += view.get_buffer() >= chunk && view.get_buffer() < chunk + length;
+                ++received;
+            });
+        }
+        EXPECT_EQ(received, recordsCount);
+        EXPECT_TRUE(ordered);
+        EXPECT_EQ(framer.get_pending_length(), 0);
+        if (chunkLength == 100000) {
+            EXPECT_GT(zeroCopy, recordsCount - 3);
+        }
+        if (chunkLength < 11) {
+            EXPECT_EQ(zeroCopy, 0);
+        }
+    }
+}
+
+TEST(RecordFramer, SyncWordResynchronization)
+{
+    protocol_serializer ps({{"sync", 16}, {"id", 16}, {"payload", 40}}, true);
+    std::vector<unsigned char> stream;
+    std::vector<unsigned int> expectedIds;
+    size_t garbageLength = 0;
+    uint32_t seed = 7;
+    for (unsigned int i = 0; i < 500; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        // Garbage never contains sync word, but may look like a record of its own
+        const size_t garbage = (seed >> 16) % 4 == 0 ? (seed >> 8) % 30 : 0;
+        stream.insert(stream.end(), garbage, static_cast<unsigned char>(i % 0x50));
+        garbageLength += garbage;
+
+        ps.write("sync", 0xA55A);
+        ps.write("id", i);
+        ps.write("payload", 0x0102030405ull);
+        stream.insert(stream.end(), ps.get_internal_buffer().get(), ps.get_internal_buffer().get() + ps.get_internal_buffer_length());
+        expectedIds.push_back(i);
+    }
+
+    ez::record_framer framer(ps);
+    EXPECT_EQ(framer.set_sync_word("missing", 1), result_code::field_not_found);
+    EXPECT_EQ(framer.set_sync_word("sync", 0xA55A), result_code::ok);
+    std::vector<unsigned int> ids;
+    for (size_t position = 0, chunk = 1; position < stream.size(); position += chunk, chunk = chunk % 13 + 1)
+        framer.push(stream.data() + position, std::min(chunk, stream.size() - position), [&ids](const ez::const_message_view& view) {
+            ids.push_back(view.read<unsigned int>("id"));
+        });
+
+    EXPECT_EQ(ids, expectedIds);
+    EXPECT_EQ(framer.get_skipped_bytes_count(), garbageLength);
+}
+
+TEST(CaptureReader, MappedRecords)
+{
+    // Capture of 16-byte header and 1000 records of 6 bytes placed 8 bytes apart, with incomplete record at the end
+    protocol_serializer ps({{"id", 20}, {"value", 28}}, false);
+    const TemporaryFile capture("ez_capture_reader_test.bin");
+    const char* path = capture.path.c_str();
+    FILE* file = fopen(path, "wb");
+    ASSERT_NE(file, nullptr);
+    const unsigned char header[16] = {0xFF};
+    fwrite(header, 1, sizeof(header), file);
+    for (unsigned int i = 0; i < 1000; ++i) {
+        ps.write("id", i);
+        ps.write("value", i * 7);
+        const unsigned char padding[2] = {0xEE, 0xEE};
+        fwrite(ps.get_internal_buffer().get(), 1, 6, file);
+        fwrite(padding, 1, 2, file);
+    }
+    fwrite(header, 1, 5, file);
+    fclose(file);
+
+    ez::capture_reader reader(ps);
+    EXPECT_EQ(reader.open(path, ez::capture_reader::capture_params().set_record_stride(4)), result_code::bad_input);
+    EXPECT_EQ(reader.open(::testing::TempDir() + "ez_capture_reader_missing.bin"), result_code::io_error);
+    EXPECT_FALSE(reader.is_open());
+    ASSERT_EQ(reader.open(path, ez::capture_reader::capture_params().set_header_length(16).set_record_stride(8)), result_code::ok);
+    EXPECT_TRUE(reader.is_open());
+    EXPECT_EQ(reader.get_record_length(), 6);
+    EXPECT_EQ(reader.get_file_length(), 16 + 8000 + 5);
+    ASSERT_EQ(reader.get_records_count(), 1000);
+    EXPECT_EQ(reader[999].read<unsigned int>("value"), 999 * 7);
+    EXPECT_EQ(reader[500].get_buffer(), reader.get_data() + 16 + 500 * 8);
+    reader.prefetch(100, 5000);
+
+    unsigned int expected = 0;
+    bool ordered = true;
+    for (const ez::const_message_view record : reader)
+        ordered = ordered && record.read<unsigned int>("id") == expected++;
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(expected, 1000);
+    const ez::capture_reader::iterator found = std::lower_bound(reader.begin(), reader.end(), 700u, [](const ez::const_message_view& record, unsigned int id) {
+        return record.read<unsigned int>("id") < id;
+    });
+    EXPECT_EQ(found - reader.begin(), 700);
+
+    ez::capture_reader moved(std::move(reader));
+    EXPECT_FALSE(reader.is_open());
+    EXPECT_EQ(moved[1].read<unsigned int>("id"), 1);
+    moved.close();
+    EXPECT_EQ(moved.get_records_count(), 0);
+
+    // Empty capture has no records
+    file = fopen(path, "wb");
+    fclose(file);
+    EXPECT_EQ(moved.open(path), result_code::ok);
+    EXPECT_EQ(moved.get_records_count(), 0);
+    EXPECT_EQ(moved.begin(), moved.end());
+    moved.close();
+}
+
+TEST(ParallelDecoder, MatchesColumns)
+{
+    protocol_serializer ps({{"id", 24}, {"value", 37, protocol_serializer::visualization_type::signed_integer}, {"flag", 1}, {"ratio", 32, protocol_serializer::visualization_type::floating_point}});
+    const size_t recordStride = 16;
+    const size_t recordsCount = 100003;
+    std::vector<unsigned char> records(recordStride * recordsCount);
+    for (size_t i = 0; i < recordsCount; ++i) {
+        const ez::message_view record = ps.make_view(records.data() + i * recordStride, recordStride);
+        record.write("id", i);
+        record.write("value", -static_cast<int64_t>(i) * 1001);
+        record.write("flag", i % 3 == 0);
+        record.write("ratio", i * 0.5f);
+    }
+
+    std::vector<uint32_t> expectedIds(recordsCount);
+    std::vector<int64_t> expectedValues(recordsCount);
+    std::vector<float> expectedRatios(recordsCount);
+    ps.read_column("id", records.data(), recordStride, recordsCount, expectedIds.data());
+    ps.read_column("value", records.data(), recordStride, recordsCount, expectedValues.data());
+    ps.read_column("ratio", records.data(), recordStride, recordsCount, expectedRatios.data());
+
+    const unsigned int threadsCounts[] = {1, 3, 8};
+    for (const unsigned int threadsCount : threadsCounts) {
+        ez::parallel_decoder decoder(ps.get_layout(), ps.get_is_little_endian(), threadsCount);
+        EXPECT_EQ(decoder.get_threads_count(), threadsCount);
+        decoder.set_chunk_length(4096);
+        std::vector<uint32_t> ids(recordsCount);
+        std::vector<int64_t> values(recordsCount);
+        std::vector<float> ratios(recordsCount);
+        EXPECT_EQ(decoder.add_column("id", ids.data()), result_code::ok);
+        EXPECT_EQ(decoder.add_column(ps.get_field_handle("value"), values.data()), result_code::ok);
+        EXPECT_EQ(decoder.add_column("ratio", ratios.data()), result_code::ok);
+        EXPECT_EQ(decoder.add_column("missing", ids.data()), result_code::field_not_found);
+        EXPECT_EQ(decoder.add_column("flag", ratios.data()), result_code::not_applicable);
+
+        // Decoder is reusable
+        for (int run = 0; run < 3; ++run) {
+            std::fill(ids.begin(), ids.end(), 0);
+            EXPECT_EQ(decoder.decode(records.data(), recordStride, recordsCount), result_code::ok);
+            EXPECT_EQ(ids, expectedIds);
+            EXPECT_EQ(values, expectedValues);
+            EXPECT_EQ(ratios, expectedRatios);
+        }
+        EXPECT_EQ(decoder.decode(nullptr, recordStride, recordsCount), result_code::bad_input);
+    }
+}
+
+TEST(RecordFilter, MatchesScalarPredicate)
+{
+    using ez::record_predicate;
+    protocol_serializer ps({{"msg_type", 5}, {"value", 19, protocol_serializer::visualization_type::signed_integer},
+                            {"status", 12}, {"ratio", 32, protocol_serializer::visualization_type::floating_point}});
+    const size_t recordStride = 9;
+    const size_t recordsCount = 10007;
+    std::vector<unsigned char> records(recordStride * recordsCount);
+    for (size_t i = 0; i < recordsCount; ++i) {
+        const ez::message_view record = ps.make_view(records.data() + i * recordStride, recordStride);
+        record.write("msg_type", i % 11);
+        record.write("value", static_cast<int64_t>(i % 2001) - 1000);
+        record.write("status", (i * 7) % 4096);
+    }
+
+    const record_predicate predicate = (record_predicate::equal("msg_type", 7) && record_predicate::any_bits("status", 0x4)) ||
+                                       (record_predicate::in_range("value", -20, 5) && record_predicate::all_bits("status", 0x3));
+    std::vector<uint64_t> expected;
+    for (size_t i = 0; i < recordsCount; ++i) {
+        const int64_t value = static_cast<int64_t>(i % 2001) - 1000;
+        const size_t status = (i * 7) % 4096;
+        if ((i % 11 == 7 && (status & 0x4)) || (value >= -20 && value <= 5 && (status & 0x3) == 0x3))
+            expected.push_back(i);
+    }
+    ASSERT_FALSE(expected.empty());
+
+    ez::record_filter filter(ps);
+    std::vector<uint64_t> selection;
+    EXPECT_EQ(filter.select(records.data(), recordStride, recordsCount, selection), result_code::not_applicable);
+    EXPECT_EQ(filter.set_predicate(predicate), result_code::ok);
+    EXPECT_EQ(filter.select(records.data(), recordStride, recordsCount, selection), result_code::ok);
+    EXPECT_EQ(selection, expected);
+
+    // Selection is appended to
+    EXPECT_EQ(filter.select(records.data(), recordStride, 300, selection), result_code::ok);
+    EXPECT_EQ(selection.size(), expected.size() + (std::lower_bound(expected.begin(), expected.end(), 300) - expected.begin()));
+    EXPECT_EQ(filter.select(nullptr, recordStride, recordsCount, selection), result_code::bad_input);
+
+    // Failed compilation keeps previous predicate
+    EXPECT_EQ(filter.set_predicate(record_predicate::equal("missing", 1)), result_code::field_not_found);
+    EXPECT_EQ(filter.set_predicate(record_predicate::equal("ratio", 1)), result_code::not_applicable);
+    EXPECT_EQ(filter.set_predicate(record_predicate()), result_code::bad_input);
+    selection.clear();
+    EXPECT_EQ(filter.select(records.data(), recordStride, recordsCount, selection), result_code::ok);
+    EXPECT_EQ(selection, expected);
+}
+
+TEST(Projection, MatchesRead)
+{
+    for (const bool isLittleEndian : {false, true}) {
+        protocol_serializer ps({{"a", 8}, {"b", 3}, {"c", 24, protocol_serializer::visualization_type::signed_integer}, {"d", 16},
+                                {"pad", 7}, {"e", 64}, {"f", 1}, {"ratio", 32, protocol_serializer::visualization_type::floating_point}}, isLittleEndian);
+        std::vector<unsigned char> buffer(ps.get_internal_buffer_length());
+        for (size_t i = 0; i < buffer.size(); ++i)
+            buffer[i] = static_cast<unsigned char>(i * 97 + 13);
+        ps.set_buffer_source(buffer_source::external);
+        ps.set_external_buffer(buffer.data(), buffer.size());
+        ps.write("ratio", 2.5f);
+
+        // Fields are listed out of order, "e" is an unaligned 64-bit field which touches 9 bytes
+        ez::projection<int32_t, uint8_t, uint64_t, float, bool, uint16_t> p(ps);
+        std::tuple<int32_t, uint8_t, uint64_t, float, bool, uint16_t> values;
+        EXPECT_EQ(p.decode(buffer.data(), buffer.size(), values), result_code::not_applicable);
+        EXPECT_EQ(p.set_fields({"c", "a", "e", "ratio", "f", "d"}), result_code::ok);
+        EXPECT_EQ(p.get_windows_count(), 3u); // {a, c, d}, {e}, {f, ratio}
+        EXPECT_EQ(p.get_required_length(), buffer.size());
+
+        EXPECT_EQ(p.decode(buffer.data(), buffer.size(), values), result_code::ok);
+        EXPECT_EQ(std::get<0>(values), ps.read<int32_t>("c"));
+        EXPECT_EQ(std::get<1>(values), ps.read<uint8_t>("a"));
+        EXPECT_EQ(std::get<2>(values), ps.read<uint64_t>("e"));
+        EXPECT_EQ(std::get<3>(values), 2.5f);
+        EXPECT_EQ(std::get<4>(values), ps.read<bool>("f"));
+        EXPECT_EQ(std::get<5>(values), ps.read<uint16_t>("d"));
+
+        // Struct members are decoded through references
+        struct { int32_t c; uint8_t a; uint64_t e; float ratio; bool f; uint16_t d; } record = {};
+        EXPECT_EQ(p.decode(buffer.data(), buffer.size(), record.c, record.a, record.e, record.ratio, record.f, record.d), result_code::ok);
+        EXPECT_EQ(record.e, std::get<2>(values));
+        EXPECT_EQ(record.c, std::get<0>(values));
+
+        EXPECT_EQ(p.decode(buffer.data(), buffer.size() - 1, values), result_code::buffer_too_short);
+        EXPECT_EQ(p.decode(nullptr, buffer.size(), values), result_code::bad_input);
+        EXPECT_EQ(p.set_fields({"c", "a", "missing", "ratio", "f", "d"}), result_code::field_not_found);
+        EXPECT_EQ(p.set_fields({"c", "a", "e", "b", "f", "d"}), result_code::not_applicable);
+    }
+}
+
+TEST(Stats, Counters)
+{
+    protocol_serializer ps({{"a", 8}, {"b", 12, protocol_serializer::visualization_type::signed_integer}, {"c", 16}});
+    ps.write("a", 1);
+    ps.read<int16_t>("b");
+    ps.read<uint16_t>(ps.get_field_handle("c"));
+    ps.read<int>("missing");
+    ps.read_ghost<uint8_t>(0, 8);
+
+    ez::serializer_stats stats = ps.get_stats();
+#ifdef EZ_PROTOCOL_SERIALIZER_STATS
+    ASSERT_TRUE(stats.is_enabled);
+    ASSERT_EQ(stats.fields.size(), 3u);
+    EXPECT_EQ(stats.fields[1].name, "b");
+    EXPECT_EQ(stats.total.reads, 3u);
+    EXPECT_EQ(stats.total.writes, 1u);
+    EXPECT_EQ(stats.total.shifted_accesses, 2u);
+    EXPECT_EQ(stats.total.sign_extensions, 1u);
+    EXPECT_EQ(stats.total.bytes_touched, 7u);
+    EXPECT_EQ(stats.fields[0].values.writes, 1u);
+    EXPECT_EQ(stats.fields[1].values.sign_extensions, 1u);
+    EXPECT_EQ(stats.fields[2].values.bytes_touched, 3u);
+    EXPECT_EQ(stats.lookup_misses, 1u);
+    EXPECT_GE(stats.reallocations, 1u);
+
+    // Every thread counts into its own shard, shards are merged by snapshot
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 2; ++t) {
+        threads.emplace_back([&ps]() {
+            for (int i = 0; i < 1000; ++i)
+                ps.read<uint16_t>("c");
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    stats = ps.get_stats();
+    EXPECT_EQ(stats.total.reads, 2003u);
+    EXPECT_EQ(stats.fields[2].values.reads, 2001u);
+    EXPECT_NE(stats.to_json().find("{\"name\": \"c\", \"reads\": 2001"), std::string::npos);
+    EXPECT_NE(stats.to_text().find("c: reads 2001"), std::string::npos);
+
+    // Serializers used in turns keep their own counters, shards of exited threads keep counting for the next ones
+    protocol_serializer other({{"x", 8}});
+    for (int t = 0; t < 3; ++t) {
+        std::thread([&ps, &other]() {
+            for (int i = 0; i < 100; ++i) {
+                ps.read<uint8_t>("a");
+                other.read<uint8_t>("x");
+            }
+        }).join();
+    }
+    EXPECT_EQ(ps.get_stats().fields[0].values.reads, 300u);
+    EXPECT_EQ(other.get_stats().total.reads, 300u);
+
+    ps.reset_stats();
+    ps.read<uint8_t>("a");
+    stats = ps.get_stats();
+    EXPECT_EQ(stats.total.reads, 1u);
+    EXPECT_EQ(stats.fields[2].values.reads, 0u);
+    EXPECT_EQ(stats.lookup_misses, 0u);
+    EXPECT_EQ(stats.reallocations, 0u);
+
+    // Copy counts on its own
+    const protocol_serializer copy(ps);
+    copy.read<uint8_t>("a");
+    EXPECT_EQ(copy.get_stats().total.reads, 1u);
+    EXPECT_EQ(ps.get_stats().total.reads, 1u);
+#else
+    EXPECT_FALSE(stats.is_enabled);
+    EXPECT_TRUE(stats.fields.empty());
+    EXPECT_EQ(stats.total.reads, 0u);
+    EXPECT_EQ(stats.to_json().find("\"enabled\": false"), 1u);
+#endif
+}
+
+TEST(RecordPlan, MatchesFieldAccess)
+{
+    using vt = protocol_serializer::visualization_type;
+    for (const bool isLittleEndian : {false, true}) {
+        // "e" is an unaligned 64-bit field which touches 9 bytes, "wide" can not be accessed and is skipped
+        protocol_serializer ps({{"a", 3}, {"b", 5, vt::signed_integer}, {"c", 8}, {"d", 16, vt::signed_integer}, {"f", 1}, {"e", 64},
+                                {"wide", 80}, {"h", 32, vt::floating_point}, {"i", 7, vt::signed_integer}, {"j", 24}}, isLittleEndian);
+        const size_t length = ps.get_internal_buffer_length();
+        std::vector<unsigned char> original(length);
+        for (size_t i = 0; i < length; ++i)
+            original[i] = static_cast<unsigned char>(i * 89 + 7);
+        ps.set_buffer_source(buffer_source::external);
+        ps.set_external_buffer(original.data(), length);
+        ps.write("h", -1.75f);
+
+        const ez::record_plan plan(ps);
+        EXPECT_EQ(plan.get_fields_count(), 10u);
+        EXPECT_EQ(plan.get_record_length(), length);
+        EXPECT_EQ(plan.get_windows_count(), 3u); // {a, b, c, d, f}, {e}, {h, i, j}
+
+        std::vector<uint64_t> values(plan.get_fields_count(), 1);
+        EXPECT_EQ(plan.decode(original.data(), length, values.data()), result_code::ok);
+        const auto expected = [&ps](const std::string& name) {
+            const protocol_serializer::field_metadata metadata = ps.get_field_metadata(name);
+            if (metadata.vis_type == vt::signed_integer)
+                return static_cast<uint64_t>(ps.read<int64_t>(name));
+            return ps.read<uint64_t>(name);
+        };
+        EXPECT_EQ(values[0], expected("a"));
+        EXPECT_EQ(values[1], expected("b"));
+        EXPECT_EQ(values[2], expected("c"));
+        EXPECT_EQ(values[3], expected("d"));
+        EXPECT_EQ(values[4], expected("f"));
+        EXPECT_EQ(values[5], expected("e"));
+        EXPECT_EQ(values[6], 0u);
+        float h = 0;
+        const uint32_t hBits = static_cast<uint32_t>(values[7]);
+        memcpy(&h, &hBits, 4);
+        EXPECT_EQ(h, -1.75f);
+        EXPECT_EQ(values[8], expected("i"));
+        EXPECT_EQ(values[9], expected("j"));
+
+        // Encoding matches writing field by field, skipped field is left intact
+        const std::vector<uint64_t> newValues = {5, static_cast<uint64_t>(-7), 200, static_cast<uint64_t>(-12345), 1, 0xFEDCBA9876543210ull, 99,
+                                                 0, static_cast<uint64_t>(-64), 0xABCDEF};
+        std::vector<unsigned char> encoded = original;
+        std::vector<unsigned char> written = original;
+        float newH = 3.5f;
+        uint32_t newHBits = 0;
+        memcpy(&newHBits, &newH, 4);
+        std::vector<uint64_t> encodedValues = newValues;
+        encodedValues[7] = newHBits;
+        EXPECT_EQ(plan.encode(encodedValues.data(), encoded.data(), length), result_code::ok);
+        ps.set_external_buffer(written.data(), length);
+        const char* names[] = {"a", "b", "c", "d", "f", "e"};
+        for (size_t i = 0; i < 6; ++i)
+            ps.write(names[i], newValues[i]);
+        ps.write("h", newH);
+        ps.write("i", newValues[8]);
+        ps.write("j", newValues[9]);
+        EXPECT_EQ(encoded, written);
+
+        EXPECT_EQ(plan.decode(original.data(), length - 1, values.data()), result_code::buffer_too_short);
+        EXPECT_EQ(plan.encode(values.data(), nullptr, length), result_code::bad_input);
+    }
+}
+
+TEST(StructBinding, EncodeDecode)
+{
+    using vt = protocol_serializer::visualization_type;
+    struct quote
+    {
+        uint8_t  type;
+        int16_t  value;
+        uint64_t id;
+        double   price;
+        bool     flag;
+    };
+
+    protocol_serializer ps({{"type", 4}, {"skipped", 5}, {"value", 11, vt::signed_integer}, {"flag", 1}, {"id", 64}, {"px", 64, vt::floating_point}});
+    ez::struct_binding<quote> binding(ps);
+    binding.bind(EZ_BIND(quote, type)).bind(EZ_BIND(quote, value)).bind(EZ_BIND(quote, id)).bind("px", &quote::price).bind(EZ_BIND(quote, flag));
+    EXPECT_EQ(binding.get_result(), result_code::ok);
+    EXPECT_FALSE(binding.get_is_memcpy());
+
+    std::vector<unsigned char> buffer(ps.get_internal_buffer_length(), 0xA5);
+    const quote original = {9, -1000, 0x0123456789ABCDEFull, 2.25, true};
+    EXPECT_EQ(binding.encode(original, buffer.data(), buffer.size()), result_code::ok);
+    ps.set_buffer_source(buffer_source::external);
+    ps.set_external_buffer(buffer.data(), buffer.size());
+    EXPECT_EQ(ps.read<uint8_t>("type"), 9);
+    EXPECT_EQ(ps.read<uint8_t>("skipped"), 0x0B); // Unbound field keeps its bits
+    EXPECT_EQ(ps.read<int16_t>("value"), -1000);
+    EXPECT_EQ(ps.read<uint64_t>("id"), 0x0123456789ABCDEFull);
+    EXPECT_EQ(ps.read<double>("px"), 2.25);
+    EXPECT_TRUE(ps.read<bool>("flag"));
+
+    quote decoded = {};
+    EXPECT_EQ(binding.decode(buffer.data(), buffer.size(), decoded), result_code::ok);
+    EXPECT_EQ(decoded.type, original.type);
+    EXPECT_EQ(decoded.value, original.value);
+    EXPECT_EQ(decoded.id, original.id);
+    EXPECT_EQ(decoded.price, original.price);
+    EXPECT_EQ(decoded.flag, original.flag);
+    EXPECT_EQ(binding.decode(buffer.data(), buffer.size() - 1, decoded), result_code::buffer_too_short);
+
+    EXPECT_EQ(ez::struct_binding<quote>(ps).bind("missing", &quote::id).get_result(), result_code::field_not_found);
+    EXPECT_EQ(ez::struct_binding<quote>(ps).bind("id", &quote::type).bind("type", &quote::price).get_result(), result_code::not_applicable);
+}
+
+TEST(StructBinding, MemcpyLayout)
+{
+    using vt = protocol_serializer::visualization_type;
+    struct sample
+    {
+        uint32_t a;
+        uint16_t b;
+        int16_t  c;
+        float    d;
+    };
+
+    // Binding falls back to field by field copy when byte order differs from host one
+    for (const bool isLittleEndian : {false, true}) {
+        protocol_serializer ps({{"header", 8}, {"a", 32}, {"b", 16}, {"c", 16, vt::signed_integer}, {"d", 32, vt::floating_point}, {"trailer", 8}}, isLittleEndian);
+        ez::struct_binding<sample> binding(ps);
+        binding.bind(EZ_BIND(sample, d)).bind(EZ_BIND(sample, a)).bind(EZ_BIND(sample, b)).bind(EZ_BIND(sample, c));
+        EXPECT_EQ(binding.get_is_memcpy(), isLittleEndian == protocol_serializer::get_is_host_little_endian());
+        EXPECT_EQ(binding.get_required_length(), 13u);
+
+        std::vector<unsigned char> buffer(ps.get_internal_buffer_length(), 0x11);
+        const sample original = {0xDEADBEEF, 0x1234, -2, 0.5f};
+        EXPECT_EQ(binding.encode(original, buffer.data(), buffer.size()), result_code::ok);
+        ps.set_buffer_source(buffer_source::external);
+        ps.set_external_buffer(buffer.data(), buffer.size());
+        EXPECT_EQ(ps.read<uint8_t>("header"), 0x11);
+        EXPECT_EQ(ps.read<uint32_t>("a"), 0xDEADBEEF);
+        EXPECT_EQ(ps.read<uint16_t>("b"), 0x1234);
+        EXPECT_EQ(ps.read<int16_t>("c"), -2);
+        EXPECT_EQ(ps.read<float>("d"), 0.5f);
+        EXPECT_EQ(ps.read<uint8_t>("trailer"), 0x11);
+
+        sample decoded = {};
+        EXPECT_EQ(binding.decode(buffer.data(), buffer.size(), decoded), result_code::ok);
+        EXPECT_EQ(memcmp(&decoded, &original, sizeof(sample)), 0);
+    }
+}
+
+TEST(WideFields, BytesAndUint128)
+{
+    // Same bits are described once as wide fields and once as 64-bit pieces
+    protocol_serializer ps({{"head", 3}, {"wide", 256}, {"odd", 100}, {"tail", 5}});
+    protocol_serializer pieces({{"head", 3}, {"w0", 64}, {"w1", 64}, {"w2", 64}, {"w3", 64}, {"o0", 36}, {"o1", 64}, {"tail", 5}});
+    EXPECT_EQ(ps.get_internal_buffer_length(), pieces.get_internal_buffer_length());
+    std::vector<unsigned char> buffer(ps.get_internal_buffer_length(), 0);
+    ps.set_buffer_source(buffer_source::external);
+    ps.set_external_buffer(buffer.data(), buffer.size());
+    pieces.set_buffer_source(buffer_source::external);
+    pieces.set_external_buffer(buffer.data(), buffer.size());
+
+    EXPECT_EQ(ps.write("head", 5), result_code::ok);
+    EXPECT_EQ(ps.write("tail", 0x1F), result_code::ok);
+    std::array<unsigned char, 32> wide;
+    for (size_t i = 0; i < wide.size(); ++i)
+        wide[i] = static_cast<unsigned char>(0xA0 + i);
+    EXPECT_EQ(ps.write_bytes("wide", wide.data(), wide.size()), result_code::ok);
+    EXPECT_EQ(pieces.read<uint64_t>("w0"), 0xA0A1A2A3A4A5A6A7ull);
+    EXPECT_EQ(pieces.read<uint64_t>("w3"), 0xB8B9BABBBCBDBEBFull);
+    std::array<unsigned char, 32> wideRead = {};
+    EXPECT_EQ(ps.read_bytes(ps.get_field_handle("wide"), wideRead.data(), wideRead.size()), result_code::ok);
+    EXPECT_EQ(wideRead, wide);
+
+    // Bits above 100 in the first byte are not part of the field
+    std::array<unsigned char, 13> odd;
+    for (size_t i = 0; i < odd.size(); ++i)
+        odd[i] = static_cast<unsigned char>(0x31 * (i + 1));
+    EXPECT_EQ(ps.write_bytes("odd", odd.data(), odd.size()), result_code::ok);
+    EXPECT_EQ(pieces.read<uint64_t>("o0"), 0x16293C4F5ull);
+    EXPECT_EQ(pieces.read<uint64_t>("o1"), 0x265788B9EA1B4C7Dull);
+    std::array<unsigned char, 13> oddRead = {};
+    EXPECT_EQ(ps.read_bytes("odd", oddRead.data(), oddRead.size()), result_code::ok);
+    EXPECT_EQ(oddRead[0], odd[0] & 0x0F);
+    EXPECT_TRUE(std::equal(oddRead.begin() + 1, oddRead.end(), odd.begin() + 1));
+    EXPECT_EQ(ps.read<uint8_t>("head"), 5);
+    EXPECT_EQ(ps.read<uint8_t>("tail"), 0x1F);
+
+    EXPECT_EQ(ps.read_bytes("odd", oddRead.data(), oddRead.size() - 1), result_code::bad_input);
+    EXPECT_EQ(ps.write_bytes("missing", odd.data(), odd.size()), result_code::field_not_found);
+    const ez::const_message_view view = ps.make_view(static_cast<const unsigned char*>(buffer.data()), buffer.size());
+    EXPECT_EQ(view.read_bytes("wide", wideRead.data(), wideRead.size()), result_code::ok);
+    EXPECT_EQ(wideRead, wide);
+    const ez::const_message_view shortView = ps.make_view(static_cast<const unsigned char*>(buffer.data()), 20);
+    EXPECT_EQ(shortView.read_bytes("odd", oddRead.data(), oddRead.size()), result_code::buffer_too_short);
+
+#ifdef EZ_PROTOCOL_SERIALIZER_INT128
+    const ez::uint128_t value = (ez::uint128_t(0x0123456789ABCDEFull) << 36) | 0xFEDCBA987ull;
+    EXPECT_EQ(ps.write_uint128("odd", value), result_code::ok);
+    result_code result;
+    EXPECT_TRUE(ps.read_uint128("odd", &result) == value);
+    EXPECT_EQ(result, result_code::ok);
+    EXPECT_EQ(pieces.read<uint64_t>("o1"), 0x9ABCDEFFEDCBA987ull);
+    ps.read_uint128("wide", &result);
+    EXPECT_EQ(result, result_code::not_applicable);
+
+    // Little-endian fields keep their least significant byte first
+    protocol_serializer le({{"flag", 8}, {"id", 128}, {"short", 72}}, true);
+    EXPECT_EQ(le.write_uint128("id", value), result_code::ok);
+    EXPECT_EQ(le.read<uint8_t>("flag"), 0);
+    EXPECT_TRUE(le.read_uint128("id") == value);
+    EXPECT_EQ(le.get_internal_buffer()[1], 0x87);
+    EXPECT_EQ(le.write_uint128("short", ez::uint128_t(0xAB) << 64 | 0x1122334455667788ull), result_code::ok);
+    EXPECT_EQ(le.get_internal_buffer()[17], 0x88);
+    EXPECT_EQ(le.get_internal_buffer()[25], 0xAB);
+    EXPECT_TRUE(le.read_uint128("short") == (ez::uint128_t(0xAB) << 64 | 0x1122334455667788ull));
+#endif
+}
+
+TEST(VariableLength, LengthPrefixedFields)
+{
+    using vt = protocol_serializer::visualization_type;
+    protocol_serializer ps({{"type", 4}, {"length", 12}, {"payload", 8, vt::unsigned_integer, "length"}, {"checksum", 16},
+                            {"count", 3}, {"items", 5, vt::unsigned_integer, "count"}, {"tail", 5}});
+    ps.set_buffer_source(buffer_source::external);
+
+    // Payload of 3 bytes, 2 items of 5 bits
+    std::vector<unsigned char> buffer = {0x10, 0x03, 0xAA, 0xBB, 0xCC, 0x12, 0x34, 0x47, 0x4D, 0x40};
+    EXPECT_EQ(ps.set_external_buffer(buffer.data(), buffer.size()), result_code::ok);
+    EXPECT_EQ(ps.get_available_fields_count(), 7u);
+    EXPECT_EQ(ps.read<uint16_t>("checksum"), 0x1234);
+    EXPECT_EQ(ps.read<uint32_t>("payload"), 0xAABBCCu);
+    std::array<unsigned char, 3> payload = {};
+    EXPECT_EQ(ps.read_bytes("payload", payload.data(), payload.size()), result_code::ok);
+    EXPECT_EQ(payload, (std::array<unsigned char, 3>{0xAA, 0xBB, 0xCC}));
+    std::array<uint8_t, 2> items = {};
+    ps.read_array(ps.get_field_handle("items"), items, items.size());
+    EXPECT_EQ(items, (std::array<uint8_t, 2>{7, 9}));
+    EXPECT_EQ(ps.read<uint8_t>("tail"), 0x15);
+    EXPECT_EQ(ps.get_field_metadata("checksum").first_bit_ind, 40u);
+
+    // Fields which do not fit into partial buffer are not available
+    EXPECT_EQ(ps.set_external_buffer(buffer.data(), 9, true), result_code::ok);
+    result_code result;
+    ps.read<uint8_t>("tail", &result);
+    EXPECT_EQ(result, result_code::buffer_too_short);
+    EXPECT_EQ(ps.read<uint16_t>("checksum"), 0x1234);
+    EXPECT_EQ(ps.get_available_fields_count(), 6u);
+
+    // Offsets are cached till the buffer changes through the serializer or offsets are invalidated
+    buffer[1] = 0x01;
+    EXPECT_EQ(ps.read<uint16_t>("checksum"), 0x1234);
+    ps.invalidate_offsets();
+    EXPECT_EQ(ps.read<uint16_t>("checksum"), 0xBBCC);
+    EXPECT_EQ(ps.write("length", 3), result_code::ok);
+    EXPECT_EQ(ps.read<uint16_t>("checksum"), 0x1234);
+
+    // Only fields at fixed offsets are known to the layout
+    EXPECT_NE(ps.get_layout()->find_metadata("length"), nullptr);
+    EXPECT_EQ(ps.get_layout()->find_metadata("checksum"), nullptr);
+    ps.make_view(static_cast<const unsigned char*>(buffer.data()), buffer.size()).read<uint16_t>("checksum", &result);
+    EXPECT_EQ(result, result_code::field_not_found);
+
+    // Internal buffer grows along with lengths written into it
+    ps.set_buffer_source(buffer_source::internal);
+    EXPECT_EQ(ps.get_internal_buffer_length(), 5u);
+    EXPECT_EQ(ps.write("length", 2), result_code::ok);
+    EXPECT_EQ(ps.get_internal_buffer_length(), 7u);
+    const unsigned char bytes[2] = {0x01, 0x02};
+    EXPECT_EQ(ps.write_bytes("payload", bytes, 2), result_code::ok);
+    EXPECT_EQ(ps.write("checksum", 0xBEEF), result_code::ok);
+    EXPECT_EQ(ps.get_internal_buffer()[2], 0x01);
+    EXPECT_EQ(ps.get_internal_buffer()[4], 0xBE);
+    EXPECT_EQ(ps.read<uint16_t>("checksum"), 0xBEEF);
+
+    // Length field has to precede its field and has to stay
+    protocol_serializer copy;
+    EXPECT_EQ(copy.append_protocol(ps), result_code::ok);
+    EXPECT_EQ(copy.get_layout()->variable_fields.size(), 2u);
+    EXPECT_EQ(copy.append_field({"bad", 8, vt::unsigned_integer, "missing"}), result_code::field_not_found);
+    EXPECT_EQ(copy.insert_field(1, {"early", 8, vt::unsigned_integer, "length"}), result_code::field_not_found);
+    EXPECT_EQ(copy.append_field({"nested", 8, vt::unsigned_integer, "payload"}), result_code::not_applicable);
+    EXPECT_EQ(copy.remove_field("count"), result_code::not_applicable);
+    EXPECT_EQ(copy.remove_field("items"), result_code::ok);
+    EXPECT_EQ(copy.remove_field("count"), result_code::ok);
+    EXPECT_EQ(copy.get_layout()->variable_fields.size(), 1u);
+
+    // Edits keep values of payloads and fields after them
+    protocol_serializer edited({{"a", 8}, {"len", 8}, {"data", 8, vt::unsigned_integer, "len"}, {"tail", 8}});
+    EXPECT_EQ(edited.write("len", 2), result_code::ok);
+    const unsigned char data[2] = {0x11, 0x22};
+    EXPECT_EQ(edited.write_bytes("data", data, 2), result_code::ok);
+    EXPECT_EQ(edited.write("tail", 0x77), result_code::ok);
+    EXPECT_EQ(edited.insert_field(0, {"pre", 8}), result_code::ok);
+    EXPECT_EQ(edited.insert_field(3, {"mid", 4}), result_code::ok);
+    EXPECT_EQ(edited.read<uint8_t>("len"), 2);
+    EXPECT_EQ(edited.read<uint8_t>("tail"), 0x77);
+    EXPECT_EQ(edited.read<uint8_t>("mid"), 0);
+    unsigned char read_data[2] = {};
+    EXPECT_EQ(edited.read_bytes("data", read_data, 2), result_code::ok);
+    EXPECT_EQ(read_data[1], 0x22);
+    EXPECT_EQ(edited.remove_field("mid"), result_code::ok);
+    EXPECT_EQ(edited.remove_field("pre"), result_code::ok);
+    EXPECT_EQ(edited.remove_field("a"), result_code::ok);
+    EXPECT_EQ(edited.read<uint8_t>("tail"), 0x77);
+    EXPECT_EQ(edited.read_bytes("data", read_data, 2), result_code::ok);
+    EXPECT_EQ(read_data[0], 0x11);
+    EXPECT_EQ(edited.get_field_metadata("tail").first_bit_ind, 24u);
+}
+
+TEST(Groups, RepeatedSubProtocol)
+{
+    using vt = protocol_serializer::visualization_type;
+    const protocol_serializer sample({{"id", 4}, {"temp", 12, vt::signed_integer}});
+    protocol_serializer ps({{"count", 4, vt::signed_integer}});
+    EXPECT_EQ(ps.append_group("samples", sample, 3), result_code::ok);
+    EXPECT_EQ(ps.append_field({"crc", 8}), result_code::ok);
+
+    // Group is a single field, its elements are not flattened
+    EXPECT_EQ(ps.get_fields_list().size(), 3u);
+    EXPECT_EQ(ps.get_field_metadata("samples").bit_count, 48u);
+    EXPECT_EQ(ps.get_field_metadata("crc").first_bit_ind, 52u);
+    EXPECT_EQ(ps.get_layout()->groups.front().layout, sample.get_layout());
+
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(ps.write("samples", i, "id", i + 1), result_code::ok);
+        EXPECT_EQ(ps.write("samples", i, "temp", -100 * i), result_code::ok);
+    }
+    EXPECT_EQ(ps.write("crc", 0xA5), result_code::ok);
+    EXPECT_EQ(ps.get_internal_buffer()[0], 0x01);
+    EXPECT_EQ(ps.get_internal_buffer()[2], 0x02);
+    EXPECT_EQ(ps.read<int>("samples", 2, "temp"), -200);
+    EXPECT_EQ(ps.read<uint8_t>("crc"), 0xA5);
+
+    const protocol_serializer::field_handle samples = ps.get_field_handle("samples");
+    const protocol_serializer::field_handle id = ps.get_group_field_handle("samples", "id");
+    EXPECT_EQ(ps.read<int>(samples, 1, id), 2);
+    EXPECT_EQ(ps.read<int>(samples, 1, sample.get_field_handle("temp")), -100);
+
+    result_code result;
+    ps.read<int>("samples", 3, "id", &result);
+    EXPECT_EQ(result, result_code::bad_input);
+    ps.read<int>("samples", 0, "missing", &result);
+    EXPECT_EQ(result, result_code::field_not_found);
+    ps.read<int>("crc", 0, "id", &result);
+    EXPECT_EQ(result, result_code::not_applicable);
+
+    // Groups follow their fields through layout edits and appended protocols
+    EXPECT_EQ(ps.insert_field(0, {"version", 8}), result_code::ok);
+    EXPECT_EQ(ps.read<int>("samples", 2, "id"), 3);
+    protocol_serializer copy({{"header", 3}});
+    EXPECT_EQ(copy.append_protocol(ps), result_code::ok);
+    EXPECT_EQ(copy.get_field_metadata("count").vis_type, vt::signed_integer);
+    EXPECT_EQ(copy.write("samples", 1, "temp", 7), result_code::ok);
+    EXPECT_EQ(copy.read<int>("samples", 1, "temp"), 7);
+    EXPECT_EQ(ps.remove_field("samples"), result_code::ok);
+    EXPECT_TRUE(ps.get_layout()->groups.empty());
+
+    const protocol_serializer with_length({{"length", 8}, {"payload", 8, vt::unsigned_integer, "length"}});
+    EXPECT_EQ(ps.append_group("variable", with_length), result_code::not_applicable);
+    EXPECT_EQ(ps.append_group("empty", sample, 0), result_code::bad_input);
+}
+
+TEST(SchemaLoader, TextAndSnapshot)
+{
+    using vt = protocol_serializer::visualization_type;
+    const std::string schema = "# Telemetry header\n"
+                               "byte_order little\n"
+                               "type     8\n"
+                               "length   16   unsigned\n"
+                               "payload  8    length=length   # Bytes\n"
+                               "\n"
+                               "reading  32   float\n"
+                               "offset   16   signed\n";
+    ez::schema_loader loader;
+    protocol_serializer ps;
+    ASSERT_EQ(loader.parse(schema, ps), result_code::ok);
+    EXPECT_TRUE(ps.get_is_little_endian());
+    EXPECT_EQ(ps.get_fields_list(), (protocol_serializer::fields_list_t{"type", "length", "payload", "reading", "offset"}));
+    EXPECT_EQ(ps.get_layout()->variable_fields.size(), 1u);
+    EXPECT_EQ(ps.get_field_metadata("offset").vis_type, vt::signed_integer);
+
+    // Invalid schema reports its line and leaves protocol intact
+    protocol_serializer other({{"kept", 8}});
+    EXPECT_EQ(loader.parse("a 8\nb eight\n", other), result_code::bad_input);
+    EXPECT_EQ(loader.get_error_line(), 2u);
+    EXPECT_EQ(loader.parse("a 8\na 4\n", other), result_code::bad_input);
+    EXPECT_EQ(loader.parse("a 8 length=missing\n", other), result_code::field_not_found);
+    EXPECT_EQ(loader.parse("byte_order middle\n", other), result_code::bad_input);
+    EXPECT_EQ(other.get_fields_list(), (protocol_serializer::fields_list_t{"kept"}));
+
+    // Variable-length schema replaces a shorter protocol, whose buffer must not be used to resolve offsets
+    protocol_serializer shorter({{"a", 1}, {"b", 1}, {"c", 1}, {"d", 1}});
+    ASSERT_EQ(loader.parse("x 64\ny 64\nlen 8\ndata 8 length=len\ntail 8\n", shorter), result_code::ok);
+    EXPECT_EQ(shorter.get_internal_buffer_length(), 18u);
+    EXPECT_EQ(shorter.write("len", 1), result_code::ok);
+    EXPECT_EQ(shorter.write("tail", 0x5A), result_code::ok);
+    EXPECT_EQ(shorter.read<unsigned int>("tail"), 0x5Au);
+    EXPECT_EQ(shorter.get_field_metadata("tail").first_bit_ind, 144u);
+
+    // Snapshot restores the same metadata
+    const TemporaryFile schema_file("ez_schema_loader_test.txt");
+    const TemporaryFile snapshot_file("ez_schema_loader_test.bin");
+    const char* schema_path = schema_file.path.c_str();
+    const char* snapshot_path = snapshot_file.path.c_str();
+    FILE* file = fopen(schema_path, "wb");
+    ASSERT_NE(file, nullptr);
+    fwrite(schema.data(), 1, schema.size(), file);
+    fclose(file);
+    protocol_serializer loaded;
+    ASSERT_EQ(loader.load_cached(schema_path, snapshot_path, loaded), result_code::ok);
+    EXPECT_FALSE(loader.get_used_snapshot());
+    protocol_serializer restored({{"replaced", 3}});
+    ASSERT_EQ(loader.load_cached(schema_path, snapshot_path, restored), result_code::ok);
+    EXPECT_TRUE(loader.get_used_snapshot());
+    EXPECT_TRUE(restored.get_is_little_endian());
+    EXPECT_EQ(restored.get_fields_list(), ps.get_fields_list());
+    const protocol_serializer::layout_ptr_t expected = ps.get_layout();
+    const protocol_serializer::layout_ptr_t actual = restored.get_layout();
+    ASSERT_EQ(actual->fields_metadata.size(), expected->fields_metadata.size());
+    EXPECT_EQ(memcmp(actual->fields_metadata.data(), expected->fields_metadata.data(), expected->fields_metadata.size() * sizeof(protocol_serializer::field_metadata)), 0);
+    EXPECT_EQ(actual->length_fields_end, 2u);
+    EXPECT_EQ(restored.get_internal_buffer_length(), ps.get_internal_buffer_length());
+    EXPECT_EQ(restored.write("length", 2), result_code::ok);
+    EXPECT_EQ(restored.write("offset", -5), result_code::ok);
+    EXPECT_EQ(restored.read<int>("offset"), -5);
+    EXPECT_EQ(restored.get_field_metadata("offset").first_bit_ind, 72u);
+
+    // Snapshot of other text is not used, damaged one is rejected
+    EXPECT_EQ(loader.load_snapshot(snapshot_path, restored, ez::schema_loader::get_source_hash("other")), result_code::not_applicable);
+    file = fopen(snapshot_path, "r+b");
+    ASSERT_NE(file, nullptr);
+    fseek(file, -2, SEEK_END);
+    fputc('?', file);
+    fclose(file);
+    EXPECT_EQ(loader.load_snapshot(snapshot_path, restored), result_code::bad_input);
+    EXPECT_EQ(loader.load_snapshot(::testing::TempDir() + "ez_schema_loader_missing.bin", restored), result_code::io_error);
+    ASSERT_EQ(loader.load_cached(schema_path, snapshot_path, restored), result_code::ok);
+    EXPECT_FALSE(loader.get_used_snapshot());
+    EXPECT_EQ(loader.load_snapshot(snapshot_path, restored), result_code::ok);
+
+    // Snapshot without source hash is not a cache of any text
+    ASSERT_EQ(ez::schema_loader::save_snapshot(ps, snapshot_path), result_code::ok);
+    ASSERT_EQ(loader.load_cached(schema_path, snapshot_path, restored), result_code::ok);
+    EXPECT_FALSE(loader.get_used_snapshot());
+
+    // Hash only catches damage done after saving, inconsistent metadata is rejected as well
+    protocol_serializer inconsistent;
+    ASSERT_EQ(loader.parse(schema, inconsistent), result_code::ok);
+    protocol_serializer::protocol_layout& inconsistent_layout = const_cast<protocol_serializer::protocol_layout&>(*inconsistent.get_layout());
+    ++inconsistent_layout.fields_metadata.back().touched_bytes_count;
+    ASSERT_EQ(ez::schema_loader::save_snapshot(inconsistent, snapshot_path), result_code::ok);
+    EXPECT_EQ(loader.load_snapshot(snapshot_path, restored), result_code::bad_input);
+    --inconsistent_layout.fields_metadata.back().touched_bytes_count;
+    inconsistent_layout.variable_fields[0].length_field_ind = 2;
+    ASSERT_EQ(ez::schema_loader::save_snapshot(inconsistent, snapshot_path), result_code::ok);
+    EXPECT_EQ(loader.load_snapshot(snapshot_path, restored), result_code::bad_input);
+    inconsistent_layout.variable_fields[0].length_field_ind = 1;
+    inconsistent_layout.fields_metadata[3].first_bit_ind += 8;
+    ASSERT_EQ(ez::schema_loader::save_snapshot(inconsistent, snapshot_path), result_code::ok);
+    EXPECT_EQ(loader.load_snapshot(snapshot_path, restored), result_code::bad_input);
+    EXPECT_EQ(restored.get_fields_list(), ps.get_fields_list());
+
+    protocol_serializer grouped;
+    ASSERT_EQ(grouped.append_group("samples", other, 2), result_code::ok);
+    EXPECT_EQ(ez::schema_loader::save_snapshot(grouped, snapshot_path), result_code::not_applicable);
+}